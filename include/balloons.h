@@ -0,0 +1,20 @@
+#ifndef _BALLOONS_H
+#define _BALLOONS_H
+
+// Public interface of libballoons, the solver without the GUI. sparse.h and
+// fixed_newton.h are implementation details and not included
+
+#include <equations/utils.h>
+#include <equations/batch.h>
+#include <equations/continuation.h>
+#include <equations/cache.h>
+#include <equations/triple_buffer.h>
+#include <equations/pool.h>
+#include <equations/table.h>
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/n_levels.h>
+#include <equations/atlas.h>
+#include <equations/replay.h>
+
+#endif // _BALLOONS_H
@@ -3,6 +3,8 @@
 
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_multiroots.h>
+#include <equations/continuation.h>
+#include <equations/n_levels.h>
 
 
 struct system_2_levels_user_params
@@ -22,28 +24,6 @@ struct system_2_levels_user_params
 };
 
 
-struct system_2_levels_params
-{
-    double phi_ad_0;
-    double phi_cb_0;
-    double phi_dc_0;
-    double phi_ec_0;
-    double phi_ed_0;
-
-    double r_top_0,r_bot_0;
-    double p_top_0,p_bot_0;
-
-    double Ax, Ay;
-    double Bx, By;
-
-    double p_ac, p_atm;
-
-    double S_top_0, S_bot_0;
-
-    double k;
-};
-
-
 struct system_2_levels_result
 {
     double phi_ad, r_ad, x_ad, y_ad, a_ad;
@@ -58,11 +38,66 @@ struct system_2_levels_result
 };
 
 
-int system_2_levels_f(const gsl_vector *x, void *p, gsl_vector *f);
-int system_2_levels_df(const gsl_vector *x, void *p, gsl_matrix *J);
-int system_2_levels_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J);
+// Owns the solver workspaces and the warm start, one per thread
+struct system_2_levels_ctx;
+
+
+struct system_2_levels_branch
+{
+    size_t n_points;
+    size_t capacity;
+    double *lambda;
+    size_t *iters;
+    struct system_2_levels_result *results;
+};
+
+
+extern const struct field_desc system_2_levels_user_params_fields[];
+extern const size_t system_2_levels_user_params_n_fields;
+extern const struct field_desc system_2_levels_result_fields[];
+extern const size_t system_2_levels_result_n_fields;
+
+void system_2_levels_default_user_params(struct system_2_levels_user_params *user_params);
+
+// Stack of equations/n_levels.h the model is solved as
+void system_2_levels_stack_params(const struct system_2_levels_user_params *user_params, struct system_n_levels_user_params *stack);
+// Checks the Jacobian of the stack at the default params into diff.txt, writes
+// the initial and solved configurations
 int system_2_levels_eval_f();
 int system_2_levels_eval(const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result);
 int system_2_levels_adiabatic_eval(const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result);
+int system_2_levels_eval_warm(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result);
+int system_2_levels_adiabatic_eval_warm(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result);
+int system_2_levels_eval_backend(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result, enum solver_backend backend);
+int system_2_levels_adiabatic_eval_backend(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result, enum solver_backend backend);
+// eval_backend filling *stats, which may be NULL. eval and eval_warm are it
+// with the default backend
+int system_2_levels_eval_stats(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result, enum solver_backend backend, struct solver_stats *stats);
+int system_2_levels_adiabatic_eval_stats(const struct system_2_levels_user_params *user_params, const struct system_2_levels_result *warm, struct system_2_levels_result *result, enum solver_backend backend, struct solver_stats *stats);
+
+// Backend of the one-shot evals, the one to default to
+enum solver_backend system_2_levels_default_backend(bool adiabatic);
+struct system_2_levels_ctx *system_2_levels_ctx_alloc(enum solver_backend backend);
+void system_2_levels_ctx_free(struct system_2_levels_ctx *ctx);
+void system_2_levels_ctx_set_warm(struct system_2_levels_ctx *ctx, const struct system_2_levels_result *warm);
+size_t system_2_levels_ctx_iterations(const struct system_2_levels_ctx *ctx);
+// Every eval of ctx fills *stats from now on, NULL stops it
+void system_2_levels_ctx_set_stats(struct system_2_levels_ctx *ctx, struct solver_stats *stats);
+// cancelled(data) is polled between iterations of every eval of ctx, once it
+// returns true the eval gives up with SOLVER_ECANCELLED. NULL removes it
+void system_2_levels_ctx_set_cancel(struct system_2_levels_ctx *ctx, solver_cancel_t cancelled, void *data);
+int system_2_levels_ctx_eval(struct system_2_levels_ctx *ctx, const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result);
+int system_2_levels_ctx_adiabatic_eval(struct system_2_levels_ctx *ctx, const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result);
+
+// Solves in[0..n-1] on nthreads workers (<= 0 means one per CPU), status may be NULL
+int system_2_levels_eval_batch(const struct system_2_levels_user_params *in, size_t n, struct system_2_levels_result *out, int *status, int nthreads);
+int system_2_levels_adiabatic_eval_batch(const struct system_2_levels_user_params *in, size_t n, struct system_2_levels_result *out, int *status, int nthreads);
+// Same with the stats of item i in stats[i], stats may be NULL
+int system_2_levels_eval_batch_stats(const struct system_2_levels_user_params *in, size_t n, struct system_2_levels_result *out, int *status, struct solver_stats *stats, int nthreads);
+int system_2_levels_adiabatic_eval_batch_stats(const struct system_2_levels_user_params *in, size_t n, struct system_2_levels_result *out, int *status, struct solver_stats *stats, int nthreads);
+
+int system_2_levels_continuation(const struct system_2_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_2_levels_branch *branch);
+int system_2_levels_adiabatic_continuation(const struct system_2_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_2_levels_branch *branch);
+void system_2_levels_branch_free(struct system_2_levels_branch *branch);
 
 #endif // _EQUATIONS_2_LEVELS_H
\ No newline at end of file
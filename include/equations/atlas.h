@@ -0,0 +1,62 @@
+#ifndef _EQUATIONS_ATLAS_H
+#define _EQUATIONS_ATLAS_H
+
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ATLAS_MAX_AXES 8
+#define ATLAS_VERSION 1
+
+
+// Precomputed solutions of one model on a uniform grid over some of the
+// user params, the others are fixed to the base configuration. The file is
+// the header, the base user params as doubles and then n_points results as
+// floats, the last axis varying fastest. Points that did not converge are
+// stored as NaN. Everything is in host byte order
+struct atlas_axis
+{
+    uint32_t param;         // index of the double in the user params
+    uint32_t n;             // at least 2
+    double lo, hi;
+};
+
+struct atlas_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t n_levels;
+    uint32_t adiabatic;
+    uint32_t n_axes;
+    uint32_t n_params, n_results;
+    uint64_t n_points;
+    struct atlas_axis axes[ATLAS_MAX_AXES];
+};
+
+// Read-only mapping of an atlas file
+struct atlas;
+
+
+// Fills magic, version and n_points of header itself
+int atlas_write(const char *path, struct atlas_header *header, const double *base, const float *values);
+
+struct atlas *atlas_open(const char *path);
+void atlas_close(struct atlas *atlas);
+const struct atlas_header *atlas_get_header(const struct atlas *atlas);
+const double *atlas_get_base(const struct atlas *atlas);
+
+// Multilinear interpolation of the result at user_params. Corners that did
+// not converge are left out. GSL_EDOM when user_params is off the grid or
+// differs from the base outside the axes, or no corner converged
+int atlas_lookup(const struct atlas *atlas, const double *user_params, double *result);
+
+// Same with the model checked against the atlas
+int system_2_levels_atlas_lookup(const struct atlas *atlas, const struct system_2_levels_user_params *user_params, bool adiabatic, struct system_2_levels_result *result);
+int system_3_levels_atlas_lookup(const struct atlas *atlas, const struct system_3_levels_user_params *user_params, bool adiabatic, struct system_3_levels_result *result);
+
+// Exact solve on ctx warm started from the interpolated result when the atlas has one
+int system_2_levels_atlas_eval(const struct atlas *atlas, struct system_2_levels_ctx *ctx, const struct system_2_levels_user_params *user_params, bool adiabatic, struct system_2_levels_result *result);
+int system_3_levels_atlas_eval(const struct atlas *atlas, struct system_3_levels_ctx *ctx, const struct system_3_levels_user_params *user_params, bool adiabatic, struct system_3_levels_result *result);
+
+#endif // _EQUATIONS_ATLAS_H
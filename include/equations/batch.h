@@ -0,0 +1,22 @@
+#ifndef _EQUATIONS_BATCH_H
+#define _EQUATIONS_BATCH_H
+
+#include <stddef.h>
+
+
+// Per-worker state (e.g. a solver context), NULL return aborts the worker
+typedef void *(*batch_worker_alloc_t)(void *data);
+typedef void (*batch_worker_free_t)(void *worker, void *data);
+
+// Processes item i with the calling worker's state
+typedef void (*batch_item_t)(size_t i, void *worker, void *data);
+
+
+int batch_default_threads();
+
+// Runs item(0..n-1) on nthreads workers (<= 0 means one per online CPU).
+// Every worker starts with a contiguous slice of the indices and, once it
+// runs dry, steals the upper half of the largest remaining slice
+int batch_run(size_t n, int nthreads, batch_worker_alloc_t worker_alloc, batch_item_t item, batch_worker_free_t worker_free, void *data);
+
+#endif // _EQUATIONS_BATCH_H
@@ -0,0 +1,36 @@
+#ifndef _EQUATIONS_CACHE_H
+#define _EQUATIONS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Bounded LRU map from (key, tag) to a fixed-size value, safe to share
+// between threads. Keys are arrays of doubles, e.g. user params, quantised
+// to quantum relative precision before hashing so that near-identical
+// inputs hit the same entry. quantum 0 means exact match
+struct result_cache;
+
+struct result_cache_stats
+{
+    size_t hits, misses;
+    size_t insertions, evictions;
+    size_t size, capacity;
+};
+
+
+struct result_cache *result_cache_alloc(size_t capacity, size_t n_key, size_t value_size, double quantum);
+void result_cache_free(struct result_cache *cache);
+void result_cache_clear(struct result_cache *cache);
+
+// Copies the value into *value and marks the entry most recently used
+bool result_cache_lookup(struct result_cache *cache, const double *key, int tag, void *value);
+// Replaces the least recently used entry when full
+void result_cache_insert(struct result_cache *cache, const double *key, int tag, const void *value);
+// Leaves the counters and the recency order alone
+bool result_cache_contains(struct result_cache *cache, const double *key, int tag);
+
+void result_cache_get_stats(struct result_cache *cache, struct result_cache_stats *stats);
+double result_cache_hit_rate(struct result_cache *cache);
+
+#endif // _EQUATIONS_CACHE_H
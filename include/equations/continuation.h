@@ -0,0 +1,44 @@
+#ifndef _EQUATIONS_CONTINUATION_H
+#define _EQUATIONS_CONTINUATION_H
+
+#include <equations/utils.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+
+
+// Recomputes solver params for the new value of the continuation parameter
+typedef void (*continuation_set_lambda_t)(double lambda, void *data);
+
+// Called for every point of the branch, a non-zero return value stops the
+// run and is returned by continuation_run
+typedef int (*continuation_emit_t)(const gsl_vector *x, double lambda, size_t iters, void *data);
+
+
+struct continuation_problem
+{
+    size_t n;
+    gsl_solver_f_t f;
+    gsl_solver_df_t df;
+    void *params;
+
+    continuation_set_lambda_t set_lambda;
+    void *lambda_data;
+
+    double lambda_start, lambda_end;
+};
+
+
+struct continuation_options
+{
+    double ds_init, ds_min, ds_max;
+    size_t max_points;
+    size_t max_corrector_iters;
+    double eps;
+};
+
+
+void continuation_default_options(struct continuation_options *opts);
+
+int continuation_run(const struct continuation_problem *problem, const gsl_vector *x_start, const struct continuation_options *opts, continuation_emit_t emit, void *emit_data);
+
+#endif // _EQUATIONS_CONTINUATION_H
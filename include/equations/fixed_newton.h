@@ -0,0 +1,247 @@
+// Fixed-size damped Newton solver, instantiated once per system of equations:
+//
+//     #define FIXED_NEWTON_N          24
+//     #define FIXED_NEWTON_NAME(s)    __system_n_levels_2_fixed_##s
+//     #define FIXED_NEWTON_F          system_n_levels_f
+//     #define FIXED_NEWTON_DF         system_n_levels_df
+//     #include <equations/fixed_newton.h>
+//
+// defines FIXED_NEWTON_NAME(solve) of type fixed_newton_solve_t. Residual,
+// Jacobian and LU live in a stack workspace sized at compile time and f, df
+// are called directly, so a solve does not touch the heap. Calls of f and df
+// and the iterations are booked into stats unless it is NULL, cancel is
+// polled before every iteration
+
+#ifndef _EQUATIONS_FIXED_NEWTON_H
+#define _EQUATIONS_FIXED_NEWTON_H
+
+#include <equations/utils.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#endif // _EQUATIONS_FIXED_NEWTON_H
+
+
+#if !defined(FIXED_NEWTON_N) || !defined(FIXED_NEWTON_NAME) || !defined(FIXED_NEWTON_F) || !defined(FIXED_NEWTON_DF)
+#error "FIXED_NEWTON_N, FIXED_NEWTON_NAME, FIXED_NEWTON_F and FIXED_NEWTON_DF must be defined"
+#endif
+
+#define __FN_N FIXED_NEWTON_N
+
+
+struct FIXED_NEWTON_NAME(workspace)
+{
+    double f[__FN_N];
+    double f_trial[__FN_N];
+    double x_trial[__FN_N];
+    double dx[__FN_N];
+    double J[__FN_N][__FN_N];
+    size_t perm[__FN_N];
+};
+
+
+static inline int FIXED_NEWTON_NAME(f)(void *params, double *x, double *f, struct solver_stats *stats)
+{
+    gsl_vector_view x_view = gsl_vector_view_array(x,__FN_N);
+    gsl_vector_view f_view = gsl_vector_view_array(f,__FN_N);
+    if(!stats)
+        return FIXED_NEWTON_F(&x_view.vector,params,&f_view.vector);
+
+    const double t = solver_clock();
+    int status = FIXED_NEWTON_F(&x_view.vector,params,&f_view.vector);
+    stats->t_f += solver_clock() - t;
+    ++stats->f_calls;
+
+    return status;
+}
+
+
+static inline int FIXED_NEWTON_NAME(df)(void *params, double *x, double J[__FN_N][__FN_N], struct solver_stats *stats)
+{
+    gsl_vector_view x_view = gsl_vector_view_array(x,__FN_N);
+    gsl_matrix_view J_view = gsl_matrix_view_array(&J[0][0],__FN_N,__FN_N);
+    if(!stats)
+        return FIXED_NEWTON_DF(&x_view.vector,params,&J_view.matrix);
+
+    const double t = solver_clock();
+    int status = FIXED_NEWTON_DF(&x_view.vector,params,&J_view.matrix);
+    stats->t_df += solver_clock() - t;
+    ++stats->df_calls;
+
+    return status;
+}
+
+
+static inline double FIXED_NEWTON_NAME(norm2)(const double *f)
+{
+    double s = 0;
+    for(size_t i = 0; i < __FN_N; ++i)
+        s += f[i]*f[i];
+    return s;
+}
+
+
+// Same criterion as gsl_multiroot_test_residual
+static inline int FIXED_NEWTON_NAME(test_residual)(const double *f, double eps)
+{
+    double s = 0;
+    for(size_t i = 0; i < __FN_N; ++i)
+        s += fabs(f[i]);
+    return s < eps ? GSL_SUCCESS : GSL_CONTINUE;
+}
+
+
+// In-place LU with partial pivoting, rows are swapped physically
+static inline int FIXED_NEWTON_NAME(lu_decomp)(double J[__FN_N][__FN_N], size_t *perm)
+{
+    for(size_t i = 0; i < __FN_N; ++i)
+        perm[i] = i;
+
+    for(size_t k = 0; k < __FN_N; ++k)
+    {
+        size_t p = k;
+        double max = fabs(J[k][k]);
+        for(size_t i = k+1; i < __FN_N; ++i)
+        {
+            if(fabs(J[i][k]) > max)
+            {
+                max = fabs(J[i][k]);
+                p = i;
+            }
+        }
+        if(max == 0 || !gsl_finite(max))
+            return GSL_ESING;
+
+        if(p != k)
+        {
+            for(size_t j = 0; j < __FN_N; ++j)
+            {
+                double t = J[k][j];
+                J[k][j] = J[p][j];
+                J[p][j] = t;
+            }
+            size_t t = perm[k];
+            perm[k] = perm[p];
+            perm[p] = t;
+        }
+
+        const double inv_pivot = 1/J[k][k];
+        for(size_t i = k+1; i < __FN_N; ++i)
+        {
+            const double l = J[i][k]*inv_pivot;
+            J[i][k] = l;
+            if(l == 0)
+                continue;
+            for(size_t j = k+1; j < __FN_N; ++j)
+                J[i][j] -= l*J[k][j];
+        }
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+static inline void FIXED_NEWTON_NAME(lu_solve)(double J[__FN_N][__FN_N], const size_t *perm, const double *b, double *x)
+{
+    for(size_t i = 0; i < __FN_N; ++i)
+    {
+        double s = b[perm[i]];
+        for(size_t j = 0; j < i; ++j)
+            s -= J[i][j]*x[j];
+        x[i] = s;
+    }
+
+    for(size_t i = __FN_N; i-- > 0;)
+    {
+        double s = x[i];
+        for(size_t j = i+1; j < __FN_N; ++j)
+            s -= J[i][j]*x[j];
+        x[i] = s/J[i][i];
+    }
+}
+
+
+// Newton with backtracking on 0.5*|f|^2, x is updated in place
+static int FIXED_NEWTON_NAME(solve)(void *params, double *x, size_t max_iters, double eps, size_t *iters, struct solver_stats *stats, const struct solver_cancel *cancel)
+{
+    struct FIXED_NEWTON_NAME(workspace) ws;
+    size_t iter = 0, stalls = 0;
+    int status;
+
+    FIXED_NEWTON_NAME(f)(params,x,ws.f,stats);
+    double norm2 = FIXED_NEWTON_NAME(norm2)(ws.f);
+    if(!gsl_finite(norm2))
+        status = GSL_EBADFUNC;
+    else
+        status = FIXED_NEWTON_NAME(test_residual)(ws.f,eps);
+
+    while(status == GSL_CONTINUE && iter < max_iters)
+    {
+        if(solver_cancelled(cancel))
+        {
+            status = SOLVER_ECANCELLED;
+            break;
+        }
+
+        FIXED_NEWTON_NAME(df)(params,x,ws.J,stats);
+        status = FIXED_NEWTON_NAME(lu_decomp)(ws.J,ws.perm);
+        if(status)
+            break;
+        FIXED_NEWTON_NAME(lu_solve)(ws.J,ws.perm,ws.f,ws.dx);
+
+        double t = 1;
+        double norm2_trial;
+        bool decrease;
+        while(true)
+        {
+            for(size_t i = 0; i < __FN_N; ++i)
+                ws.x_trial[i] = x[i] - t*ws.dx[i];
+            FIXED_NEWTON_NAME(f)(params,ws.x_trial,ws.f_trial,stats);
+            norm2_trial = FIXED_NEWTON_NAME(norm2)(ws.f_trial);
+            decrease = gsl_finite(norm2_trial) && norm2_trial <= (1 - 2e-4*t)*norm2;
+            if(decrease || t < 1e-4)
+                break;
+            t /= 2;
+        }
+        if(!gsl_finite(norm2_trial))
+        {
+            status = GSL_EBADFUNC;
+            break;
+        }
+        // Stuck at a local minimum of |f|, more iterations would not get out
+        if(!decrease && ++stalls >= 8)
+        {
+            status = GSL_ENOPROG;
+            break;
+        }
+
+        for(size_t i = 0; i < __FN_N; ++i)
+        {
+            x[i] = ws.x_trial[i];
+            ws.f[i] = ws.f_trial[i];
+        }
+        norm2 = norm2_trial;
+        ++iter;
+
+        status = FIXED_NEWTON_NAME(test_residual)(ws.f,eps);
+    }
+    if(status == GSL_CONTINUE)
+        status = GSL_EMAXITER;
+
+    if(iters)
+        *iters = iter;
+
+    return status;
+}
+
+
+#undef __FN_N
+#undef FIXED_NEWTON_N
+#undef FIXED_NEWTON_NAME
+#undef FIXED_NEWTON_F
+#undef FIXED_NEWTON_DF
@@ -0,0 +1,239 @@
+#ifndef _EQUATIONS_N_LEVELS_H
+#define _EQUATIONS_N_LEVELS_H
+
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <equations/utils.h>
+#include <equations/continuation.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYSTEM_N_LEVELS_MIN 2
+#define SYSTEM_N_LEVELS_MAX 8
+
+#define SYSTEM_N_LEVELS_MAX_ARCS        (3*(SYSTEM_N_LEVELS_MAX-1) + 2)
+#define SYSTEM_N_LEVELS_MAX_JUNCTIONS   (2*SYSTEM_N_LEVELS_MAX + 1)
+#define SYSTEM_N_LEVELS_MAX_CHAMBERS    SYSTEM_N_LEVELS_MAX
+#define SYSTEM_N_LEVELS_MAX_MEMBRANES   SYSTEM_N_LEVELS_MAX_ARCS
+#define SYSTEM_N_LEVELS_MAX_N_EQ        (5*SYSTEM_N_LEVELS_MAX_ARCS + SYSTEM_N_LEVELS_MAX_CHAMBERS)
+
+// Outer side of an arc that does not bound another chamber
+#define SYSTEM_N_LEVELS_AMBIENT_LEFT    -1  // zero gauge pressure
+#define SYSTEM_N_LEVELS_AMBIENT_RIGHT   -2  // p_ac
+
+// Equations a junction contributes: coincidence of the arc ends and balance
+// of the membrane tensions by each coordinate
+#define SYSTEM_N_LEVELS_CONT_X  1u
+#define SYSTEM_N_LEVELS_CONT_Y  2u
+#define SYSTEM_N_LEVELS_BAL_X   4u
+#define SYSTEM_N_LEVELS_BAL_Y   8u
+
+// Arcs of a stack: every level but the bottom one has a left and a right
+// wall and the membrane below it, the bottom level has a left and a right half
+#define SYSTEM_N_LEVELS_ARC_LEFT(level)     (3*(level))
+#define SYSTEM_N_LEVELS_ARC_RIGHT(level)    (3*(level) + 1)
+#define SYSTEM_N_LEVELS_ARC_MEMBRANE(level) (3*(level) + 2)
+
+
+enum system_n_levels_pressure_law
+{
+    SYSTEM_N_LEVELS_ISOTHERMAL,     // p = p_0
+    SYSTEM_N_LEVELS_ADIABATIC       // p*S^k = p_0*S_0^k
+};
+
+
+// Stack of n_levels balloons hanging from A (left) and B (right). Level 0 is
+// the top one, phi_*_0[i] are the initial angles of the walls of level i
+struct system_n_levels_user_params
+{
+    size_t n_levels;
+
+    double phi_left_0[SYSTEM_N_LEVELS_MAX-1];
+    double phi_membrane_0[SYSTEM_N_LEVELS_MAX-1];
+
+    double r_0[SYSTEM_N_LEVELS_MAX];
+    double p_0[SYSTEM_N_LEVELS_MAX];
+
+    double Ax, Ay;
+    double Bx, By;
+
+    double p_ac, p_atm;
+    double k;
+};
+
+
+// Circular arc over theta = a + (alpha + t)*phi for t in [0,1], its points
+// are (cx - r*cos(theta), cy + r*sin(theta))
+struct system_n_levels_arc_state
+{
+    double phi, r, cx, cy, a;
+};
+
+
+struct system_n_levels_arc
+{
+    struct system_n_levels_arc_state s0;    // reference configuration
+    double alpha;
+    bool a_fixed;                           // start angle stays at s0.a
+    int cx_shared;                          // earlier arc whose centre x is reused, -1 for own
+    int inner, outer;                       // chambers on both sides, outer may be ambient
+    int membrane;                           // arcs of one membrane keep their total length
+};
+
+
+struct system_n_levels_end
+{
+    int arc;
+    int t;
+};
+
+
+// Arc ends meeting at one point. A fixed junction pins ends[0] to (x, y),
+// otherwise every end after the first one must coincide with it
+struct system_n_levels_junction
+{
+    size_t n_ends;
+    struct system_n_levels_end ends[3];
+    bool fixed;
+    double x, y;
+    unsigned eqs;
+};
+
+
+// Boundary traversed by increasing t, consecutive arcs are joined by chords
+struct system_n_levels_chamber
+{
+    size_t n_arcs;
+    int arcs[3];
+    double p_0;
+};
+
+
+struct system_n_levels_topology
+{
+    size_t n_levels;    // set by system_n_levels_stack, 0 for any other topology
+    size_t n_arcs, n_junctions, n_chambers, n_membranes;
+    struct system_n_levels_arc arcs[SYSTEM_N_LEVELS_MAX_ARCS];
+    struct system_n_levels_junction junctions[SYSTEM_N_LEVELS_MAX_JUNCTIONS];
+    struct system_n_levels_chamber chambers[SYSTEM_N_LEVELS_MAX_CHAMBERS];
+
+    enum system_n_levels_pressure_law law;
+    double p_ac, k;
+};
+
+
+// Topology with the unknowns laid out: parameters of the arcs in order
+// (phi, r, cx, cy, a) skipping fixed and shared ones, then chamber pressures
+struct system_n_levels
+{
+    struct system_n_levels_topology topo;
+    size_t n_eq;
+    uint64_t topology_hash;     // of the structure of topo, not of its configuration
+    int idx[SYSTEM_N_LEVELS_MAX_ARCS][5];
+    int p_idx[SYSTEM_N_LEVELS_MAX_CHAMBERS];
+    double L_0[SYSTEM_N_LEVELS_MAX_MEMBRANES];
+    double S_0[SYSTEM_N_LEVELS_MAX_CHAMBERS];
+};
+
+
+// Straight-line kernels of one stack, see scripts/gen_kernels.py
+struct system_n_levels_kernels
+{
+    gsl_solver_f_t f;
+    gsl_solver_df_t df;
+    gsl_solver_fdf_t fdf;
+    solver_jac_t jac;
+    fixed_newton_solve_t fixed_solve;   // on f and df, params is the struct system_n_levels
+
+    // Of the system the kernels were generated from
+    size_t n_eq;
+    uint64_t topology_hash;
+};
+
+
+struct system_n_levels_result
+{
+    size_t n_arcs, n_chambers;
+    struct system_n_levels_arc_state arcs[SYSTEM_N_LEVELS_MAX_ARCS];
+    double p[SYSTEM_N_LEVELS_MAX_CHAMBERS];
+};
+
+
+// Owns the solver workspaces and the warm start, one per thread
+struct system_n_levels_ctx;
+
+
+struct system_n_levels_branch
+{
+    size_t n_points;
+    size_t capacity;
+    double *lambda;
+    size_t *iters;
+    struct system_n_levels_result *results;
+};
+
+
+// Fields of a stack of n_levels are the first system_n_levels_*_n_fields(n_levels)
+// of the tables, level by level
+extern const struct field_desc system_n_levels_user_params_fields[];
+extern const struct field_desc system_n_levels_result_fields[];
+size_t system_n_levels_user_params_n_fields(size_t n_levels);
+size_t system_n_levels_result_n_fields(size_t n_levels);
+
+// 2 and 3 levels match the dedicated modules. Deeper stacks are nested cups
+// that converge cold for any p_ac from 0 up to the default one
+void system_n_levels_default_user_params(struct system_n_levels_user_params *user_params, size_t n_levels);
+
+// Builds the stack of user_params->n_levels balloons in its initial configuration
+int system_n_levels_stack(const struct system_n_levels_user_params *user_params, enum system_n_levels_pressure_law law, struct system_n_levels_topology *topo);
+
+// Lays out the unknowns, GSL_EBADLEN if the topology has not as many equations
+int system_n_levels_assemble(const struct system_n_levels_topology *topo, struct system_n_levels *sys);
+
+void system_n_levels_x0(const struct system_n_levels *sys, gsl_vector *x);
+void system_n_levels_x_to_res(const struct system_n_levels *sys, const gsl_vector *x, struct system_n_levels_result *result);
+void system_n_levels_res_to_x(const struct system_n_levels *sys, const struct system_n_levels_result *result, gsl_vector *x);
+
+// p is a struct system_n_levels
+int system_n_levels_f(const gsl_vector *x, void *p, gsl_vector *f);
+int system_n_levels_df(const gsl_vector *x, void *p, gsl_matrix *J);
+int system_n_levels_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J);
+int system_n_levels_jac(const gsl_vector *x, void *p, struct jacobian *J);
+
+// Generated kernels of the stack and law of sys, NULL if sys is not a plain
+// stack, its structure is not the generated one or the build had no generator
+const struct system_n_levels_kernels *system_n_levels_kernels_find(const struct system_n_levels *sys);
+// Generated kernels or else the generic ones above, the fixed solve of the
+// latter exists for the sizes of the plain stacks only
+const struct system_n_levels_kernels *system_n_levels_kernels(const struct system_n_levels *sys);
+
+int system_n_levels_eval(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result);
+int system_n_levels_adiabatic_eval(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result);
+// Same filling *stats, which may be NULL
+int system_n_levels_eval_stats(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, struct solver_stats *stats);
+int system_n_levels_adiabatic_eval_stats(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, struct solver_stats *stats);
+
+// Backend of the one-shot evals, the one to default to
+enum solver_backend system_n_levels_default_backend(bool adiabatic);
+// Every backend runs on the kernels of system_n_levels_kernels, the fixed one
+// fails with GSL_EUNIMPL on systems it has no instance for
+struct system_n_levels_ctx *system_n_levels_ctx_alloc(enum solver_backend backend);
+void system_n_levels_ctx_free(struct system_n_levels_ctx *ctx);
+void system_n_levels_ctx_set_warm(struct system_n_levels_ctx *ctx, const struct system_n_levels_result *warm);
+size_t system_n_levels_ctx_iterations(const struct system_n_levels_ctx *ctx);
+// Every solve of ctx fills *stats from now on, NULL stops it
+void system_n_levels_ctx_set_stats(struct system_n_levels_ctx *ctx, struct solver_stats *stats);
+// cancelled(data) is polled between iterations of every solve of ctx, true
+// gives up with SOLVER_ECANCELLED. NULL removes it
+void system_n_levels_ctx_set_cancel(struct system_n_levels_ctx *ctx, solver_cancel_t cancelled, void *data);
+int system_n_levels_ctx_solve(struct system_n_levels_ctx *ctx, const struct system_n_levels_topology *topo, struct system_n_levels_result *result);
+int system_n_levels_ctx_eval(struct system_n_levels_ctx *ctx, const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result);
+int system_n_levels_ctx_adiabatic_eval(struct system_n_levels_ctx *ctx, const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result);
+
+// Branch of the stack while the double member of user_params at param_offset
+// goes to lambda_end, from the solution at its current value
+int system_n_levels_continuation(const struct system_n_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_n_levels_branch *branch);
+int system_n_levels_adiabatic_continuation(const struct system_n_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_n_levels_branch *branch);
+void system_n_levels_branch_free(struct system_n_levels_branch *branch);
+
+#endif // _EQUATIONS_N_LEVELS_H
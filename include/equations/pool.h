@@ -0,0 +1,36 @@
+#ifndef _EQUATIONS_POOL_H
+#define _EQUATIONS_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+typedef void (*pool_job_t)(void *data);
+
+// Idle jobs only start while no normal job is queued, e.g. speculative work
+enum pool_priority
+{
+    POOL_PRIORITY_NORMAL,
+    POOL_PRIORITY_IDLE
+};
+
+// Long-lived worker threads fed from bounded FIFO queues, one per priority
+struct pool;
+
+
+// nthreads <= 0 means one per online CPU, capacity bounds each queue
+struct pool *pool_alloc(int nthreads, size_t capacity);
+
+// Lets the running jobs finish, drops the queued ones and joins the workers
+void pool_free(struct pool *pool);
+
+// release(data), when not NULL, follows the job or replaces it if the job is
+// dropped. Fails with GSL_EFAILED when the queue is full or the pool is
+// shutting down, data then stays with the caller
+int pool_submit(struct pool *pool, enum pool_priority priority, pool_job_t job, pool_job_t release, void *data);
+
+// For long idle jobs to give way: normal jobs are waiting or shutdown began
+bool pool_should_yield(struct pool *pool);
+bool pool_stopping(struct pool *pool);
+
+#endif // _EQUATIONS_POOL_H
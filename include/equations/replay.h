@@ -0,0 +1,50 @@
+#ifndef _EQUATIONS_REPLAY_H
+#define _EQUATIONS_REPLAY_H
+
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/utils.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Quasi-static replay of a time series of user params: every sample is
+// solved from the previous equilibrium. A sample that does not converge
+// within max_iters is approached over substeps, linear in the user params,
+// doubled up to max_substeps. The number of substeps carries over to the
+// next sample and is halved again once the samples converge quickly
+struct replay_options
+{
+    size_t max_iters;           // per solve, past it the solve counts as failed
+    size_t slow_iters;          // more iterations per substep than this refine the next sample
+    size_t max_substeps;
+    bool extrapolate;           // secant predictor through the last two equilibria
+};
+
+struct replay_step_info
+{
+    int status;
+    size_t substeps;
+    size_t iterations;          // over all substeps and attempts
+};
+
+// Solver context and history of one replay, the model is fixed by the alloc
+struct replay;
+
+
+void replay_default_options(struct replay_options *opts);
+
+struct replay *system_2_levels_replay_alloc(enum solver_backend backend, bool adiabatic, const struct replay_options *opts);
+struct replay *system_3_levels_replay_alloc(enum solver_backend backend, bool adiabatic, const struct replay_options *opts);
+void replay_free(struct replay *replay);
+
+// Forgets the history, the next sample is solved from scratch
+void replay_reset(struct replay *replay);
+
+// On failure result is the last equilibrium reached on the way and the
+// history is kept, so that the replay can go on with the next sample.
+// GSL_EINVAL when replay was allocated for the other model, info may be NULL
+int system_2_levels_replay_step(struct replay *replay, const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result, struct replay_step_info *info);
+int system_3_levels_replay_step(struct replay *replay, const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result, struct replay_step_info *info);
+
+#endif // _EQUATIONS_REPLAY_H
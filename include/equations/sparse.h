@@ -0,0 +1,68 @@
+#ifndef _EQUATIONS_SPARSE_H
+#define _EQUATIONS_SPARSE_H
+
+#include <equations/utils.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_matrix.h>
+#include <stdbool.h>
+
+
+// Square matrix in CSR format, column indices are sorted within each row
+struct sparse_matrix
+{
+    size_t n, nnz;
+    size_t *row_ptr;
+    size_t *col_idx;
+    double *values;
+};
+
+
+// LU factorization of P*A with the row order and the fill pattern fixed at
+// analysis time, numeric refactorization reuses both
+struct sparse_lu
+{
+    size_t n, nnz;
+    size_t *perm;
+    size_t *row_ptr;
+    size_t *col_idx;
+    size_t *diag;
+    double *values;
+
+    double *work;
+    bool analysed;
+};
+
+
+// The pattern of J is recorded from the Jacobian kernel on the first solve
+// and kept, the kernel then writes straight into the CSR values
+struct sparse_newton_workspace
+{
+    size_t n;
+    char *pattern;
+
+    struct sparse_matrix *J;
+    struct sparse_lu *lu;
+
+    gsl_vector *f;
+    gsl_vector *f_trial;
+    gsl_vector *x_trial;
+    gsl_vector *dx;
+};
+
+
+struct sparse_matrix *sparse_matrix_alloc(size_t n, const char *pattern);
+void sparse_matrix_free(struct sparse_matrix *m);
+
+struct sparse_lu *sparse_lu_alloc(size_t n);
+void sparse_lu_free(struct sparse_lu *lu);
+int sparse_lu_analyse(struct sparse_lu *lu, const struct sparse_matrix *A);
+int sparse_lu_factorize(struct sparse_lu *lu, const struct sparse_matrix *A);
+int sparse_lu_solve(const struct sparse_lu *lu, const gsl_vector *b, gsl_vector *x);
+
+struct sparse_newton_workspace *sparse_newton_alloc(size_t n);
+void sparse_newton_free(struct sparse_newton_workspace *ws);
+// Forgets the pattern, needed before solving a system with another one
+void sparse_newton_reset(struct sparse_newton_workspace *ws);
+int sparse_newton_solve(struct sparse_newton_workspace *ws, gsl_solver_f_t f, solver_jac_t jac, void *params, gsl_vector *x, size_t max_iters, double eps, size_t *iters, const struct solver_cancel *cancel);
+
+#endif // _EQUATIONS_SPARSE_H
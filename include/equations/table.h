@@ -0,0 +1,46 @@
+#ifndef _EQUATIONS_TABLE_H
+#define _EQUATIONS_TABLE_H
+
+#include <equations/utils.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TABLE_VERSION 1
+#define TABLE_NAME_SIZE 32
+#define TABLE_ROWS_UNKNOWN UINT64_MAX
+
+
+// Columnar result file, meant to be mapped as is, e.g. by numpy.memmap in
+// scripts/cw_table.py. The file is the header, n_columns names of
+// TABLE_NAME_SIZE bytes each padded with NUL and then the rows of n_columns
+// doubles. Everything is in host byte order and the rows start 8-aligned.
+// n_rows is only filled when the writer is closed on a seekable stream,
+// readers should trust the file size
+struct table_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t model;             // number of levels, 0 for anything else
+    uint32_t n_columns;
+    uint32_t header_size;       // offset of the first row
+    uint64_t n_rows;
+};
+
+// Streams rows to a FILE opened by the caller
+struct table_writer;
+
+
+// NULL when a name does not fit in TABLE_NAME_SIZE - 1 bytes or writing the header fails
+struct table_writer *table_writer_alloc(FILE *stream, uint32_t model, const char *const *names, size_t n_columns);
+// Columns named after the fields, e.g. system_2_levels_result_fields
+struct table_writer *table_writer_alloc_fields(FILE *stream, uint32_t model, const struct field_desc *fields, size_t n_fields);
+
+int table_writer_append(struct table_writer *writer, const double *rows, size_t n_rows);
+// One row gathered from the fields of record, which must be those the writer was allocated with
+int table_writer_append_fields(struct table_writer *writer, const struct field_desc *fields, const void *record);
+
+// Flushes, fills n_rows when the stream can seek and frees the writer, the
+// stream stays open
+int table_writer_close(struct table_writer *writer);
+
+#endif // _EQUATIONS_TABLE_H
@@ -0,0 +1,26 @@
+#ifndef _EQUATIONS_TRIPLE_BUFFER_H
+#define _EQUATIONS_TRIPLE_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+// Hands the latest value of a fixed size from one writer thread to one
+// reader thread without locks. The writer fills a back slot and swaps it
+// with the middle one, the reader swaps the middle slot into the front when
+// it is newer. Neither side ever waits for the other
+struct triple_buffer;
+
+
+// All three slots start as copies of init, zeroed when it is NULL
+struct triple_buffer *triple_buffer_alloc(size_t size, const void *init);
+void triple_buffer_free(struct triple_buffer *tb);
+
+// Writer side, copies value in
+void triple_buffer_publish(struct triple_buffer *tb, const void *value);
+
+// Reader side, the latest published value stays valid and unchanged until
+// the next acquire. *fresh tells whether it differs from the previous one
+const void *triple_buffer_acquire(struct triple_buffer *tb, bool *fresh);
+
+#endif // _EQUATIONS_TRIPLE_BUFFER_H
@@ -3,16 +3,137 @@
 
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_matrix.h>
+#include <gsl/gsl_errno.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 
+#define FIELD_DESC(type,field) { #field, offsetof(type,field) }
+
 typedef int (*gsl_solver_f_t)(const gsl_vector *x, void *params, gsl_vector *f);
 typedef int (*gsl_solver_df_t)(const gsl_vector *x, void *params, gsl_matrix *df);
 typedef int (*gsl_solver_fdf_t)(const gsl_vector *x, void *params, gsl_vector *f, gsl_matrix *df);
 
+// Where a Jacobian kernel writes: a dense matrix, or the values of a CSR
+// matrix of n rows. With values NULL the kernel only marks the entries it
+// writes in pattern (n*n), so the pattern follows from the equations and not
+// from the values at some x. Kernels must write the same entries for every x
+struct jacobian
+{
+    gsl_matrix *dense;
+    size_t n;
+    const size_t *row_ptr, *col_idx;
+    double *values;
+    char *pattern;
+    double discard;
+};
+
+typedef int (*solver_jac_t)(const gsl_vector *x, void *params, struct jacobian *J);
+
+// Polled by the solvers between iterations, true abandons the solve
+typedef bool (*solver_cancel_t)(void *data);
+
+// Status of a solve abandoned on request, past the GSL error codes
+#define SOLVER_ECANCELLED (GSL_EOF + 1)
+
+
+enum solver_backend
+{
+    SOLVER_BACKEND_DENSE,           // GSL multiroot fdfsolver on the dense Jacobian
+    SOLVER_BACKEND_SPARSE_NEWTON,   // Newton on the CSR Jacobian with reused symbolic LU
+    SOLVER_BACKEND_FIXED_NEWTON     // Newton on stack arrays sized by N_eq, no heap use
+};
+
+
+// Filled by a solver context on every eval once attached with its
+// *_ctx_set_stats. Times are wall seconds, t_linear is the rest of the solve
+// besides f and df: factorization, back-substitution and step control
+struct solver_stats
+{
+    int status;
+    bool warm;                  // converged from the warm start
+    size_t iterations;
+    size_t f_calls, df_calls;
+    double residual;            // sum of |f_i| at the returned point, as tested against eps
+
+    double t_init;
+    double t_f, t_df, t_linear;
+    double t_total;
+};
+
+
+// Params of solver_probe_f/df/fdf, which count and time the calls of the
+// wrapped system into stats
+struct solver_probe
+{
+    gsl_solver_f_t f;
+    gsl_solver_df_t df;
+    gsl_solver_fdf_t fdf;
+    solver_jac_t jac;
+    void *params;
+    struct solver_stats *stats;
+};
+
+
+struct solver_cancel
+{
+    solver_cancel_t cancelled;
+    void *data;
+};
+
+// Damped Newton on a system of a size fixed at compile time, solves from x
+// in place. Instances come from equations/fixed_newton.h
+typedef int (*fixed_newton_solve_t)(void *params, double *x, size_t max_iters, double eps, size_t *iters, struct solver_stats *stats, const struct solver_cancel *cancel);
+
+
+// Named double member of a params/result struct
+struct field_desc
+{
+    const char *name;
+    size_t offset;
+};
+
 
-gsl_vector *vector_centred(const gsl_vector *v, const gsl_vector *center);
+// Circular arc bounding a chamber, runs over theta = a + (alpha + beta*t)*phi
+// for t in [0,1]. Arc point is (cx - r*cos(theta), cy + r*sin(theta)), i_*
+// are the positions of the parameters in the unknowns vector or -1 if fixed
+struct chamber_arc
+{
+    double cx, cy, r, a, phi;
+    double alpha, beta;
+    int i_cx, i_cy, i_r, i_a, i_phi;
+};
+
+// Partials of a chamber area by the parameters of one of its arcs
+struct chamber_arc_grad
+{
+    double d_cx, d_cy, d_r, d_a, d_phi;
+};
+
+
+// Monotonic wall clock in seconds
+double solver_clock();
+
+int solver_probe_f(const gsl_vector *x, void *p, gsl_vector *f);
+int solver_probe_df(const gsl_vector *x, void *p, gsl_matrix *J);
+int solver_probe_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J);
+int solver_probe_jac(const gsl_vector *x, void *p, struct jacobian *J);
+
+void solver_stats_reset(struct solver_stats *stats);
+
+// False for NULL or an unset callback
+bool solver_cancelled(const struct solver_cancel *cancel);
+
+// Closes the stats of a solve started at t_start: the remaining time goes to
+// t_linear and the residual is evaluated by f at x into f_x, not counted
+void solver_stats_finish(struct solver_stats *stats, int status, size_t iterations, double t_start, gsl_solver_f_t f, void *params, const gsl_vector *x, gsl_vector *f_x);
+
+const struct field_desc *field_find(const struct field_desc *fields, size_t n_fields, const char *name);
+
+// res = v - center, res may be v
+void vector_centred(const gsl_vector *v, const gsl_vector *center, gsl_vector *res);
 
 int center_from_points_and_radius(const gsl_vector *p1, const gsl_vector *p2, double r, gsl_vector *center);
 
@@ -22,6 +143,42 @@ double area_between_vectors_triangle(const gsl_vector *a, const gsl_vector *b);
 
 double area_segment(double ang, double r);
 
+// Exact area enclosed by the arcs joined end to start by chords, grad[i]
+// receives the partials by the parameters of arcs[i] when it is not NULL
+double chamber_area(const struct chamber_arc *arcs, size_t n_arcs, struct chamber_arc_grad *grad);
+
+// Adds scale*grad to the row of J, only the entries of the arcs' unknowns are touched
+void chamber_area_grad_scatter(const struct chamber_arc *arcs, size_t n_arcs, const struct chamber_arc_grad *grad, double scale, struct jacobian *J, size_t row);
+
+static inline struct jacobian jacobian_dense(gsl_matrix *J)
+{
+    return (struct jacobian){J,J->size1,NULL,NULL,NULL,NULL,0};
+}
+
+// Entry (i,j) of J, a scratch one when J does not store it
+static inline double *jacobian_entry(struct jacobian *J, size_t i, size_t j)
+{
+    if(J->dense)
+        return gsl_matrix_ptr(J->dense,i,j);
+    if(!J->values)
+        J->pattern[i*J->n+j] = 1;
+    else
+    {
+        for(size_t p = J->row_ptr[i]; p < J->row_ptr[i+1]; ++p)
+            if(J->col_idx[p] == j)
+                return &J->values[p];
+    }
+
+    return &J->discard;
+}
+
+static inline void jacobian_set(struct jacobian *J, size_t i, size_t j, double v)
+{
+    *jacobian_entry(J,i,j) = v;
+}
+
+void jacobian_zero(struct jacobian *J);
+
 double add_angs(double ang1, double ang2);
 
 int point_from_alpha(double alpha, double norm, gsl_vector *center, gsl_vector *v);
@@ -32,4 +189,7 @@ void J_estimate(const gsl_vector *x0, void *params, gsl_matrix *J_est, int (*f)(
 
 void print_J_diff(FILE *stream, const gsl_vector *x, void *params, gsl_solver_f_t f, gsl_solver_df_t df);
 
+// Same report against an exact reference Jacobian, e.g. the AD one
+void print_J_diff_ref(FILE *stream, const gsl_vector *x, void *params, gsl_solver_df_t df, gsl_solver_df_t df_ref);
+
 #endif
\ No newline at end of file
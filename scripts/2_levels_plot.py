@@ -1,39 +1,39 @@
 import matplotlib.pyplot as plt
 import numpy as np
 from math import pi
+from cw_table import read_table
 
 
 def plot_data(fn: str, linestyle='solid', linecolor='black'):
-    with open(fn,'r') as f:
-        data_raw = f.read().split('\n')
-        if data_raw[-1] == '':
-            data_raw = data_raw[:-1]
-        data = list(map(lambda x: float(x), data_raw))
+    model, table = read_table(fn)
+    if model != 2 or len(table) == 0:
+        raise ValueError(f'{fn}: no 2-level result')
+    data = table[0]
 
-    phi_ad = data[0]
-    r_ad = data[1]
-    x_ad = data[2]
-    y_ad = data[3]
-    a_ad = pi-data[4]
-    phi_cb = data[5]
-    r_cb = data[6]
-    x_cb = data[7]
-    y_cb = data[8]
-    a_cb = pi-data[9]
-    phi_dc = data[10]
-    r_dc = data[11]
-    x_dc = data[12]
-    y_dc = data[13]
-    a_dc = pi-data[14]
-    phi_ed = data[15]
-    r_ed = data[16]
-    y_ed = data[17]
+    phi_ad = data['phi_ad']
+    r_ad = data['r_ad']
+    x_ad = data['x_ad']
+    y_ad = data['y_ad']
+    a_ad = pi-data['a_ad']
+    phi_cb = data['phi_cb']
+    r_cb = data['r_cb']
+    x_cb = data['x_cb']
+    y_cb = data['y_cb']
+    a_cb = pi-data['a_cb']
+    phi_dc = data['phi_dc']
+    r_dc = data['r_dc']
+    x_dc = data['x_dc']
+    y_dc = data['y_dc']
+    a_dc = pi-data['a_dc']
+    phi_ed = data['phi_ed']
+    r_ed = data['r_ed']
+    y_ed = data['y_ed']
     a_ed = 3*pi/2
-    phi_ec = data[18]
-    r_ec = data[19]
-    y_ec = data[20]
+    phi_ec = data['phi_ec']
+    r_ec = data['r_ec']
+    y_ec = data['y_ec']
     a_ec = 3*pi/2
-    x_bot = data[21]
+    x_bot = data['x_bot']
 
 
     grain = 100
@@ -66,6 +66,6 @@ def plot_data(fn: str, linestyle='solid', linecolor='black'):
     plt.plot(xs_ec,ys_ec,linestyle=linestyle,color=linecolor)
 
 
-plot_data('2_levels.txt')
-plot_data('2_levels_init.txt',linestyle='dotted')
+plot_data('2_levels.cwt')
+plot_data('2_levels_init.cwt',linestyle='dotted')
 plt.show()
\ No newline at end of file
@@ -1,54 +1,54 @@
 import matplotlib.pyplot as plt
 import numpy as np
 from math import pi
+from cw_table import read_table
 
 
 def plot_data(fn: str, linestyle='solid', linecolor='black'):
-    with open(fn,'r') as f:
-        data_raw = f.read().split('\n')
-        if data_raw[-1] == '':
-            data_raw = data_raw[:-1]
-        data = list(map(lambda x: float(x), data_raw))
+    model, table = read_table(fn)
+    if model != 3 or len(table) == 0:
+        raise ValueError(f'{fn}: no 3-level result')
+    data = table[0]
 
-    phi_ad = data[0]
-    r_ad = data[1]
-    x_ad = data[2]
-    y_ad = data[3]
-    a_ad = pi-data[4]
-    phi_cb = data[5]
-    r_cb = data[6]
-    x_cb = data[7]
-    y_cb = data[8]
-    a_cb = pi-data[9]
-    phi_dc = data[10]
-    r_dc = data[11]
-    x_dc = data[12]
-    y_dc = data[13]
-    a_dc = pi-data[14]
-    phi_df = data[15]
-    r_df = data[16]
-    x_df = data[17]
-    y_df = data[18]
-    a_df = pi-data[19]
-    phi_ec = data[20]
-    r_ec = data[21]
-    x_ec = data[22]
-    y_ec = data[23]
-    a_ec = pi-data[24]
-    phi_fe = data[25]
-    r_fe = data[26]
-    x_fe = data[27]
-    y_fe = data[28]
-    a_fe = pi-data[29]
-    phi_ge = data[30]
-    r_ge = data[31]
-    y_ge = data[32]
+    phi_ad = data['phi_ad']
+    r_ad = data['r_ad']
+    x_ad = data['x_ad']
+    y_ad = data['y_ad']
+    a_ad = pi-data['a_ad']
+    phi_cb = data['phi_cb']
+    r_cb = data['r_cb']
+    x_cb = data['x_cb']
+    y_cb = data['y_cb']
+    a_cb = pi-data['a_cb']
+    phi_dc = data['phi_dc']
+    r_dc = data['r_dc']
+    x_dc = data['x_dc']
+    y_dc = data['y_dc']
+    a_dc = pi-data['a_dc']
+    phi_df = data['phi_df']
+    r_df = data['r_df']
+    x_df = data['x_df']
+    y_df = data['y_df']
+    a_df = pi-data['a_df']
+    phi_ec = data['phi_ec']
+    r_ec = data['r_ec']
+    x_ec = data['x_ec']
+    y_ec = data['y_ec']
+    a_ec = pi-data['a_ec']
+    phi_fe = data['phi_fe']
+    r_fe = data['r_fe']
+    x_fe = data['x_fe']
+    y_fe = data['y_fe']
+    a_fe = pi-data['a_fe']
+    phi_ge = data['phi_ge']
+    r_ge = data['r_ge']
+    y_ge = data['y_ge']
     a_ge = -pi/2
-    phi_gf = data[33]
-    r_gf = data[34]
-    y_gf = data[35]
+    phi_gf = data['phi_gf']
+    r_gf = data['r_gf']
+    y_gf = data['y_gf']
     a_gf = -pi/2
-    x_bot = data[36]
+    x_bot = data['x_bot']
 
     grain = 100
 
@@ -95,6 +95,6 @@ def plot_data(fn: str, linestyle='solid', linecolor='black'):
     plt.plot(xs_gf,ys_gf,linestyle=linestyle,color=linecolor)
 
 
-plot_data('3_levels.txt')
-plot_data('3_levels_init.txt',linestyle='dotted')
+plot_data('3_levels.cwt')
+plot_data('3_levels_init.cwt',linestyle='dotted')
 plt.show()
\ No newline at end of file
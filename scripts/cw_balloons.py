@@ -0,0 +1,36 @@
+import numpy as np
+import _balloons
+
+
+# NumPy side of the _balloons extension (cw_python target, put the build
+# directory on PYTHONPATH). Records are the C user params and result structs,
+# arrays of these dtypes are handed to the solver without a copy
+
+
+def params_dtype(model: int):
+    names, _ = _balloons.fields(model)
+    return np.dtype([(name,'=f8') for name in names])
+
+
+def result_dtype(model: int):
+    _, names = _balloons.fields(model)
+    return np.dtype([(name,'=f8') for name in names])
+
+
+def default_params(model: int, n=1):
+    params = np.empty(n,dtype=params_dtype(model))
+    params[:] = _balloons.default_params(model)
+    return params
+
+
+def solve(model: int, params, results=None, adiabatic=False, backend=None, threads=0):
+    """Solves every record of params, in parallel with the GIL released.
+    results is filled in place when given, backend None is the default of
+    the model. Returns the results and the GSL status of each record, 0 when
+    it converged."""
+    params = np.ascontiguousarray(params,dtype=params_dtype(model))
+    if results is None:
+        results = np.empty(params.shape,dtype=result_dtype(model))
+    status = np.empty(params.shape,dtype=np.int32)
+    _balloons.solve(model,params,results,adiabatic=adiabatic,backend=backend,threads=threads,status=status)
+    return results, status
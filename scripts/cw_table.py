@@ -0,0 +1,40 @@
+import os
+import numpy as np
+
+
+# Layout of include/equations/table.h
+TABLE_MAGIC = b'CWTABLE\0'
+TABLE_VERSION = 1
+TABLE_NAME_SIZE = 32
+
+header_dtype = np.dtype([
+    ('magic','S8'),
+    ('version','=u4'),
+    ('model','=u4'),
+    ('n_columns','=u4'),
+    ('header_size','=u4'),
+    ('n_rows','=u8')
+])
+
+
+def read_table(fn: str, mode='r'):
+    """Maps a table written by table_writer. Returns the model (number of
+    levels, 0 if none) and a structured array with one float64 field per
+    column, rows past a partially written one are left out."""
+    header = np.fromfile(fn,dtype=header_dtype,count=1)
+    if len(header) != 1 or header['magic'][0] != TABLE_MAGIC.rstrip(b'\0'):
+        raise ValueError(f'{fn}: not a result table')
+    header = header[0]
+    if header['version'] != TABLE_VERSION:
+        raise ValueError(f'{fn}: unsupported table version {header["version"]}')
+
+    n_columns = int(header['n_columns'])
+    header_size = int(header['header_size'])
+    names = np.fromfile(fn,dtype=f'S{TABLE_NAME_SIZE}',count=n_columns,offset=header_dtype.itemsize)
+    dtype = np.dtype([(name.decode(),'=f8') for name in names])
+
+    n_rows = (os.path.getsize(fn) - header_size)//dtype.itemsize
+    if n_rows == 0:
+        return int(header['model']), np.zeros(0,dtype=dtype)
+
+    return int(header['model']), np.memmap(fn,dtype=dtype,mode=mode,offset=header_size,shape=(n_rows,))
@@ -0,0 +1,454 @@
+#!/usr/bin/env python3
+"""Generates straight-line residual and Jacobian kernels of the stacks built
+by system_n_levels_stack.
+
+    cw_topology topology.txt
+    gen_kernels.py topology.txt n_levels_kernels.c
+
+The stacks and their unknowns are read from the dump of cw_topology, so they
+are the ones system_n_levels_stack and system_n_levels_assemble build. Every
+stack also gets its instance of equations/fixed_newton.h on these kernels. The
+residual of every stack is traced into an expression graph following
+__system_n_levels_fdf_general row by row, equal subexpressions are merged
+while the graph is built and the Jacobian is its symbolic derivative, so only
+its nonzero entries are emitted. Everything that depends on the initial
+configuration is read from struct system_n_levels.
+"""
+
+import sys
+
+
+AMBIENT_RIGHT = -2
+ISOTHERMAL, ADIABATIC = 0, 1
+LAW_NAMES = {ISOTHERMAL: "isothermal", ADIABATIC: "adiabatic"}
+
+# Equation flags of a junction, as in n_levels.h
+CONT = dict(x=1, y=2)
+BAL = dict(x=4, y=8)
+
+
+class Graph:
+    """Expression DAG, nodes are hash-consed so a repeated subexpression is
+    stored and evaluated once"""
+
+    def __init__(self):
+        self.nodes = []
+        self.index = {}
+        self.derivs = {}
+
+    def node(self, op, *args, value=None):
+        key = (op, args, value)
+        if key in self.index:
+            return self.index[key]
+        support = frozenset()
+        for a in args:
+            support |= self.nodes[a].support
+        if op == "var":
+            support = frozenset((value,))
+        n = Node(self, len(self.nodes), op, args, value, support)
+        self.nodes.append(n)
+        self.index[key] = n.id
+        return n.id
+
+    def const(self, v):
+        return self.node("const", value=float(v))
+
+    def var(self, i):
+        return self.node("var", value=i)
+
+    def par(self, c):
+        return self.node("par", value=c)
+
+    def is_const(self, a, v=None):
+        n = self.nodes[a]
+        return n.op == "const" and (v is None or n.value == v)
+
+    def add(self, a, b):
+        if self.is_const(a) and self.is_const(b):
+            return self.const(self.nodes[a].value + self.nodes[b].value)
+        if self.is_const(a, 0.0):
+            return b
+        if self.is_const(b, 0.0):
+            return a
+        return self.node("add", *sorted((a, b)))
+
+    def neg(self, a):
+        n = self.nodes[a]
+        if n.op == "const":
+            return self.const(-n.value)
+        if n.op == "neg":
+            return n.args[0]
+        return self.node("neg", a)
+
+    def sub(self, a, b):
+        return self.add(a, self.neg(b))
+
+    def mul(self, a, b):
+        if self.is_const(a) and self.is_const(b):
+            return self.const(self.nodes[a].value*self.nodes[b].value)
+        if self.is_const(a, 0.0) or self.is_const(b, 0.0):
+            return self.const(0)
+        if self.is_const(a, 1.0):
+            return b
+        if self.is_const(b, 1.0):
+            return a
+        if self.is_const(a, -1.0):
+            return self.neg(b)
+        if self.is_const(b, -1.0):
+            return self.neg(a)
+        return self.node("mul", *sorted((a, b)))
+
+    def div(self, a, b):
+        if self.is_const(a, 0.0):
+            return a
+        return self.node("div", a, b)
+
+    def sin(self, a):
+        return self.node("sin", a)
+
+    def abs(self, a):
+        return self.node("abs", a)
+
+    def cos(self, a):
+        return self.node("cos", a)
+
+    # a^e with e free of unknowns
+    def pow(self, a, e):
+        return self.node("pow", a, e)
+
+    def sum(self, terms):
+        s = self.const(0)
+        for t in terms:
+            s = self.add(s, t)
+        return s
+
+    def d(self, a, j):
+        """Partial of node a by the j-th unknown"""
+        if j not in self.nodes[a].support:
+            return self.const(0)
+        key = (a, j)
+        if key in self.derivs:
+            return self.derivs[key]
+
+        n = self.nodes[a]
+        op, args = n.op, n.args
+        if op == "var":
+            r = self.const(1)
+        elif op == "add":
+            r = self.add(self.d(args[0], j), self.d(args[1], j))
+        elif op == "neg":
+            r = self.neg(self.d(args[0], j))
+        elif op == "mul":
+            r = self.add(self.mul(self.d(args[0], j), args[1]),
+                         self.mul(args[0], self.d(args[1], j)))
+        elif op == "div":
+            da = self.div(self.d(args[0], j), args[1])
+            db = self.mul(self.div(a, args[1]), self.d(args[1], j))
+            r = self.sub(da, db)
+        elif op == "sin":
+            r = self.mul(self.cos(args[0]), self.d(args[0], j))
+        elif op == "cos":
+            r = self.neg(self.mul(self.sin(args[0]), self.d(args[0], j)))
+        elif op == "abs":
+            r = self.mul(self.node("sign", args[0]), self.d(args[0], j))
+        elif op == "pow":
+            # e*a^e/a reuses the power itself
+            r = self.mul(self.mul(args[1], self.div(a, args[0])), self.d(args[0], j))
+        else:
+            raise ValueError(op)
+
+        self.derivs[key] = r
+        return r
+
+
+class Node:
+    __slots__ = ("graph", "id", "op", "args", "value", "support")
+
+    def __init__(self, graph, id, op, args, value, support):
+        self.graph = graph
+        self.id = id
+        self.op = op
+        self.args = args
+        self.value = value
+        self.support = support
+
+
+def read_stacks(path):
+    """Stacks of the dump of cw_topology, in its order"""
+    stacks = []
+    with open(path) as dump:
+        for line in dump:
+            kind, *v = line.split()
+            if kind == "stack":
+                stacks.append(dict(n_levels=int(v[0]), law=int(v[1]), n_eq=int(v[2]), n_membranes=int(v[3]),
+                                   hash=int(v[4]), arcs=[], junctions=[], chambers=[]))
+                continue
+            s = stacks[-1]
+            if kind == "arc":
+                i = [int(a) for a in v[1:]]
+                s["arcs"].append(dict(alpha=float(v[0]), a_fixed=bool(i[0]), cx_shared=i[1], inner=i[2],
+                                      outer=i[3], membrane=i[4],
+                                      idx=dict(zip(("phi", "r", "cx", "cy", "a"), i[5:10]))))
+            elif kind == "junction":
+                i = [int(a) for a in v]
+                ends = [(i[3 + 2*k], i[4 + 2*k]) for k in range(i[2])]
+                s["junctions"].append(dict(fixed=bool(i[0]), eqs=i[1], ends=ends))
+            elif kind == "chamber":
+                i = [int(a) for a in v]
+                s["chambers"].append(dict(p=i[0], arcs=i[2:2 + i[1]]))
+            else:
+                raise ValueError("unknown line: " + line)
+    return stacks
+
+
+class System:
+    """Residual rows of one stack and law as nodes of g"""
+
+    def __init__(self, g, stack):
+        self.g = g
+        arcs, junctions, chambers = stack["arcs"], stack["junctions"], stack["chambers"]
+        law = stack["law"]
+        self.arcs = arcs
+        self.n_eq = stack["n_eq"]
+
+        q = []
+        for i, a in enumerate(arcs):
+            s = {key: g.var(v) for key, v in a["idx"].items() if v >= 0}
+            if a["idx"]["a"] < 0:
+                s["a"] = g.par("sys->topo.arcs[%d].s0.a" % i)
+            q.append(s)
+        p = [g.var(c["p"]) for c in chambers]
+        p_ac = g.par("sys->topo.p_ac")
+
+        def side(c):
+            if c >= 0:
+                return p[c]
+            return p_ac if c == AMBIENT_RIGHT else g.const(0)
+
+        def angle(a, t):
+            return g.add(q[a]["a"], g.mul(g.const(arcs[a]["alpha"] + t), q[a]["phi"]))
+
+        def point(a, t, comp):
+            ang = angle(a, t)
+            if comp == "x":
+                return g.sub(q[a]["cx"], g.mul(q[a]["r"], g.cos(ang)))
+            return g.add(q[a]["cy"], g.mul(q[a]["r"], g.sin(ang)))
+
+        def tension(a, t, comp):
+            ang = angle(a, t)
+            trig = g.sin(ang) if comp == "x" else g.cos(ang)
+            dp = g.sub(side(arcs[a]["inner"]), side(arcs[a]["outer"]))
+            T = g.mul(g.mul(dp, q[a]["r"]), trig)
+            return T if t == 0 else g.neg(T)
+
+        rows = []
+        for m in range(stack["n_membranes"]):
+            L = g.sum(g.mul(q[i]["r"], q[i]["phi"]) for i, a in enumerate(arcs) if a["membrane"] == m)
+            rows.append(g.sub(L, g.par("sys->L_0[%d]" % m)))
+
+        for j, jn in enumerate(junctions):
+            for comp in ("x", "y"):
+                if not jn["eqs"] & CONT[comp]:
+                    continue
+                if jn["fixed"]:
+                    rows.append(g.sub(point(*jn["ends"][0], comp), g.par("sys->topo.junctions[%d].%s" % (j, comp))))
+                    continue
+                v0 = point(*jn["ends"][0], comp)
+                for end in jn["ends"][1:]:
+                    rows.append(g.sub(v0, point(*end, comp)))
+
+        for jn in junctions:
+            for comp in ("x", "y"):
+                if jn["eqs"] & BAL[comp]:
+                    rows.append(g.sum(tension(a, t, comp) for a, t in jn["ends"]))
+
+        for c, chamber in enumerate(chambers):
+            p_0 = g.par("sys->topo.chambers[%d].p_0" % c)
+            if law == ISOTHERMAL:
+                rows.append(g.sub(p[c], p_0))
+                continue
+            k = g.par("sys->topo.k")
+            S = self.area(q, chamber["arcs"])
+            rows.append(g.sub(g.mul(p_0, g.pow(g.par("sys->S_0[%d]" % c), k)), g.mul(p[c], g.pow(S, k))))
+
+        if len(rows) != self.n_eq:
+            raise ValueError("%d rows for %d unknowns" % (len(rows), self.n_eq))
+        self.rows = rows
+
+    def area(self, q, chamber):
+        """chamber_area of the arcs traversed by increasing t, unsigned as it is"""
+        g = self.g
+        terms, ends = [], []
+        for a in chamber:
+            s = q[a]
+            ang_0 = g.add(s["a"], g.mul(g.const(self.arcs[a]["alpha"]), s["phi"]))
+            ang_1 = g.add(ang_0, s["phi"])
+            sin_0, cos_0, sin_1, cos_1 = g.sin(ang_0), g.cos(ang_0), g.sin(ang_1), g.cos(ang_1)
+            tri = g.add(g.mul(s["cx"], g.sub(sin_1, sin_0)), g.mul(s["cy"], g.sub(cos_1, cos_0)))
+            terms.append(g.mul(g.const(0.5), g.mul(s["r"], tri)))
+            terms.append(g.neg(g.mul(g.const(0.5), g.mul(s["phi"], g.mul(s["r"], s["r"])))))
+            ends.append(((g.sub(s["cx"], g.mul(s["r"], cos_0)), g.add(s["cy"], g.mul(s["r"], sin_0))),
+                         (g.sub(s["cx"], g.mul(s["r"], cos_1)), g.add(s["cy"], g.mul(s["r"], sin_1)))))
+        for i in range(len(chamber)):
+            (x_end, y_end), (x_start, y_start) = ends[i][1], ends[(i+1) % len(chamber)][0]
+            cross = g.sub(g.mul(x_end, y_start), g.mul(y_end, x_start))
+            terms.append(g.mul(g.const(0.5), cross))
+        return g.abs(g.sum(terms))
+
+
+def literal(v):
+    s = repr(v)
+    return s if any(c in s for c in ".en") else s + ".0"
+
+
+class Emitter:
+    def __init__(self, g):
+        self.g = g
+
+    def name(self, a):
+        n = self.g.nodes[a]
+        if n.op == "const":
+            return literal(n.value)
+        if n.op == "var":
+            return "x_%d" % n.value
+        return "t_%d" % a
+
+    # a + -b is printed as a - b, the negation itself is not needed
+    def operands(self, n):
+        if n.op == "add" and self.g.nodes[n.args[1]].op == "neg":
+            return (n.args[0], self.g.nodes[n.args[1]].args[0])
+        return n.args
+
+    def expr(self, n):
+        a = [self.name(x) for x in self.operands(n)]
+        if n.op == "par":
+            return n.value
+        if n.op == "add":
+            sign = "-" if self.g.nodes[n.args[1]].op == "neg" else "+"
+            return "%s %s %s" % (a[0], sign, a[1])
+        if n.op == "neg":
+            return "-%s" % a[0]
+        if n.op == "mul":
+            return "%s*%s" % (a[0], a[1])
+        if n.op == "div":
+            return "%s/%s" % (a[0], a[1])
+        if n.op == "abs":
+            return "fabs(%s)" % a[0]
+        if n.op == "sign":
+            return "copysign(1.0,%s)" % a[0]
+        if n.op in ("sin", "cos"):
+            return "%s(%s)" % (n.op, a[0])
+        if n.op == "pow":
+            return "pow(%s,%s)" % (a[0], a[1])
+        raise ValueError(n.op)
+
+    def body(self, f_rows, J_entries, sparse=False):
+        """Declarations of every node the outputs need, in creation order.
+        sparse writes J through struct jacobian instead of a gsl_matrix"""
+        needed, stack = set(), [r for _, r in f_rows] + [e for _, _, e in J_entries]
+        while stack:
+            a = stack.pop()
+            if a in needed:
+                continue
+            needed.add(a)
+            stack.extend(self.operands(self.g.nodes[a]))
+
+        lines = []
+        for a in sorted(needed):
+            n = self.g.nodes[a]
+            if n.op == "const":
+                continue
+            if n.op == "var":
+                lines.append("    const double x_%d = gsl_vector_get(x,%d);" % (n.value, n.value))
+            else:
+                lines.append("    const double t_%d = %s;" % (a, self.expr(n)))
+
+        if J_entries:
+            lines.append("")
+            lines.append("    jacobian_zero(J);" if sparse else "    gsl_matrix_set_zero(J);")
+        for i, r in f_rows:
+            lines.append("    gsl_vector_set(f,%d,%s);" % (i, self.name(r)))
+        for i, j, e in J_entries:
+            lines.append("    %s(J,%d,%d,%s);" % ("jacobian_set" if sparse else "gsl_matrix_set", i, j, self.name(e)))
+        return lines
+
+
+def kernels(stack):
+    g = Graph()
+    s = System(g, stack)
+    f_rows = list(enumerate(s.rows))
+    J_entries = []
+    for i, r in f_rows:
+        for j in sorted(g.nodes[r].support):
+            d = g.d(r, j)
+            if not g.is_const(d, 0.0):
+                J_entries.append((i, j, d))
+
+    e = Emitter(g)
+    name = "__system_n_levels_%d_%s" % (stack["n_levels"], LAW_NAMES[stack["law"]])
+    out = []
+    for suffix, args, f, J in (("f", "gsl_vector *f", f_rows, []),
+                               ("df", "gsl_matrix *J", [], J_entries),
+                               ("fdf", "gsl_vector *f, gsl_matrix *J", f_rows, J_entries),
+                               ("jac", "struct jacobian *J", [], J_entries)):
+        out.append("static int %s_%s(const gsl_vector *x, void *p, %s)" % (name, suffix, args))
+        out.append("{")
+        out.append("    const struct system_n_levels *sys = (const struct system_n_levels*)p;")
+        out.append("")
+        out.extend(e.body(f, J, suffix == "jac"))
+        out.append("")
+        out.append("    return GSL_SUCCESS;")
+        out.append("}")
+        out.append("")
+        out.append("")
+
+    # Damped Newton sized by the stack, calling f and df directly
+    out.append("#define FIXED_NEWTON_N          %d" % stack["n_eq"])
+    out.append("#define FIXED_NEWTON_NAME(s)    %s_fixed_##s" % name)
+    out.append("#define FIXED_NEWTON_F          %s_f" % name)
+    out.append("#define FIXED_NEWTON_DF         %s_df" % name)
+    out.append("#include <equations/fixed_newton.h>")
+    out.append("")
+    out.append("")
+    return name, out
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_kernels.py topology.txt output.c")
+
+    out = ["// Generated by scripts/gen_kernels.py, do not edit",
+           "",
+           "#include <equations/n_levels.h>",
+           "#include <gsl/gsl_errno.h>",
+           "#include <math.h>",
+           "",
+           ""]
+    table = {}
+    for stack in read_stacks(sys.argv[1]):
+        name, lines = kernels(stack)
+        out.extend(lines)
+        table[stack["n_levels"], stack["law"]] = (name, stack)
+
+    # Looked up by depth and law, the size and the topology hash tell
+    # system_n_levels_kernels_find whether the entry is the system at hand
+    out.append("const struct system_n_levels_kernels __system_n_levels_generated[SYSTEM_N_LEVELS_MAX+1][2] =")
+    out.append("{")
+    for n in sorted({n for n, _ in table}):
+        entries = []
+        for law in (ISOTHERMAL, ADIABATIC):
+            if (n, law) not in table:
+                entries.append("[%d] = {0}" % law)
+                continue
+            name, stack = table[n, law]
+            entries.append("[%d] = {%s_f, %s_df, %s_fdf, %s_jac, %s_fixed_solve, %d, UINT64_C(0x%016x)}"
+                           % ((law,) + (name,)*5 + (stack["n_eq"], stack["hash"])))
+        out.append("    [%d] = {%s}," % (n, ", ".join(entries)))
+    out.append("};")
+
+    with open(sys.argv[2], "w") as output:
+        output.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
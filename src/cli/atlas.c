@@ -0,0 +1,542 @@
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/atlas.h>
+#include <equations/batch.h>
+#include <equations/utils.h>
+#include <gsl/gsl_errno.h>
+#include <errno.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// Glue that lets the driver treat both models the same way
+struct atlas_model
+{
+    unsigned n_levels;
+    size_t user_params_size;
+    size_t result_size;
+    const struct field_desc *params;
+    size_t n_params;
+    const struct field_desc *results;
+    size_t n_results;
+
+    void (*default_user_params)(void *user_params);
+    enum solver_backend (*default_backend)(bool adiabatic);
+    void *(*ctx_alloc)(enum solver_backend backend);
+    void (*ctx_free)(void *ctx);
+    void (*ctx_set_warm)(void *ctx, const void *warm);
+    int (*eval)(void *ctx, const void *user_params, void *result, bool adiabatic);
+    int (*lookup)(const struct atlas *atlas, const void *user_params, bool adiabatic, void *result);
+};
+
+
+static void atlas_2_levels_default(void *user_params)
+{
+    system_2_levels_default_user_params(user_params);
+}
+
+static void *atlas_2_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_2_levels_ctx_alloc(backend);
+}
+
+static void atlas_2_levels_ctx_free(void *ctx)
+{
+    system_2_levels_ctx_free(ctx);
+}
+
+static void atlas_2_levels_ctx_set_warm(void *ctx, const void *warm)
+{
+    system_2_levels_ctx_set_warm(ctx,warm);
+}
+
+static int atlas_2_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_2_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_2_levels_ctx_eval(ctx,user_params,result);
+}
+
+static int atlas_2_levels_lookup(const struct atlas *atlas, const void *user_params, bool adiabatic, void *result)
+{
+    return system_2_levels_atlas_lookup(atlas,user_params,adiabatic,result);
+}
+
+
+static void atlas_3_levels_default(void *user_params)
+{
+    system_3_levels_default_user_params(user_params);
+}
+
+static void *atlas_3_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_3_levels_ctx_alloc(backend);
+}
+
+static void atlas_3_levels_ctx_free(void *ctx)
+{
+    system_3_levels_ctx_free(ctx);
+}
+
+static void atlas_3_levels_ctx_set_warm(void *ctx, const void *warm)
+{
+    system_3_levels_ctx_set_warm(ctx,warm);
+}
+
+static int atlas_3_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_3_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_3_levels_ctx_eval(ctx,user_params,result);
+}
+
+static int atlas_3_levels_lookup(const struct atlas *atlas, const void *user_params, bool adiabatic, void *result)
+{
+    return system_3_levels_atlas_lookup(atlas,user_params,adiabatic,result);
+}
+
+
+// Lines of the grid along the last axis are the work items. A line is
+// solved by continuation from its first point, which in turn is warm
+// started from the first point of the previous line when the same worker
+// solved it
+struct atlas_run
+{
+    const struct atlas_model *model;
+    enum solver_backend backend;
+    bool adiabatic;
+    const struct atlas_header *header;
+    const unsigned char *base;
+
+    float *values;
+    size_t failed;
+    pthread_mutex_t failed_lock;
+};
+
+
+struct atlas_worker
+{
+    void *ctx;
+    size_t prev_line;
+    bool prev_valid;
+    unsigned char *line_start;
+    unsigned char *user_params;
+    unsigned char *result;
+};
+
+
+static void *atlas_worker_alloc(void *data)
+{
+    struct atlas_run *run = (struct atlas_run*)data;
+    struct atlas_worker *w = malloc(sizeof(struct atlas_worker));
+    if(!w)
+        return NULL;
+
+    w->ctx = run->model->ctx_alloc(run->backend);
+    w->prev_valid = false;
+    w->line_start = malloc(run->model->result_size);
+    w->user_params = malloc(run->model->user_params_size);
+    w->result = malloc(run->model->result_size);
+    if(!w->ctx || !w->line_start || !w->user_params || !w->result)
+    {
+        if(w->ctx)
+            run->model->ctx_free(w->ctx);
+        free(w->line_start);
+        free(w->user_params);
+        free(w->result);
+        free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+
+static void atlas_worker_free(void *worker, void *data)
+{
+    struct atlas_run *run = (struct atlas_run*)data;
+    struct atlas_worker *w = (struct atlas_worker*)worker;
+    run->model->ctx_free(w->ctx);
+    free(w->line_start);
+    free(w->user_params);
+    free(w->result);
+    free(w);
+}
+
+
+static void atlas_line(size_t line, void *worker, void *data)
+{
+    struct atlas_run *run = (struct atlas_run*)data;
+    struct atlas_worker *w = (struct atlas_worker*)worker;
+    const struct atlas_model *model = run->model;
+    const struct atlas_header *header = run->header;
+    const size_t last = header->n_axes - 1;
+    const size_t n_line = header->axes[last].n;
+    const size_t n_results = header->n_results;
+
+    double *user_params = (double*)w->user_params;
+    memcpy(user_params,run->base,model->user_params_size);
+    size_t rest = line;
+    for(size_t a = last; a-- > 0;)
+    {
+        const struct atlas_axis *axis = &header->axes[a];
+        const size_t i = rest % axis->n;
+        user_params[axis->param] = axis->lo + (axis->hi - axis->lo)*i/(axis->n - 1);
+        rest /= axis->n;
+    }
+
+    model->ctx_set_warm(w->ctx,(w->prev_valid && w->prev_line + 1 == line) ? w->line_start : NULL);
+    w->prev_line = line;
+    w->prev_valid = false;
+
+    size_t failed = 0;
+    const struct atlas_axis *axis = &header->axes[last];
+    for(size_t i = 0; i < n_line; ++i)
+    {
+        user_params[axis->param] = axis->lo + (axis->hi - axis->lo)*i/(axis->n - 1);
+        const int status = model->eval(w->ctx,user_params,w->result,run->adiabatic);
+
+        float *v = run->values + (line*n_line + i)*n_results;
+        const double *result = (const double*)w->result;
+        for(size_t r = 0; r < n_results; ++r)
+            v[r] = status == GSL_SUCCESS ? (float)result[r] : NAN;
+        if(status != GSL_SUCCESS)
+            ++failed;
+        else if(i == 0)
+        {
+            memcpy(w->line_start,w->result,model->result_size);
+            w->prev_valid = true;
+        }
+    }
+
+    if(failed)
+    {
+        pthread_mutex_lock(&run->failed_lock);
+        run->failed += failed;
+        pthread_mutex_unlock(&run->failed_lock);
+    }
+}
+
+
+static void usage(FILE *stream, const char *prog)
+{
+    fprintf(stream,
+        "Usage: %s [options] -o file [param=value | param=start:stop:count]...\n"
+        "       %s [options] -q file [param=value]...\n"
+        "  -m 2|3          model, number of levels (default 2)\n"
+        "  -a              adiabatic equations\n"
+        "  -b backend      dense, sparse or fixed (default fixed for -m 3 -a, sparse otherwise)\n"
+        "  -j threads      worker threads (default: one per CPU)\n"
+        "  -o file         solve the grid and write the atlas to file\n"
+        "  -q file         print the interpolated result of the atlas next to the exact one\n"
+        "  -l              list parameter and result names of the model\n"
+        "Grid axes are uniform, the last one varies fastest and is solved by continuation.\n",prog,prog);
+}
+
+
+static int parse_double(const char *s, double *v)
+{
+    char *end;
+    errno = 0;
+    *v = strtod(s,&end);
+    return (errno || end == s || *end) ? -1 : 0;
+}
+
+
+// Fixed values go to user_params, ranges become axes
+static int parse_spec(const struct atlas_model *model, char *spec, void *user_params, struct atlas_header *header)
+{
+    char *eq = strchr(spec,'=');
+    if(!eq)
+        return -1;
+    *eq = '\0';
+    char *value = eq + 1;
+
+    const struct field_desc *field = field_find(model->params,model->n_params,spec);
+    if(!field)
+    {
+        fprintf(stderr,"Unknown parameter '%s'\n",spec);
+        return -1;
+    }
+    double *param = (double*)((unsigned char*)user_params + field->offset);
+
+    char *c1 = strchr(value,':');
+    if(!c1)
+        return parse_double(value,param);
+
+    char *c2 = strchr(c1+1,':');
+    if(!c2 || !header)
+        return -1;
+    *c1 = '\0';
+    *c2 = '\0';
+    double lo, hi, count;
+    if(parse_double(value,&lo) || parse_double(c1+1,&hi) || parse_double(c2+1,&count) || count < 2 || !(hi > lo))
+        return -1;
+    if(header->n_axes == ATLAS_MAX_AXES)
+    {
+        fprintf(stderr,"Too many axes\n");
+        return -1;
+    }
+
+    struct atlas_axis *axis = &header->axes[header->n_axes++];
+    axis->param = field->offset/sizeof(double);
+    axis->n = (uint32_t)count;
+    axis->lo = lo;
+    axis->hi = hi;
+    *param = lo;
+
+    return 0;
+}
+
+
+static int query(const struct atlas_model *model, const char *path, enum solver_backend backend, int argc, char *argv[])
+{
+    struct atlas *atlas = atlas_open(path);
+    if(!atlas)
+    {
+        fprintf(stderr,"Failed to open atlas '%s'\n",path);
+        return 1;
+    }
+    const struct atlas_header *header = atlas_get_header(atlas);
+    const bool adiabatic = header->adiabatic;
+    if(header->n_levels != model->n_levels)
+    {
+        fprintf(stderr,"Atlas is of the %u-level model\n",header->n_levels);
+        atlas_close(atlas);
+        return 1;
+    }
+
+    unsigned char *user_params = malloc(model->user_params_size);
+    unsigned char *interp = malloc(model->result_size);
+    unsigned char *exact = malloc(model->result_size);
+    memcpy(user_params,atlas_get_base(atlas),model->user_params_size);
+
+    int status = GSL_SUCCESS;
+    for(int a = 0; a < argc && !status; ++a)
+    {
+        if(parse_spec(model,argv[a],user_params,NULL))
+        {
+            fprintf(stderr,"Bad parameter spec '%s'\n",argv[a]);
+            status = GSL_EINVAL;
+        }
+    }
+
+    double t_lookup = 0;
+    if(!status)
+    {
+        const double t = solver_clock();
+        status = model->lookup(atlas,user_params,adiabatic,interp);
+        t_lookup = solver_clock() - t;
+        if(status)
+            fprintf(stderr,"Configuration is not covered by the atlas\n");
+    }
+
+    if(!status)
+    {
+        void *ctx = model->ctx_alloc(backend);
+        model->ctx_set_warm(ctx,interp);
+        const double t = solver_clock();
+        status = model->eval(ctx,user_params,exact,adiabatic);
+        const double t_exact = solver_clock() - t;
+        model->ctx_free(ctx);
+
+        printf("name,interpolated,exact\n");
+        for(size_t r = 0; r < model->n_results; ++r)
+            printf("%s,%.10g,%.10g\n",model->results[r].name,*(const double*)(interp + model->results[r].offset),
+                   *(const double*)(exact + model->results[r].offset));
+        fprintf(stderr,"lookup %.2f us, warm started solve %.2f us, status %d\n",1e6*t_lookup,1e6*t_exact,status);
+    }
+
+    free(exact);
+    free(interp);
+    free(user_params);
+    atlas_close(atlas);
+
+    return status == GSL_SUCCESS ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const struct atlas_model models[] = {
+        {
+            2, sizeof(struct system_2_levels_user_params), sizeof(struct system_2_levels_result),
+            system_2_levels_user_params_fields, system_2_levels_user_params_n_fields,
+            system_2_levels_result_fields, system_2_levels_result_n_fields,
+            atlas_2_levels_default, system_2_levels_default_backend,
+            atlas_2_levels_ctx_alloc, atlas_2_levels_ctx_free, atlas_2_levels_ctx_set_warm,
+            atlas_2_levels_eval, atlas_2_levels_lookup
+        },
+        {
+            3, sizeof(struct system_3_levels_user_params), sizeof(struct system_3_levels_result),
+            system_3_levels_user_params_fields, system_3_levels_user_params_n_fields,
+            system_3_levels_result_fields, system_3_levels_result_n_fields,
+            atlas_3_levels_default, system_3_levels_default_backend,
+            atlas_3_levels_ctx_alloc, atlas_3_levels_ctx_free, atlas_3_levels_ctx_set_warm,
+            atlas_3_levels_eval, atlas_3_levels_lookup
+        }
+    };
+
+    const struct atlas_model *model = &models[0];
+    enum solver_backend backend = SOLVER_BACKEND_DENSE;
+    bool backend_set = false;
+    bool adiabatic = false;
+    bool list = false;
+    int nthreads = 0;
+    const char *out_path = NULL;
+    const char *query_path = NULL;
+
+    int opt;
+    while((opt = getopt(argc,argv,"m:ab:j:o:q:lh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'm':
+                if(!strcmp(optarg,"2"))
+                    model = &models[0];
+                else if(!strcmp(optarg,"3"))
+                    model = &models[1];
+                else
+                {
+                    fprintf(stderr,"Unknown model '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adiabatic = true;
+                break;
+            case 'b':
+                backend_set = true;
+                if(!strcmp(optarg,"dense"))
+                    backend = SOLVER_BACKEND_DENSE;
+                else if(!strcmp(optarg,"sparse"))
+                    backend = SOLVER_BACKEND_SPARSE_NEWTON;
+                else if(!strcmp(optarg,"fixed"))
+                    backend = SOLVER_BACKEND_FIXED_NEWTON;
+                else
+                {
+                    fprintf(stderr,"Unknown backend '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'q':
+                query_path = optarg;
+                break;
+            case 'l':
+                list = true;
+                break;
+            case 'h':
+                usage(stdout,argv[0]);
+                return 0;
+            default:
+                usage(stderr,argv[0]);
+                return 1;
+        }
+    }
+
+    if(!backend_set)
+        backend = model->default_backend(adiabatic);
+
+    if(list)
+    {
+        printf("params:");
+        for(size_t i = 0; i < model->n_params; ++i)
+            printf(" %s",model->params[i].name);
+        printf("\nresults:");
+        for(size_t i = 0; i < model->n_results; ++i)
+            printf(" %s",model->results[i].name);
+        printf("\n");
+        return 0;
+    }
+
+    if(query_path)
+        return query(model,query_path,backend,argc - optind,argv + optind);
+
+    if(!out_path)
+    {
+        usage(stderr,argv[0]);
+        return 1;
+    }
+
+    struct atlas_header header;
+    memset(&header,0,sizeof(header));
+    header.n_levels = model->n_levels;
+    header.adiabatic = adiabatic;
+    header.n_params = model->user_params_size/sizeof(double);
+    header.n_results = model->result_size/sizeof(double);
+
+    unsigned char *base = malloc(model->user_params_size);
+    model->default_user_params(base);
+    size_t total = 1;
+    for(int a = optind; a < argc; ++a)
+    {
+        if(parse_spec(model,argv[a],base,&header))
+        {
+            fprintf(stderr,"Bad parameter spec '%s'\n",argv[a]);
+            usage(stderr,argv[0]);
+            return 1;
+        }
+    }
+    if(header.n_axes == 0)
+    {
+        fprintf(stderr,"At least one param=start:stop:count axis is needed\n");
+        return 1;
+    }
+    for(size_t a = 0; a < header.n_axes; ++a)
+    {
+        if(total > SIZE_MAX/header.axes[a].n)
+        {
+            fprintf(stderr,"Grid is too large\n");
+            return 1;
+        }
+        total *= header.axes[a].n;
+    }
+
+    struct atlas_run run;
+    run.model = model;
+    run.backend = backend;
+    run.adiabatic = adiabatic;
+    run.header = &header;
+    run.base = base;
+    run.values = malloc(total*header.n_results*sizeof(float));
+    run.failed = 0;
+    pthread_mutex_init(&run.failed_lock,NULL);
+    if(!run.values)
+    {
+        fprintf(stderr,"Grid is too large\n");
+        return 1;
+    }
+
+    int status = 0;
+    const size_t n_lines = total/header.axes[header.n_axes - 1].n;
+    if(batch_run(n_lines,nthreads,atlas_worker_alloc,atlas_line,atlas_worker_free,&run) != GSL_SUCCESS)
+    {
+        fprintf(stderr,"Failed to run the solver pool\n");
+        status = 1;
+    }
+    else if(atlas_write(out_path,&header,(const double*)base,run.values) != GSL_SUCCESS)
+    {
+        fprintf(stderr,"Failed to write '%s'\n",out_path);
+        status = 1;
+    }
+    if(run.failed)
+        fprintf(stderr,"%zu of %zu configurations did not converge\n",run.failed,total);
+
+    pthread_mutex_destroy(&run.failed_lock);
+    free(run.values);
+    free(base);
+
+    return status;
+}
@@ -0,0 +1,702 @@
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/n_levels.h>
+#include <equations/utils.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_math.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define BENCH_CORPUS 16
+#define BENCH_MAX_BASELINE 256
+
+
+// Allocations are counted by interposing the allocator, which also sees the
+// ones made inside GSL. Only glibc exposes the underlying functions
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+static size_t bench_allocs = 0;
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&bench_allocs,1,__ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    __atomic_fetch_add(&bench_allocs,1,__ATOMIC_RELAXED);
+    return __libc_calloc(n,size);
+}
+
+void *realloc(void *p, size_t size)
+{
+    __atomic_fetch_add(&bench_allocs,1,__ATOMIC_RELAXED);
+    return __libc_realloc(p,size);
+}
+
+static size_t bench_alloc_count()
+{
+    return __atomic_load_n(&bench_allocs,__ATOMIC_RELAXED);
+}
+#else
+#define BENCH_COUNT_ALLOCS 0
+
+static size_t bench_alloc_count()
+{
+    return 0;
+}
+#endif
+
+
+// Fixed parameter sets, item 0 is the default configuration and the rest
+// are small deterministic perturbations of the pressures around it
+static void bench_corpus_2_levels(size_t i, struct system_2_levels_user_params *user_params)
+{
+    system_2_levels_default_user_params(user_params);
+    user_params->p_top_0 *= 1 + 0.01*((int)(i % 7) - 3);
+    user_params->p_bot_0 *= 1 + 0.01*((int)(i/7 % 5) - 2);
+    user_params->p_ac *= 1 + 0.05*((int)(i % 3) - 1);
+}
+
+
+static void bench_corpus_3_levels(size_t i, struct system_3_levels_user_params *user_params)
+{
+    system_3_levels_default_user_params(user_params);
+    user_params->p_top_0 *= 1 + 0.01*((int)(i % 7) - 3);
+    user_params->p_mid_0 *= 1 + 0.01*((int)(i % 5) - 2);
+    user_params->p_bot_0 *= 1 + 0.01*((int)(i/7 % 5) - 2);
+    user_params->p_ac *= 1 + 0.05*((int)(i % 3) - 1);
+}
+
+
+// Everything a benchmark may need, prepared once from the corpus
+struct bench_state
+{
+    struct system_2_levels_user_params up_2[BENCH_CORPUS];
+    struct system_n_levels sys_2[2][BENCH_CORPUS];     // by law
+    gsl_vector *x_2[BENCH_CORPUS];
+    struct system_3_levels_user_params up_3[BENCH_CORPUS];
+    struct system_n_levels sys_3[2][BENCH_CORPUS];
+    gsl_vector *x_3[BENCH_CORPUS];
+    const struct system_n_levels_kernels *kernels_2[2], *kernels_3[2];
+    struct system_n_levels sys_n;
+    gsl_vector *x_n;
+
+    gsl_vector *f_2, *f_3, *f_n;
+    gsl_matrix *J_2, *J_3, *J_n;
+    struct system_2_levels_ctx *ctx_2[3];
+    struct system_3_levels_ctx *ctx_3[3];
+
+    struct chamber_arc arcs[3];
+    double sink;
+};
+
+
+// One operation on corpus item i, returns the solver iterations, 0 when it
+// does not solve
+typedef size_t (*bench_op_t)(struct bench_state *st, size_t i);
+
+
+struct bench_case
+{
+    const char *name;
+    bench_op_t op;
+};
+
+
+static size_t bench_2_levels_eval(struct bench_state *st, size_t i)
+{
+    struct system_2_levels_result result;
+    struct solver_stats stats = {0};
+    system_2_levels_eval_stats(&st->up_2[i],NULL,&result,system_2_levels_default_backend(false),&stats);
+    st->sink += result.r_ad;
+    return stats.iterations;
+}
+
+static size_t bench_2_levels_adiabatic_eval(struct bench_state *st, size_t i)
+{
+    struct system_2_levels_result result;
+    struct solver_stats stats = {0};
+    system_2_levels_adiabatic_eval_stats(&st->up_2[i],NULL,&result,system_2_levels_default_backend(true),&stats);
+    st->sink += result.r_ad;
+    return stats.iterations;
+}
+
+static size_t bench_3_levels_eval(struct bench_state *st, size_t i)
+{
+    struct system_3_levels_result result;
+    struct solver_stats stats = {0};
+    system_3_levels_eval_stats(&st->up_3[i],NULL,&result,system_3_levels_default_backend(false),&stats);
+    st->sink += result.r_ad;
+    return stats.iterations;
+}
+
+static size_t bench_3_levels_adiabatic_eval(struct bench_state *st, size_t i)
+{
+    struct system_3_levels_result result;
+    struct solver_stats stats = {0};
+    system_3_levels_adiabatic_eval_stats(&st->up_3[i],NULL,&result,system_3_levels_default_backend(true),&stats);
+    st->sink += result.r_ad;
+    return stats.iterations;
+}
+
+
+// Cold solves on a reused context, one per backend
+static size_t bench_2_levels_ctx(struct bench_state *st, size_t i, enum solver_backend backend)
+{
+    struct system_2_levels_result result;
+    system_2_levels_ctx_set_warm(st->ctx_2[backend],NULL);
+    system_2_levels_ctx_eval(st->ctx_2[backend],&st->up_2[i],&result);
+    st->sink += result.r_ad;
+    return system_2_levels_ctx_iterations(st->ctx_2[backend]);
+}
+
+static size_t bench_2_levels_ctx_dense(struct bench_state *st, size_t i)
+{
+    return bench_2_levels_ctx(st,i,SOLVER_BACKEND_DENSE);
+}
+
+static size_t bench_2_levels_ctx_sparse(struct bench_state *st, size_t i)
+{
+    return bench_2_levels_ctx(st,i,SOLVER_BACKEND_SPARSE_NEWTON);
+}
+
+static size_t bench_2_levels_ctx_fixed(struct bench_state *st, size_t i)
+{
+    return bench_2_levels_ctx(st,i,SOLVER_BACKEND_FIXED_NEWTON);
+}
+
+static size_t bench_3_levels_ctx(struct bench_state *st, size_t i, enum solver_backend backend)
+{
+    struct system_3_levels_result result;
+    system_3_levels_ctx_set_warm(st->ctx_3[backend],NULL);
+    system_3_levels_ctx_eval(st->ctx_3[backend],&st->up_3[i],&result);
+    st->sink += result.r_ad;
+    return system_3_levels_ctx_iterations(st->ctx_3[backend]);
+}
+
+static size_t bench_3_levels_ctx_dense(struct bench_state *st, size_t i)
+{
+    return bench_3_levels_ctx(st,i,SOLVER_BACKEND_DENSE);
+}
+
+static size_t bench_3_levels_ctx_sparse(struct bench_state *st, size_t i)
+{
+    return bench_3_levels_ctx(st,i,SOLVER_BACKEND_SPARSE_NEWTON);
+}
+
+static size_t bench_3_levels_ctx_fixed(struct bench_state *st, size_t i)
+{
+    return bench_3_levels_ctx(st,i,SOLVER_BACKEND_FIXED_NEWTON);
+}
+
+
+static size_t bench_2_levels_f(struct bench_state *st, size_t i)
+{
+    st->kernels_2[SYSTEM_N_LEVELS_ISOTHERMAL]->f(st->x_2[i],&st->sys_2[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->f_2);
+    return 0;
+}
+
+static size_t bench_2_levels_df(struct bench_state *st, size_t i)
+{
+    st->kernels_2[SYSTEM_N_LEVELS_ISOTHERMAL]->df(st->x_2[i],&st->sys_2[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->J_2);
+    return 0;
+}
+
+static size_t bench_2_levels_fdf(struct bench_state *st, size_t i)
+{
+    st->kernels_2[SYSTEM_N_LEVELS_ISOTHERMAL]->fdf(st->x_2[i],&st->sys_2[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->f_2,st->J_2);
+    return 0;
+}
+
+static size_t bench_2_levels_adiabatic_f(struct bench_state *st, size_t i)
+{
+    st->kernels_2[SYSTEM_N_LEVELS_ADIABATIC]->f(st->x_2[i],&st->sys_2[SYSTEM_N_LEVELS_ADIABATIC][i],st->f_2);
+    return 0;
+}
+
+static size_t bench_2_levels_adiabatic_df(struct bench_state *st, size_t i)
+{
+    st->kernels_2[SYSTEM_N_LEVELS_ADIABATIC]->df(st->x_2[i],&st->sys_2[SYSTEM_N_LEVELS_ADIABATIC][i],st->J_2);
+    return 0;
+}
+
+static size_t bench_3_levels_f(struct bench_state *st, size_t i)
+{
+    st->kernels_3[SYSTEM_N_LEVELS_ISOTHERMAL]->f(st->x_3[i],&st->sys_3[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->f_3);
+    return 0;
+}
+
+static size_t bench_3_levels_df(struct bench_state *st, size_t i)
+{
+    st->kernels_3[SYSTEM_N_LEVELS_ISOTHERMAL]->df(st->x_3[i],&st->sys_3[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->J_3);
+    return 0;
+}
+
+static size_t bench_3_levels_fdf(struct bench_state *st, size_t i)
+{
+    st->kernels_3[SYSTEM_N_LEVELS_ISOTHERMAL]->fdf(st->x_3[i],&st->sys_3[SYSTEM_N_LEVELS_ISOTHERMAL][i],st->f_3,st->J_3);
+    return 0;
+}
+
+static size_t bench_3_levels_adiabatic_f(struct bench_state *st, size_t i)
+{
+    st->kernels_3[SYSTEM_N_LEVELS_ADIABATIC]->f(st->x_3[i],&st->sys_3[SYSTEM_N_LEVELS_ADIABATIC][i],st->f_3);
+    return 0;
+}
+
+static size_t bench_3_levels_adiabatic_df(struct bench_state *st, size_t i)
+{
+    st->kernels_3[SYSTEM_N_LEVELS_ADIABATIC]->df(st->x_3[i],&st->sys_3[SYSTEM_N_LEVELS_ADIABATIC][i],st->J_3);
+    return 0;
+}
+
+static size_t bench_n_levels_fdf(struct bench_state *st, size_t i)
+{
+    (void)i;
+    system_n_levels_fdf(st->x_n,&st->sys_n,st->f_n,st->J_n);
+    return 0;
+}
+
+
+// Stack of the model and its layout, what precedes every solve
+static void bench_stack(const struct system_n_levels_user_params *stack_params, enum system_n_levels_pressure_law law, struct system_n_levels *sys)
+{
+    struct system_n_levels_topology topo;
+    if(!system_n_levels_stack(stack_params,law,&topo))
+        system_n_levels_assemble(&topo,sys);
+}
+
+static size_t bench_2_levels_init_config(struct bench_state *st, size_t i)
+{
+    struct system_n_levels_user_params stack_params;
+    struct system_n_levels sys;
+    system_2_levels_stack_params(&st->up_2[i],&stack_params);
+    bench_stack(&stack_params,SYSTEM_N_LEVELS_ISOTHERMAL,&sys);
+    system_n_levels_x0(&sys,st->f_2);
+    st->sink += sys.S_0[0];
+    return 0;
+}
+
+static size_t bench_3_levels_init_config(struct bench_state *st, size_t i)
+{
+    struct system_n_levels_user_params stack_params;
+    struct system_n_levels sys;
+    system_3_levels_stack_params(&st->up_3[i],&stack_params);
+    bench_stack(&stack_params,SYSTEM_N_LEVELS_ISOTHERMAL,&sys);
+    system_n_levels_x0(&sys,st->f_3);
+    st->sink += sys.S_0[0];
+    return 0;
+}
+
+static size_t bench_center_from_points(struct bench_state *st, size_t i)
+{
+    double p1_data[2] = {st->up_2[i].Ax,st->up_2[i].Ay};
+    double p2_data[2] = {st->up_2[i].Bx,st->up_2[i].By};
+    double c_data[2];
+    gsl_vector_view p1 = gsl_vector_view_array(p1_data,2);
+    gsl_vector_view p2 = gsl_vector_view_array(p2_data,2);
+    gsl_vector_view c = gsl_vector_view_array(c_data,2);
+    center_from_points_and_radius(&p1.vector,&p2.vector,st->up_2[i].r_top_0,&c.vector);
+    st->sink += c_data[0];
+    return 0;
+}
+
+static size_t bench_vectors_ang(struct bench_state *st, size_t i)
+{
+    double a_data[2] = {st->up_2[i].Ax,st->up_2[i].Ay};
+    double b_data[2] = {st->up_2[i].Bx,-st->up_2[i].By};
+    gsl_vector_view a = gsl_vector_view_array(a_data,2);
+    gsl_vector_view b = gsl_vector_view_array(b_data,2);
+    double ang;
+    vectors_ang_clockwise(&a.vector,&b.vector,&ang);
+    st->sink += ang;
+    return 0;
+}
+
+static size_t bench_chamber_area(struct bench_state *st, size_t i)
+{
+    (void)i;
+    st->sink += chamber_area(st->arcs,3,NULL);
+    return 0;
+}
+
+static size_t bench_chamber_area_grad(struct bench_state *st, size_t i)
+{
+    (void)i;
+    struct chamber_arc_grad grad[3];
+    st->sink += chamber_area(st->arcs,3,grad);
+    return 0;
+}
+
+
+static const struct bench_case bench_cases[] = {
+    {"2_levels_eval", bench_2_levels_eval},
+    {"2_levels_adiabatic_eval", bench_2_levels_adiabatic_eval},
+    {"3_levels_eval", bench_3_levels_eval},
+    {"3_levels_adiabatic_eval", bench_3_levels_adiabatic_eval},
+    {"2_levels_ctx_dense", bench_2_levels_ctx_dense},
+    {"2_levels_ctx_sparse", bench_2_levels_ctx_sparse},
+    {"2_levels_ctx_fixed", bench_2_levels_ctx_fixed},
+    {"3_levels_ctx_dense", bench_3_levels_ctx_dense},
+    {"3_levels_ctx_sparse", bench_3_levels_ctx_sparse},
+    {"3_levels_ctx_fixed", bench_3_levels_ctx_fixed},
+    {"2_levels_f", bench_2_levels_f},
+    {"2_levels_df", bench_2_levels_df},
+    {"2_levels_fdf", bench_2_levels_fdf},
+    {"2_levels_adiabatic_f", bench_2_levels_adiabatic_f},
+    {"2_levels_adiabatic_df", bench_2_levels_adiabatic_df},
+    {"3_levels_f", bench_3_levels_f},
+    {"3_levels_df", bench_3_levels_df},
+    {"3_levels_fdf", bench_3_levels_fdf},
+    {"3_levels_adiabatic_f", bench_3_levels_adiabatic_f},
+    {"3_levels_adiabatic_df", bench_3_levels_adiabatic_df},
+    {"n_levels_4_fdf", bench_n_levels_fdf},
+    {"2_levels_init_config", bench_2_levels_init_config},
+    {"3_levels_init_config", bench_3_levels_init_config},
+    {"center_from_points_and_radius", bench_center_from_points},
+    {"vectors_ang_clockwise", bench_vectors_ang},
+    {"chamber_area", bench_chamber_area},
+    {"chamber_area_grad", bench_chamber_area_grad},
+};
+static const size_t bench_n_cases = sizeof(bench_cases)/sizeof(struct bench_case);
+
+
+static int bench_state_init(struct bench_state *st)
+{
+    memset(st,0,sizeof(struct bench_state));
+
+    const enum system_n_levels_pressure_law laws[2] = {SYSTEM_N_LEVELS_ISOTHERMAL,SYSTEM_N_LEVELS_ADIABATIC};
+    for(size_t i = 0; i < BENCH_CORPUS; ++i)
+    {
+        struct system_n_levels_user_params stack_params;
+        bench_corpus_2_levels(i,&st->up_2[i]);
+        system_2_levels_stack_params(&st->up_2[i],&stack_params);
+        for(size_t l = 0; l < 2; ++l)
+            bench_stack(&stack_params,laws[l],&st->sys_2[laws[l]][i]);
+        bench_corpus_3_levels(i,&st->up_3[i]);
+        system_3_levels_stack_params(&st->up_3[i],&stack_params);
+        for(size_t l = 0; l < 2; ++l)
+            bench_stack(&stack_params,laws[l],&st->sys_3[laws[l]][i]);
+
+        st->x_2[i] = gsl_vector_alloc(st->sys_2[0][i].n_eq);
+        st->x_3[i] = gsl_vector_alloc(st->sys_3[0][i].n_eq);
+        if(!st->x_2[i] || !st->x_3[i])
+            return GSL_ENOMEM;
+        system_n_levels_x0(&st->sys_2[0][i],st->x_2[i]);
+        system_n_levels_x0(&st->sys_3[0][i],st->x_3[i]);
+    }
+    // Every item of the corpus has the structure of the first one
+    for(size_t l = 0; l < 2; ++l)
+    {
+        st->kernels_2[laws[l]] = system_n_levels_kernels(&st->sys_2[laws[l]][0]);
+        st->kernels_3[laws[l]] = system_n_levels_kernels(&st->sys_3[laws[l]][0]);
+    }
+    st->f_2 = gsl_vector_alloc(st->sys_2[0][0].n_eq);
+    st->J_2 = gsl_matrix_alloc(st->sys_2[0][0].n_eq,st->sys_2[0][0].n_eq);
+    st->f_3 = gsl_vector_alloc(st->sys_3[0][0].n_eq);
+    st->J_3 = gsl_matrix_alloc(st->sys_3[0][0].n_eq,st->sys_3[0][0].n_eq);
+    for(int b = SOLVER_BACKEND_DENSE; b <= SOLVER_BACKEND_FIXED_NEWTON; ++b)
+    {
+        st->ctx_2[b] = system_2_levels_ctx_alloc(b);
+        st->ctx_3[b] = system_3_levels_ctx_alloc(b);
+        if(!st->ctx_2[b] || !st->ctx_3[b])
+            return GSL_ENOMEM;
+    }
+
+    struct system_n_levels_user_params up_n;
+    struct system_n_levels_topology topo;
+    system_n_levels_default_user_params(&up_n,4);
+    int status = system_n_levels_stack(&up_n,SYSTEM_N_LEVELS_ADIABATIC,&topo);
+    if(!status)
+        status = system_n_levels_assemble(&topo,&st->sys_n);
+    if(status)
+        return status;
+    st->x_n = gsl_vector_alloc(st->sys_n.n_eq);
+    st->f_n = gsl_vector_alloc(st->sys_n.n_eq);
+    st->J_n = gsl_matrix_alloc(st->sys_n.n_eq,st->sys_n.n_eq);
+    system_n_levels_x0(&st->sys_n,st->x_n);
+
+    // Top chamber of the default 2-level configuration, A -> D -> C -> B, the
+    // top level leads the unknowns of the stack
+    const gsl_vector *x = st->x_2[0];
+    const size_t offsets[3] = {0,10,5};
+    for(size_t k = 0; k < 3; ++k)
+    {
+        const int o = (int)offsets[k];
+        st->arcs[k] = (struct chamber_arc){gsl_vector_get(x,o+2),gsl_vector_get(x,o+3),gsl_vector_get(x,o+1),
+                                           gsl_vector_get(x,o+4),gsl_vector_get(x,o),0,1,o+2,o+3,o+1,o+4,o};
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+static void bench_state_free(struct bench_state *st)
+{
+    for(size_t i = 0; i < BENCH_CORPUS; ++i)
+    {
+        gsl_vector_free(st->x_2[i]);
+        gsl_vector_free(st->x_3[i]);
+    }
+    for(size_t b = 0; b < 3; ++b)
+    {
+        system_2_levels_ctx_free(st->ctx_2[b]);
+        system_3_levels_ctx_free(st->ctx_3[b]);
+    }
+    gsl_vector_free(st->f_2);
+    gsl_matrix_free(st->J_2);
+    gsl_vector_free(st->f_3);
+    gsl_matrix_free(st->J_3);
+    gsl_vector_free(st->x_n);
+    gsl_vector_free(st->f_n);
+    gsl_matrix_free(st->J_n);
+}
+
+
+struct bench_result
+{
+    double ns_per_op, ns_min;
+    double iters_per_op;
+    double allocs_per_op;
+};
+
+
+// Passes over the corpus, returns the ns per operation
+static double bench_pass(struct bench_state *st, bench_op_t op, size_t passes, size_t *iters)
+{
+    size_t it = 0;
+    const double t = solver_clock();
+    for(size_t p = 0; p < passes; ++p)
+        for(size_t i = 0; i < BENCH_CORPUS; ++i)
+        {
+            it += op(st,i);
+        }
+    const double dt = solver_clock() - t;
+    if(iters)
+        *iters = it;
+
+    return 1e9*dt/(passes*BENCH_CORPUS);
+}
+
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+// A first pass lets the contexts size their workspaces, a second one counts
+// iterations and allocations. Then the number of passes per sample is
+// doubled until a sample takes min_time seconds
+static void bench_measure(struct bench_state *st, bench_op_t op, size_t samples, double min_time, struct bench_result *res)
+{
+    size_t iters;
+    bench_pass(st,op,1,NULL);
+    const size_t allocs = bench_alloc_count();
+    bench_pass(st,op,1,&iters);
+    res->allocs_per_op = BENCH_COUNT_ALLOCS ? (double)(bench_alloc_count() - allocs)/BENCH_CORPUS : -1;
+    res->iters_per_op = (double)iters/BENCH_CORPUS;
+
+    size_t passes = 1;
+    while(bench_pass(st,op,passes,NULL)*passes*BENCH_CORPUS < 1e9*min_time && passes < ((size_t)1 << 30))
+        passes *= 2;
+
+    double ns[samples];
+    for(size_t s = 0; s < samples; ++s)
+        ns[s] = bench_pass(st,op,passes,NULL);
+    qsort(ns,samples,sizeof(double),bench_cmp_double);
+    res->ns_per_op = ns[samples/2];
+    res->ns_min = ns[0];
+}
+
+
+struct bench_baseline
+{
+    size_t n;
+    char names[BENCH_MAX_BASELINE][64];
+    double ns[BENCH_MAX_BASELINE];
+};
+
+
+// Reads name and ns_per_op of a previous run's CSV
+static int bench_baseline_read(const char *path, struct bench_baseline *baseline)
+{
+    FILE *in = fopen(path,"r");
+    if(!in)
+        return -1;
+
+    char line[512];
+    baseline->n = 0;
+    while(fgets(line,sizeof(line),in) && baseline->n < BENCH_MAX_BASELINE)
+    {
+        char *comma = strchr(line,',');
+        if(!comma || comma - line >= 64)
+            continue;
+        char *end;
+        errno = 0;
+        double ns = strtod(comma + 1,&end);
+        if(errno || end == comma + 1)
+            continue;   // header
+        memcpy(baseline->names[baseline->n],line,comma - line);
+        baseline->names[baseline->n][comma - line] = '\0';
+        baseline->ns[baseline->n] = ns;
+        ++baseline->n;
+    }
+    fclose(in);
+
+    return 0;
+}
+
+
+static const double *bench_baseline_find(const struct bench_baseline *baseline, const char *name)
+{
+    for(size_t i = 0; i < baseline->n; ++i)
+        if(!strcmp(baseline->names[i],name))
+            return &baseline->ns[i];
+    return NULL;
+}
+
+
+static void usage(FILE *stream, const char *prog)
+{
+    fprintf(stream,
+        "Usage: %s [options] [name-filter]...\n"
+        "  -s samples      timed samples per benchmark, the median is reported (default 7)\n"
+        "  -t seconds      minimal duration of a sample (default 0.02)\n"
+        "  -c baseline     CSV of a previous run to compare ns/op against\n"
+        "  -r ratio        with -c, slowdown counted as a regression (default 1.1)\n"
+        "  -o file         output CSV (default: stdout)\n"
+        "  -l              list benchmark names\n"
+        "Only the benchmarks whose names contain one of the filters are run.\n"
+        "Exits with 2 when a benchmark is slower than the baseline by more than the ratio.\n",prog);
+}
+
+
+int main(int argc, char *argv[])
+{
+    size_t samples = 7;
+    double min_time = 0.02;
+    double max_ratio = 1.1;
+    const char *baseline_path = NULL;
+    const char *out_path = NULL;
+
+    int opt;
+    while((opt = getopt(argc,argv,"s:t:c:r:o:lh")) != -1)
+    {
+        switch(opt)
+        {
+            case 's':
+                samples = (size_t)atoi(optarg);
+                if(samples < 1)
+                    samples = 1;
+                break;
+            case 't':
+                min_time = atof(optarg);
+                break;
+            case 'c':
+                baseline_path = optarg;
+                break;
+            case 'r':
+                max_ratio = atof(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'l':
+                for(size_t c = 0; c < bench_n_cases; ++c)
+                    printf("%s\n",bench_cases[c].name);
+                return 0;
+            case 'h':
+                usage(stdout,argv[0]);
+                return 0;
+            default:
+                usage(stderr,argv[0]);
+                return 1;
+        }
+    }
+
+    static struct bench_baseline baseline;
+    if(baseline_path && bench_baseline_read(baseline_path,&baseline))
+    {
+        perror(baseline_path);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if(out_path)
+    {
+        out = fopen(out_path,"w");
+        if(!out)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    static struct bench_state st;
+    if(bench_state_init(&st) != GSL_SUCCESS)
+    {
+        fprintf(stderr,"Failed to set up the benchmarks\n");
+        return 1;
+    }
+
+    // Solvers are expected to fail on some configurations, keep quiet
+    gsl_set_error_handler_off();
+
+    fprintf(out,"name,ns_per_op,ns_min,iters_per_op,allocs_per_op");
+    if(baseline_path)
+        fprintf(out,",baseline_ns_per_op,ratio");
+    fprintf(out,"\n");
+
+    int status = 0;
+    for(size_t c = 0; c < bench_n_cases; ++c)
+    {
+        const struct bench_case *bc = &bench_cases[c];
+        bool selected = optind == argc;
+        for(int a = optind; a < argc && !selected; ++a)
+            selected = strstr(bc->name,argv[a]) != NULL;
+        if(!selected)
+            continue;
+
+        struct bench_result res;
+        bench_measure(&st,bc->op,samples,min_time,&res);
+        fprintf(out,"%s,%.1f,%.1f,%.2f,%.2f",bc->name,res.ns_per_op,res.ns_min,res.iters_per_op,res.allocs_per_op);
+        if(baseline_path)
+        {
+            const double *ns = bench_baseline_find(&baseline,bc->name);
+            if(ns)
+            {
+                const double ratio = res.ns_per_op/(*ns);
+                fprintf(out,",%.1f,%.3f",*ns,ratio);
+                if(ratio > max_ratio)
+                {
+                    fprintf(stderr,"%s: %.1f ns/op vs %.1f in the baseline\n",bc->name,res.ns_per_op,*ns);
+                    status = 2;
+                }
+            }
+            else
+                fprintf(out,",,");
+        }
+        fprintf(out,"\n");
+        fflush(out);
+    }
+
+    if(out != stdout)
+        fclose(out);
+    bench_state_free(&st);
+
+    return status;
+}
@@ -0,0 +1,393 @@
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/replay.h>
+#include <equations/table.h>
+#include <equations/utils.h>
+#include <gsl/gsl_errno.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define REPLAY_MAX_COLUMNS 64
+
+
+// Glue that lets the driver treat both models the same way
+struct replay_model
+{
+    uint32_t n_levels;
+    size_t user_params_size;
+    size_t result_size;
+    const struct field_desc *params;
+    size_t n_params;
+    const struct field_desc *results;
+    size_t n_results;
+
+    void (*default_user_params)(void *user_params);
+    struct replay *(*alloc)(enum solver_backend backend, bool adiabatic, const struct replay_options *opts);
+    int (*step)(struct replay *replay, const void *user_params, void *result, struct replay_step_info *info);
+};
+
+
+static void replay_2_levels_default(void *user_params)
+{
+    system_2_levels_default_user_params(user_params);
+}
+
+static int replay_2_levels_step(struct replay *replay, const void *user_params, void *result, struct replay_step_info *info)
+{
+    return system_2_levels_replay_step(replay,user_params,result,info);
+}
+
+
+static void replay_3_levels_default(void *user_params)
+{
+    system_3_levels_default_user_params(user_params);
+}
+
+static int replay_3_levels_step(struct replay *replay, const void *user_params, void *result, struct replay_step_info *info)
+{
+    return system_3_levels_replay_step(replay,user_params,result,info);
+}
+
+
+static void usage(FILE *stream, const char *prog)
+{
+    struct replay_options defaults;
+    replay_default_options(&defaults);
+
+    fprintf(stream,
+        "Usage: %s [options] [param=value]...\n"
+        "  -m 2|3          model, number of levels (default 2)\n"
+        "  -a              adiabatic equations\n"
+        "  -b backend      dense, sparse or fixed (default fixed)\n"
+        "  -i file         input CSV (default: stdin)\n"
+        "  -o file         output file (default: stdout)\n"
+        "  -f csv|table    output format, table is the binary one of equations/table.h (default csv)\n"
+        "  -I iters        iterations of a solve before it is substepped (default %zu)\n"
+        "  -S substeps     most substeps between two samples (default %zu)\n"
+        "  -x              no secant predictor, start every sample from the previous equilibrium\n"
+        "  -l              list parameter and result names of the model\n"
+        "The input header names the columns: user params of the model and\n"
+        "optionally t. Every row is one sample, the params not in the input keep\n"
+        "their defaults or the values given as param=value.\n",prog,defaults.max_iters,defaults.max_substeps);
+}
+
+
+static int parse_double(const char *s, double *v)
+{
+    char *end;
+    errno = 0;
+    *v = strtod(s,&end);
+    while(*end == ' ' || *end == '\r' || *end == '\n')
+        ++end;
+    return (errno || end == s || *end) ? -1 : 0;
+}
+
+
+// Splits line in place at the commas, returns the number of fields
+static size_t split_csv(char *line, char **fields, size_t max_fields)
+{
+    size_t n = 0;
+    char *save;
+    for(char *tok = strtok_r(line,",\r\n",&save); tok && n < max_fields; tok = strtok_r(NULL,",\r\n",&save))
+    {
+        while(*tok == ' ')
+            ++tok;
+        fields[n++] = tok;
+    }
+
+    return n;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const struct replay_model models[] = {
+        {
+            2, sizeof(struct system_2_levels_user_params), sizeof(struct system_2_levels_result),
+            system_2_levels_user_params_fields, system_2_levels_user_params_n_fields,
+            system_2_levels_result_fields, system_2_levels_result_n_fields,
+            replay_2_levels_default, system_2_levels_replay_alloc, replay_2_levels_step
+        },
+        {
+            3, sizeof(struct system_3_levels_user_params), sizeof(struct system_3_levels_result),
+            system_3_levels_user_params_fields, system_3_levels_user_params_n_fields,
+            system_3_levels_result_fields, system_3_levels_result_n_fields,
+            replay_3_levels_default, system_3_levels_replay_alloc, replay_3_levels_step
+        }
+    };
+
+    const struct replay_model *model = &models[0];
+    enum solver_backend backend = SOLVER_BACKEND_FIXED_NEWTON;
+    bool adiabatic = false;
+    bool list = false;
+    bool table = false;
+    const char *in_path = NULL;
+    const char *out_path = NULL;
+    struct replay_options opts;
+    replay_default_options(&opts);
+
+    int opt;
+    while((opt = getopt(argc,argv,"m:ab:i:o:f:I:S:xlh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'm':
+                if(!strcmp(optarg,"2"))
+                    model = &models[0];
+                else if(!strcmp(optarg,"3"))
+                    model = &models[1];
+                else
+                {
+                    fprintf(stderr,"Unknown model '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adiabatic = true;
+                break;
+            case 'b':
+                if(!strcmp(optarg,"dense"))
+                    backend = SOLVER_BACKEND_DENSE;
+                else if(!strcmp(optarg,"sparse"))
+                    backend = SOLVER_BACKEND_SPARSE_NEWTON;
+                else if(!strcmp(optarg,"fixed"))
+                    backend = SOLVER_BACKEND_FIXED_NEWTON;
+                else
+                {
+                    fprintf(stderr,"Unknown backend '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                in_path = optarg;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'f':
+                if(!strcmp(optarg,"csv"))
+                    table = false;
+                else if(!strcmp(optarg,"table"))
+                    table = true;
+                else
+                {
+                    fprintf(stderr,"Unknown format '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'I':
+                opts.max_iters = strtoul(optarg,NULL,10);
+                break;
+            case 'S':
+                opts.max_substeps = strtoul(optarg,NULL,10);
+                break;
+            case 'x':
+                opts.extrapolate = false;
+                break;
+            case 'l':
+                list = true;
+                break;
+            case 'h':
+                usage(stdout,argv[0]);
+                return 0;
+            default:
+                usage(stderr,argv[0]);
+                return 1;
+        }
+    }
+
+    if(list)
+    {
+        printf("params:");
+        for(size_t i = 0; i < model->n_params; ++i)
+            printf(" %s",model->params[i].name);
+        printf("\nresults:");
+        for(size_t i = 0; i < model->n_results; ++i)
+            printf(" %s",model->results[i].name);
+        printf("\n");
+        return 0;
+    }
+
+    unsigned char *user_params = malloc(model->user_params_size);
+    unsigned char *result = malloc(model->result_size);
+    model->default_user_params(user_params);
+    for(int a = optind; a < argc; ++a)
+    {
+        char *eq = strchr(argv[a],'=');
+        const struct field_desc *field = NULL;
+        if(eq)
+        {
+            *eq = '\0';
+            field = field_find(model->params,model->n_params,argv[a]);
+        }
+        if(!field || parse_double(eq + 1,(double*)(user_params + field->offset)))
+        {
+            fprintf(stderr,"Bad parameter spec '%s'\n",argv[a]);
+            usage(stderr,argv[0]);
+            return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if(in_path)
+    {
+        in = fopen(in_path,"r");
+        if(!in)
+        {
+            perror(in_path);
+            return 1;
+        }
+    }
+
+    // Input columns map to user params, or to the time when field is NULL
+    char *line = NULL;
+    size_t line_size = 0;
+    char *fields[REPLAY_MAX_COLUMNS];
+    const struct field_desc *columns[REPLAY_MAX_COLUMNS];
+    size_t n_in = 0;
+    bool has_time = false;
+    if(getline(&line,&line_size,in) < 0)
+    {
+        fprintf(stderr,"Empty input\n");
+        return 1;
+    }
+    n_in = split_csv(line,fields,REPLAY_MAX_COLUMNS);
+    for(size_t c = 0; c < n_in; ++c)
+    {
+        columns[c] = NULL;
+        if(!strcmp(fields[c],"t"))
+            has_time = true;
+        else if(!(columns[c] = field_find(model->params,model->n_params,fields[c])))
+        {
+            fprintf(stderr,"Unknown input column '%s'\n",fields[c]);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if(out_path)
+    {
+        out = fopen(out_path,table ? "wb" : "w");
+        if(!out)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    const size_t n_columns = 4 + model->n_results;
+    const char *names[n_columns];
+    size_t column = 0;
+    names[column++] = has_time ? "t" : "index";
+    names[column++] = "status";
+    names[column++] = "substeps";
+    names[column++] = "iterations";
+    for(size_t i = 0; i < model->n_results; ++i)
+        names[column++] = model->results[i].name;
+
+    struct table_writer *writer = NULL;
+    if(table)
+    {
+        writer = table_writer_alloc(out,model->n_levels,names,n_columns);
+        if(!writer)
+        {
+            fprintf(stderr,"Failed to write the table header\n");
+            return 1;
+        }
+    }
+    else
+    {
+        for(size_t c = 0; c < n_columns; ++c)
+            fprintf(out,c ? ",%s" : "%s",names[c]);
+        fprintf(out,"\n");
+    }
+
+    struct replay *replay = model->alloc(backend,adiabatic,&opts);
+    if(!replay)
+    {
+        fprintf(stderr,"Failed to allocate the solver\n");
+        return 1;
+    }
+
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC,&t_start);
+
+    size_t n_samples = 0, failed = 0, substeps = 0;
+    int status = 0;
+    double row[n_columns];
+    for(size_t line_no = 2; getline(&line,&line_size,in) >= 0; ++line_no)
+    {
+        if(line[0] == '\n' || line[0] == '\r' || line[0] == '\0')
+            continue;
+
+        double t = n_samples;
+        bool ok = split_csv(line,fields,REPLAY_MAX_COLUMNS) == n_in;
+        for(size_t c = 0; c < n_in && ok; ++c)
+            ok = !parse_double(fields[c],columns[c] ? (double*)(user_params + columns[c]->offset) : &t);
+        if(!ok)
+        {
+            fprintf(stderr,"Bad input line %zu\n",line_no);
+            status = 1;
+            break;
+        }
+
+        struct replay_step_info info;
+        model->step(replay,user_params,result,&info);
+        ++n_samples;
+        substeps += info.substeps;
+        if(info.status != GSL_SUCCESS)
+            ++failed;
+
+        row[0] = t;
+        row[1] = info.status;
+        row[2] = info.substeps;
+        row[3] = info.iterations;
+        for(size_t r = 0; r < model->n_results; ++r)
+            row[4 + r] = *(const double*)(result + model->results[r].offset);
+
+        if(table)
+        {
+            if(table_writer_append(writer,row,1) != GSL_SUCCESS)
+            {
+                fprintf(stderr,"Failed to write the table\n");
+                status = 1;
+                break;
+            }
+        }
+        else
+        {
+            fprintf(out,"%.10g,%d,%zu,%zu",t,info.status,info.substeps,info.iterations);
+            for(size_t r = 0; r < model->n_results; ++r)
+                fprintf(out,",%.10g",row[4 + r]);
+            fprintf(out,"\n");
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&t_end);
+    const double elapsed = (t_end.tv_sec - t_start.tv_sec) + 1e-9*(t_end.tv_nsec - t_start.tv_nsec);
+    fprintf(stderr,"%zu samples in %.3f s (%.1f us per sample), %zu substeps, %zu did not converge\n",
+            n_samples,elapsed,n_samples ? 1e6*elapsed/n_samples : 0.0,substeps,failed);
+
+    if(writer && table_writer_close(writer) != GSL_SUCCESS)
+    {
+        fprintf(stderr,"Failed to write the table\n");
+        status = 1;
+    }
+    if(out != stdout)
+        fclose(out);
+    if(in != stdin)
+        fclose(in);
+    replay_free(replay);
+    free(line);
+    free(result);
+    free(user_params);
+
+    return status;
+}
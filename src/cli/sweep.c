@@ -0,0 +1,548 @@
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/n_levels.h>
+#include <equations/batch.h>
+#include <equations/table.h>
+#include <equations/utils.h>
+#include <gsl/gsl_errno.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define SWEEP_CHUNK 4096
+#define SWEEP_MAX_AXES 16
+
+
+// Glue that lets the driver treat every model the same way
+struct sweep_model
+{
+    uint32_t n_levels;
+    size_t user_params_size;
+    size_t result_size;
+    const struct field_desc *params;
+    size_t n_params;
+    const struct field_desc *results;
+    size_t n_results;
+
+    void (*default_user_params)(void *user_params);
+    enum solver_backend (*default_backend)(bool adiabatic);
+    void *(*ctx_alloc)(enum solver_backend backend);
+    void (*ctx_free)(void *ctx);
+    int (*eval)(void *ctx, const void *user_params, void *result, bool adiabatic);
+    size_t (*iterations)(const void *ctx);
+};
+
+
+static void sweep_2_levels_default(void *user_params)
+{
+    system_2_levels_default_user_params(user_params);
+}
+
+static void *sweep_2_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_2_levels_ctx_alloc(backend);
+}
+
+static void sweep_2_levels_ctx_free(void *ctx)
+{
+    system_2_levels_ctx_free(ctx);
+}
+
+static int sweep_2_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_2_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_2_levels_ctx_eval(ctx,user_params,result);
+}
+
+static size_t sweep_2_levels_iterations(const void *ctx)
+{
+    return system_2_levels_ctx_iterations(ctx);
+}
+
+
+static void sweep_3_levels_default(void *user_params)
+{
+    system_3_levels_default_user_params(user_params);
+}
+
+static void *sweep_3_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_3_levels_ctx_alloc(backend);
+}
+
+static void sweep_3_levels_ctx_free(void *ctx)
+{
+    system_3_levels_ctx_free(ctx);
+}
+
+static int sweep_3_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_3_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_3_levels_ctx_eval(ctx,user_params,result);
+}
+
+static size_t sweep_3_levels_iterations(const void *ctx)
+{
+    return system_3_levels_ctx_iterations(ctx);
+}
+
+
+// Deeper stacks share everything but their defaults
+#define SWEEP_N_LEVELS_DEFAULT(n) \
+    static void sweep_##n##_levels_default(void *user_params) \
+    { \
+        system_n_levels_default_user_params(user_params,n); \
+    }
+
+SWEEP_N_LEVELS_DEFAULT(4)
+SWEEP_N_LEVELS_DEFAULT(5)
+SWEEP_N_LEVELS_DEFAULT(6)
+SWEEP_N_LEVELS_DEFAULT(7)
+SWEEP_N_LEVELS_DEFAULT(8)
+
+static void *sweep_n_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_n_levels_ctx_alloc(backend);
+}
+
+static void sweep_n_levels_ctx_free(void *ctx)
+{
+    system_n_levels_ctx_free(ctx);
+}
+
+static int sweep_n_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_n_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_n_levels_ctx_eval(ctx,user_params,result);
+}
+
+static size_t sweep_n_levels_iterations(const void *ctx)
+{
+    return system_n_levels_ctx_iterations(ctx);
+}
+
+#define SWEEP_N_LEVELS_MODEL(n) \
+    { \
+        n, sizeof(struct system_n_levels_user_params), sizeof(struct system_n_levels_result), \
+        system_n_levels_user_params_fields, system_n_levels_user_params_n_fields(n), \
+        system_n_levels_result_fields, system_n_levels_result_n_fields(n), \
+        sweep_##n##_levels_default, system_n_levels_default_backend, \
+        sweep_n_levels_ctx_alloc, sweep_n_levels_ctx_free, sweep_n_levels_eval, sweep_n_levels_iterations \
+    }
+
+
+// Values of one swept user parameter, the last axis varies fastest
+struct sweep_axis
+{
+    const struct field_desc *field;
+    size_t n;
+    double *values;
+};
+
+
+struct sweep_run
+{
+    const struct sweep_model *model;
+    enum solver_backend backend;
+    bool adiabatic;
+
+    unsigned char *in;
+    unsigned char *out;
+    int *status;
+    size_t *iters;
+};
+
+
+static void *sweep_worker_alloc(void *data)
+{
+    struct sweep_run *run = (struct sweep_run*)data;
+    return run->model->ctx_alloc(run->backend);
+}
+
+
+static void sweep_worker_free(void *worker, void *data)
+{
+    struct sweep_run *run = (struct sweep_run*)data;
+    run->model->ctx_free(worker);
+}
+
+
+static void sweep_item(size_t i, void *worker, void *data)
+{
+    struct sweep_run *run = (struct sweep_run*)data;
+    const struct sweep_model *model = run->model;
+    run->status[i] = model->eval(worker,run->in + i*model->user_params_size,run->out + i*model->result_size,run->adiabatic);
+    run->iters[i] = model->iterations(worker);
+}
+
+
+static void usage(FILE *stream, const char *prog)
+{
+    fprintf(stream,
+        "Usage: %s [options] [param=value | param=start:stop:count | param=v1,v2,...]...\n"
+        "  -m 2..8         model, number of levels (default 2)\n"
+        "  -a              adiabatic equations\n"
+        "  -b backend      dense, sparse or fixed (default fixed for -m 3 -a, sparse otherwise)\n"
+        "  -j threads      worker threads (default: one per CPU)\n"
+        "  -o file         output file (default: stdout)\n"
+        "  -f csv|table    output format, table is the binary one of equations/table.h (default csv)\n"
+        "  -l              list parameter and result names of the model\n"
+        "Swept parameters form a cartesian grid, the last one varies fastest.\n",prog);
+}
+
+
+static int parse_double(const char *s, double *v)
+{
+    char *end;
+    errno = 0;
+    *v = strtod(s,&end);
+    return (errno || end == s || *end) ? -1 : 0;
+}
+
+
+static int parse_axis(const struct sweep_model *model, char *spec, void *base, struct sweep_axis *axis)
+{
+    char *eq = strchr(spec,'=');
+    if(!eq)
+        return -1;
+    *eq = '\0';
+    char *value = eq + 1;
+
+    axis->field = field_find(model->params,model->n_params,spec);
+    if(!axis->field)
+    {
+        fprintf(stderr,"Unknown parameter '%s'\n",spec);
+        return -1;
+    }
+
+    char *c1 = strchr(value,':');
+    if(c1)
+    {
+        char *c2 = strchr(c1+1,':');
+        if(!c2)
+            return -1;
+        *c1 = '\0';
+        *c2 = '\0';
+        double start, stop, count;
+        if(parse_double(value,&start) || parse_double(c1+1,&stop) || parse_double(c2+1,&count) || count < 1)
+            return -1;
+        axis->n = (size_t)count;
+        axis->values = malloc(axis->n*sizeof(double));
+        for(size_t i = 0; i < axis->n; ++i)
+            axis->values[i] = axis->n == 1 ? start : start + (stop - start)*i/(axis->n - 1);
+    }
+    else
+    {
+        axis->n = 1;
+        for(const char *c = value; *c; ++c)
+            if(*c == ',')
+                ++axis->n;
+        axis->values = malloc(axis->n*sizeof(double));
+        char *save;
+        char *tok = strtok_r(value,",",&save);
+        for(size_t i = 0; i < axis->n; ++i)
+        {
+            if(!tok || parse_double(tok,&axis->values[i]))
+                return -1;
+            tok = strtok_r(NULL,",",&save);
+        }
+    }
+
+    // Fixed values go straight into the base configuration
+    *(double*)((unsigned char*)base + axis->field->offset) = axis->values[0];
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const struct sweep_model models[] = {
+        {
+            2, sizeof(struct system_2_levels_user_params), sizeof(struct system_2_levels_result),
+            system_2_levels_user_params_fields, system_2_levels_user_params_n_fields,
+            system_2_levels_result_fields, system_2_levels_result_n_fields,
+            sweep_2_levels_default, system_2_levels_default_backend,
+            sweep_2_levels_ctx_alloc, sweep_2_levels_ctx_free, sweep_2_levels_eval, sweep_2_levels_iterations
+        },
+        {
+            3, sizeof(struct system_3_levels_user_params), sizeof(struct system_3_levels_result),
+            system_3_levels_user_params_fields, system_3_levels_user_params_n_fields,
+            system_3_levels_result_fields, system_3_levels_result_n_fields,
+            sweep_3_levels_default, system_3_levels_default_backend,
+            sweep_3_levels_ctx_alloc, sweep_3_levels_ctx_free, sweep_3_levels_eval, sweep_3_levels_iterations
+        },
+        SWEEP_N_LEVELS_MODEL(4),
+        SWEEP_N_LEVELS_MODEL(5),
+        SWEEP_N_LEVELS_MODEL(6),
+        SWEEP_N_LEVELS_MODEL(7),
+        SWEEP_N_LEVELS_MODEL(8)
+    };
+    const size_t n_models = sizeof(models)/sizeof(models[0]);
+
+    const struct sweep_model *model = &models[0];
+    enum solver_backend backend = SOLVER_BACKEND_DENSE;
+    bool backend_set = false;
+    bool adiabatic = false;
+    bool list = false;
+    int nthreads = 0;
+    const char *out_path = NULL;
+    bool table = false;
+
+    int opt;
+    while((opt = getopt(argc,argv,"m:ab:j:o:f:lh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'm':
+                model = NULL;
+                for(size_t i = 0; i < n_models; ++i)
+                {
+                    char name[4];
+                    snprintf(name,sizeof(name),"%u",models[i].n_levels);
+                    if(!strcmp(optarg,name))
+                        model = &models[i];
+                }
+                if(!model)
+                {
+                    fprintf(stderr,"Unknown model '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                adiabatic = true;
+                break;
+            case 'b':
+                backend_set = true;
+                if(!strcmp(optarg,"dense"))
+                    backend = SOLVER_BACKEND_DENSE;
+                else if(!strcmp(optarg,"sparse"))
+                    backend = SOLVER_BACKEND_SPARSE_NEWTON;
+                else if(!strcmp(optarg,"fixed"))
+                    backend = SOLVER_BACKEND_FIXED_NEWTON;
+                else
+                {
+                    fprintf(stderr,"Unknown backend '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'f':
+                if(!strcmp(optarg,"csv"))
+                    table = false;
+                else if(!strcmp(optarg,"table"))
+                    table = true;
+                else
+                {
+                    fprintf(stderr,"Unknown format '%s'\n",optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                list = true;
+                break;
+            case 'h':
+                usage(stdout,argv[0]);
+                return 0;
+            default:
+                usage(stderr,argv[0]);
+                return 1;
+        }
+    }
+
+    if(!backend_set)
+        backend = model->default_backend(adiabatic);
+
+    if(list)
+    {
+        printf("params:");
+        for(size_t i = 0; i < model->n_params; ++i)
+            printf(" %s",model->params[i].name);
+        printf("\nresults:");
+        for(size_t i = 0; i < model->n_results; ++i)
+            printf(" %s",model->results[i].name);
+        printf("\n");
+        return 0;
+    }
+
+    unsigned char *base = malloc(model->user_params_size);
+    model->default_user_params(base);
+
+    struct sweep_axis axes[SWEEP_MAX_AXES];
+    size_t n_axes = 0;
+    size_t total = 1;
+    for(int a = optind; a < argc; ++a)
+    {
+        if(n_axes == SWEEP_MAX_AXES)
+        {
+            fprintf(stderr,"Too many swept parameters\n");
+            return 1;
+        }
+        if(parse_axis(model,argv[a],base,&axes[n_axes]))
+        {
+            fprintf(stderr,"Bad parameter spec '%s'\n",argv[a]);
+            usage(stderr,argv[0]);
+            return 1;
+        }
+        if(axes[n_axes].n > 1)
+        {
+            if(total > SIZE_MAX/axes[n_axes].n)
+            {
+                fprintf(stderr,"Grid is too large\n");
+                return 1;
+            }
+            total *= axes[n_axes].n;
+            ++n_axes;
+        }
+        else
+            free(axes[n_axes].values);
+    }
+
+    FILE *out = stdout;
+    if(out_path)
+    {
+        out = fopen(out_path,table ? "wb" : "w");
+        if(!out)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    // Same columns in both formats
+    const size_t n_columns = 3 + n_axes + model->n_results;
+    const char *names[n_columns];
+    size_t column = 0;
+    names[column++] = "index";
+    for(size_t a = 0; a < n_axes; ++a)
+        names[column++] = axes[a].field->name;
+    names[column++] = "status";
+    names[column++] = "iterations";
+    for(size_t i = 0; i < model->n_results; ++i)
+        names[column++] = model->results[i].name;
+
+    struct table_writer *writer = NULL;
+    double *rows = NULL;
+    if(table)
+    {
+        writer = table_writer_alloc(out,model->n_levels,names,n_columns);
+        rows = malloc(SWEEP_CHUNK*n_columns*sizeof(double));
+        if(!writer || !rows)
+        {
+            fprintf(stderr,"Failed to write the table header\n");
+            return 1;
+        }
+    }
+    else
+    {
+        for(size_t c = 0; c < n_columns; ++c)
+            fprintf(out,c ? ",%s" : "%s",names[c]);
+        fprintf(out,"\n");
+    }
+
+    struct sweep_run run;
+    run.model = model;
+    run.backend = backend;
+    run.adiabatic = adiabatic;
+    run.in = malloc(SWEEP_CHUNK*model->user_params_size);
+    run.out = malloc(SWEEP_CHUNK*model->result_size);
+    run.status = malloc(SWEEP_CHUNK*sizeof(int));
+    run.iters = malloc(SWEEP_CHUNK*sizeof(size_t));
+
+    size_t failed = 0;
+    int status = 0;
+    for(size_t chunk_begin = 0; chunk_begin < total; chunk_begin += SWEEP_CHUNK)
+    {
+        size_t chunk = MIN(SWEEP_CHUNK,total - chunk_begin);
+        for(size_t i = 0; i < chunk; ++i)
+        {
+            unsigned char *user_params = run.in + i*model->user_params_size;
+            memcpy(user_params,base,model->user_params_size);
+            size_t rest = chunk_begin + i;
+            for(size_t a = n_axes; a-- > 0;)
+            {
+                *(double*)(user_params + axes[a].field->offset) = axes[a].values[rest % axes[a].n];
+                rest /= axes[a].n;
+            }
+        }
+
+        if(batch_run(chunk,nthreads,sweep_worker_alloc,sweep_item,sweep_worker_free,&run) != GSL_SUCCESS)
+        {
+            fprintf(stderr,"Failed to run the solver pool\n");
+            status = 1;
+            break;
+        }
+
+        for(size_t i = 0; i < chunk; ++i)
+        {
+            const unsigned char *user_params = run.in + i*model->user_params_size;
+            const unsigned char *result = run.out + i*model->result_size;
+            if(table)
+            {
+                double *row = rows + i*n_columns;
+                *row++ = chunk_begin + i;
+                for(size_t a = 0; a < n_axes; ++a)
+                    *row++ = *(const double*)(user_params + axes[a].field->offset);
+                *row++ = run.status[i];
+                *row++ = run.iters[i];
+                for(size_t r = 0; r < model->n_results; ++r)
+                    *row++ = *(const double*)(result + model->results[r].offset);
+            }
+            else
+            {
+                fprintf(out,"%zu",chunk_begin + i);
+                for(size_t a = 0; a < n_axes; ++a)
+                    fprintf(out,",%.10g",*(const double*)(user_params + axes[a].field->offset));
+                fprintf(out,",%d,%zu",run.status[i],run.iters[i]);
+                for(size_t r = 0; r < model->n_results; ++r)
+                    fprintf(out,",%.10g",*(const double*)(result + model->results[r].offset));
+                fprintf(out,"\n");
+            }
+            if(run.status[i] != GSL_SUCCESS)
+                ++failed;
+        }
+
+        if(table && table_writer_append(writer,rows,chunk) != GSL_SUCCESS)
+        {
+            fprintf(stderr,"Failed to write the table\n");
+            status = 1;
+            break;
+        }
+        fflush(out);
+    }
+
+    if(writer && table_writer_close(writer) != GSL_SUCCESS)
+    {
+        fprintf(stderr,"Failed to write the table\n");
+        status = 1;
+    }
+
+    if(failed)
+        fprintf(stderr,"%zu of %zu configurations did not converge\n",failed,total);
+
+    if(out != stdout)
+        fclose(out);
+    free(rows);
+    free(run.iters);
+    free(run.status);
+    free(run.out);
+    free(run.in);
+    for(size_t a = 0; a < n_axes; ++a)
+        free(axes[a].values);
+    free(base);
+
+    return status;
+}
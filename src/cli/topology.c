@@ -0,0 +1,99 @@
+#include <equations/n_levels.h>
+#include <gsl/gsl_errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+
+// Structure of every stack system_n_levels_stack builds and of the unknowns
+// system_n_levels_assemble lays out for it, for scripts/gen_kernels.py. One
+// stack per law and depth:
+//
+//   stack n_levels law n_eq n_membranes topology_hash
+//   arc alpha a_fixed cx_shared inner outer membrane i_phi i_r i_cx i_cy i_a
+//   junction fixed eqs n_ends arc t...
+//   chamber i_p n_arcs arc...
+//
+// Indices of unknowns are -1 for the parameters that are not any
+
+
+static int dump(FILE *out, size_t n_levels, enum system_n_levels_pressure_law law)
+{
+    struct system_n_levels_user_params user_params;
+    struct system_n_levels_topology topo;
+    struct system_n_levels sys;
+    system_n_levels_default_user_params(&user_params,n_levels);
+    int status = system_n_levels_stack(&user_params,law,&topo);
+    if(status)
+        return status;
+    status = system_n_levels_assemble(&topo,&sys);
+    if(status)
+        return status;
+
+    fprintf(out,"stack %zu %d %zu %zu %" PRIu64 "\n",topo.n_levels,(int)law,sys.n_eq,topo.n_membranes,sys.topology_hash);
+    for(size_t i = 0; i < topo.n_arcs; ++i)
+    {
+        const struct system_n_levels_arc *arc = &topo.arcs[i];
+        const int *idx = sys.idx[i];
+        fprintf(out,"arc %.17g %d %d %d %d %d %d %d %d %d %d\n",arc->alpha,arc->a_fixed,arc->cx_shared,
+                arc->inner,arc->outer,arc->membrane,idx[0],idx[1],idx[2],idx[3],idx[4]);
+    }
+    for(size_t j = 0; j < topo.n_junctions; ++j)
+    {
+        const struct system_n_levels_junction *junction = &topo.junctions[j];
+        fprintf(out,"junction %d %u %zu",junction->fixed,junction->eqs,junction->n_ends);
+        for(size_t k = 0; k < junction->n_ends; ++k)
+            fprintf(out," %d %d",junction->ends[k].arc,junction->ends[k].t);
+        fprintf(out,"\n");
+    }
+    for(size_t c = 0; c < topo.n_chambers; ++c)
+    {
+        const struct system_n_levels_chamber *chamber = &topo.chambers[c];
+        fprintf(out,"chamber %d %zu",sys.p_idx[c],chamber->n_arcs);
+        for(size_t i = 0; i < chamber->n_arcs; ++i)
+            fprintf(out," %d",chamber->arcs[i]);
+        fprintf(out,"\n");
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if(argc > 2)
+    {
+        fprintf(stderr,"Usage: %s [output]\n",argv[0]);
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if(argc == 2)
+    {
+        out = fopen(argv[1],"w");
+        if(!out)
+        {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    int status = GSL_SUCCESS;
+    for(size_t n = SYSTEM_N_LEVELS_MIN; n <= SYSTEM_N_LEVELS_MAX && !status; ++n)
+    {
+        const enum system_n_levels_pressure_law laws[2] = {SYSTEM_N_LEVELS_ISOTHERMAL,SYSTEM_N_LEVELS_ADIABATIC};
+        for(size_t l = 0; l < 2 && !status; ++l)
+        {
+            status = dump(out,n,laws[l]);
+            if(status)
+                fprintf(stderr,"Failed to build the %zu-level stack: %s\n",n,gsl_strerror(status));
+        }
+    }
+
+    if(out != stdout && fclose(out))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    return status ? 1 : 0;
+}
@@ -1,853 +1,416 @@
 #include <equations/3_levels.h>
+#include <equations/n_levels.h>
+#include <equations/batch.h>
+#include <equations/table.h>
 #include <equations/utils.h>
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_multiroots.h>
-#include <gsl/gsl_sf_trig.h>
-#include <gsl/gsl_blas.h>
-
-static const size_t N_eq = 40;
-
-
-int system_3_levels_f(const gsl_vector *x, void *p, gsl_vector *f)
-{
-    struct system_3_levels_params *params = (struct system_3_levels_params*)p;
-    
-    const double phi_ad = gsl_vector_get(x,0);
-    const double r_ad = gsl_vector_get(x,1);
-    const double x_ad = gsl_vector_get(x,2);
-    const double y_ad = gsl_vector_get(x,3);
-    const double a_ad = gsl_vector_get(x,4);
-    const double phi_cb = gsl_vector_get(x,5);
-    const double r_cb = gsl_vector_get(x,6);
-    const double x_cb = gsl_vector_get(x,7);
-    const double y_cb = gsl_vector_get(x,8);
-    const double a_cb = gsl_vector_get(x,9);
-    const double phi_dc = gsl_vector_get(x,10);
-    const double r_dc = gsl_vector_get(x,11);
-    const double x_dc = gsl_vector_get(x,12);
-    const double y_dc = gsl_vector_get(x,13);
-    const double a_dc = gsl_vector_get(x,14);
-    const double phi_df = gsl_vector_get(x,15);
-    const double r_df = gsl_vector_get(x,16);
-    const double x_df = gsl_vector_get(x,17);
-    const double y_df = gsl_vector_get(x,18);
-    const double a_df = gsl_vector_get(x,19);
-    const double phi_ec = gsl_vector_get(x,20);
-    const double r_ec = gsl_vector_get(x,21);
-    const double x_ec = gsl_vector_get(x,22);
-    const double y_ec = gsl_vector_get(x,23);
-    const double a_ec = gsl_vector_get(x,24);
-    const double phi_fe = gsl_vector_get(x,25);
-    const double r_fe = gsl_vector_get(x,26);
-    const double x_fe = gsl_vector_get(x,27);
-    const double y_fe = gsl_vector_get(x,28);
-    const double a_fe = gsl_vector_get(x,29);
-    const double phi_ge = gsl_vector_get(x,30);
-    const double r_ge = gsl_vector_get(x,31);
-    const double y_ge = gsl_vector_get(x,32);
-    const double phi_gf = gsl_vector_get(x,33);
-    const double r_gf = gsl_vector_get(x,34);
-    const double y_gf = gsl_vector_get(x,35);
-    const double x_bot = gsl_vector_get(x,36);
-    const double p_top = gsl_vector_get(x,37);
-    const double p_mid = gsl_vector_get(x,38);
-    const double p_bot = gsl_vector_get(x,39);
-
-    const double a_ge = 3*M_PI_2;
-    const double a_gf = 3*M_PI_2;
-
-    // Preservation of length
-    double eq1 = r_ad*phi_ad - params->r_top_0*params->phi_ad_0;
-    gsl_vector_set(f,0,eq1);
-    double eq2 = r_cb*phi_cb - params->r_top_0*params->phi_cb_0;
-    gsl_vector_set(f,1,eq2);
-    double eq3 = r_dc*phi_dc - params->r_top_0*params->phi_dc_0;
-    gsl_vector_set(f,2,eq3);
-    double eq4 = r_df*phi_df - params->r_mid_0*params->phi_df_0;
-    gsl_vector_set(f,3,eq4);
-    double eq5 = r_ec*phi_ec - params->r_mid_0*params->phi_ec_0;
-    gsl_vector_set(f,4,eq5);
-    double eq6 = r_fe*phi_fe - params->r_mid_0*params->phi_fe_0;
-    gsl_vector_set(f,5,eq6);
-    double eq7 = r_ge*phi_ge + r_gf*phi_gf - params->r_bot_0*(params->phi_ge_0 + params->phi_gf_0);
-    gsl_vector_set(f,6,eq7);
-
-    // Point A continuity
-    double eq8 = -r_ad*gsl_sf_cos(a_ad) + x_ad - params->Ax;
-    gsl_vector_set(f,7,eq8);
-    double eq9 = r_ad*gsl_sf_sin(a_ad) + y_ad - params->Ay;
-    gsl_vector_set(f,8,eq9);
-
-    // Point B continuity
-    double eq10 = -r_cb*gsl_sf_cos(a_cb+phi_cb) + x_cb - params->Bx;
-    gsl_vector_set(f,9,eq10);
-    double eq11 = r_cb*gsl_sf_sin(a_cb+phi_cb) + y_cb - params->By;
-    gsl_vector_set(f,10,eq11);
-
-    // Point C continuity
-    double eq12 = -r_dc*gsl_sf_cos(a_dc+phi_dc) + x_dc - (-r_cb*gsl_sf_cos(a_cb) + x_cb);
-    gsl_vector_set(f,11,eq12);
-    double eq13 = r_dc*gsl_sf_sin(a_dc+phi_dc) + y_dc - (r_cb*gsl_sf_sin(a_cb) + y_cb);
-    gsl_vector_set(f,12,eq13);
-    double eq14 = -r_dc*gsl_sf_cos(a_dc+phi_dc) + x_dc - (-r_ec*gsl_sf_cos(a_ec+phi_ec) + x_ec);
-    gsl_vector_set(f,13,eq14);
-    double eq15 = r_dc*gsl_sf_sin(a_dc+phi_dc) + y_dc - (r_ec*gsl_sf_sin(a_ec+phi_ec) + y_ec);
-    gsl_vector_set(f,14,eq15);
-
-    // Point D continuity
-    double eq16 = -r_ad*gsl_sf_cos(a_ad+phi_ad) + x_ad - (-r_dc*gsl_sf_cos(a_dc) + x_dc);
-    gsl_vector_set(f,15,eq16);
-    double eq17 = r_ad*gsl_sf_sin(a_ad+phi_ad) + y_ad - (r_dc*gsl_sf_sin(a_dc) + y_dc);
-    gsl_vector_set(f,16,eq17);
-    double eq18 = -r_ad*gsl_sf_cos(a_ad+phi_ad) + x_ad - (-r_df*gsl_sf_cos(a_df) + x_df);
-    gsl_vector_set(f,17,eq18);
-    double eq19 = r_ad*gsl_sf_sin(a_ad+phi_ad) + y_ad - (r_df*gsl_sf_sin(a_df) + y_df);
-    gsl_vector_set(f,18,eq19);
-
-    // Point E continuity
-    double eq20 = -r_ec*gsl_sf_cos(a_ec) + x_ec - (-r_fe*gsl_sf_cos(a_fe+phi_fe) + x_fe);
-    gsl_vector_set(f,19,eq20);
-    double eq21 = r_ec*gsl_sf_sin(a_ec) + y_ec - (r_fe*gsl_sf_sin(a_fe+phi_fe) + y_fe);
-    gsl_vector_set(f,20,eq21);
-    double eq22 = -r_ec*gsl_sf_cos(a_ec) + x_ec - (-r_ge*gsl_sf_cos(a_ge+phi_ge) + x_bot);
-    gsl_vector_set(f,21,eq22);
-    double eq23 = r_ec*gsl_sf_sin(a_ec) + y_ec - (r_ge*gsl_sf_sin(a_ge+phi_ge) + y_ge);
-    gsl_vector_set(f,22,eq23);
-
-    // Point F continuity
-    double eq24 = -r_fe*gsl_sf_cos(a_fe) + x_fe - (-r_df*gsl_sf_cos(a_df+phi_df) + x_df);
-    gsl_vector_set(f,23,eq24);
-    double eq25 = r_fe*gsl_sf_sin(a_fe) + y_fe - (r_df*gsl_sf_sin(a_df+phi_df) + y_df);
-    gsl_vector_set(f,24,eq25);
-    double eq26 = -r_fe*gsl_sf_cos(a_fe) + x_fe - (-r_gf*gsl_sf_cos(a_gf-phi_gf) + x_bot);
-    gsl_vector_set(f,25,eq26);
-    double eq27 = r_fe*gsl_sf_sin(a_fe) + y_fe - (r_gf*gsl_sf_sin(a_gf-phi_gf) + y_gf);
-    gsl_vector_set(f,26,eq27);
-
-    // Point G continuity
-    double eq28 = y_ge - r_ge - (y_gf - r_gf);
-    gsl_vector_set(f,27,eq28);
-
-    // Point D steadiness
-    double eq29 = -p_top*r_ad*gsl_sf_sin(a_ad+phi_ad) + (p_top-p_mid)*r_dc*gsl_sf_sin(a_dc) + p_mid*r_df*gsl_sf_sin(a_df);
-    gsl_vector_set(f,28,eq29);
-    double eq30 = -p_top*r_ad*gsl_sf_cos(a_ad+phi_ad) + (p_top-p_mid)*r_dc*gsl_sf_cos(a_dc) + p_mid*r_df*gsl_sf_cos(a_df);
-    gsl_vector_set(f,29,eq30);
-
-    // Point C steadiness
-    double eq31 = (p_top-params->p_ac)*r_cb*gsl_sf_sin(a_cb) - (p_top-p_mid)*r_dc*gsl_sf_sin(a_dc+phi_dc) - (p_mid-params->p_ac)*r_ec*gsl_sf_sin(a_ec+phi_ec);
-    gsl_vector_set(f,30,eq31);
-    double eq32 = (p_top-params->p_ac)*r_cb*gsl_sf_cos(a_cb) - (p_top-p_mid)*r_dc*gsl_sf_cos(a_dc+phi_dc) - (p_mid-params->p_ac)*r_ec*gsl_sf_cos(a_ec+phi_ec);
-    gsl_vector_set(f,31,eq32);
-
-    // Point E steadiness
-    double eq33 = (p_mid-params->p_ac)*r_ec*gsl_sf_sin(a_ec) - (p_mid-p_bot)*r_fe*gsl_sf_sin(a_fe+phi_fe) - (p_bot-params->p_ac)*r_ge*gsl_sf_sin(a_ge+phi_ge);
-    gsl_vector_set(f,32,eq33);
-    double eq34 = (p_mid-params->p_ac)*r_ec*gsl_sf_cos(a_ec) - (p_mid-p_bot)*r_fe*gsl_sf_cos(a_fe+phi_fe) - (p_bot-params->p_ac)*r_ge*gsl_sf_cos(a_ge+phi_ge);
-    gsl_vector_set(f,33,eq34);
-
-    // Point F steadiness
-    double eq35 = -p_mid*r_df*gsl_sf_sin(a_df+phi_df) + (p_mid-p_bot)*r_fe*gsl_sf_sin(a_fe) + p_bot*r_gf*gsl_sf_sin(a_gf-phi_gf);
-    gsl_vector_set(f,34,eq35);
-    double eq36 = -p_mid*r_df*gsl_sf_cos(a_df+phi_df) + (p_mid-p_bot)*r_fe*gsl_sf_cos(a_fe) + p_bot*r_gf*gsl_sf_cos(a_gf-phi_gf);
-    gsl_vector_set(f,35,eq36);
-
-    // Point G steadiness
-    double eq37 = (p_bot-params->p_ac)*r_ge - p_bot*r_gf;
-    gsl_vector_set(f,36,eq37);
-
-
-    // Balloons pressures
-    double eq38 = p_top - params->p_top_0;
-    gsl_vector_set(f,37,eq38);
-    double eq39 = p_mid - params->p_mid_0;
-    gsl_vector_set(f,38,eq39);
-    double eq40 = p_bot - params->p_bot_0;
-    gsl_vector_set(f,39,eq40);
-
-    return GSL_SUCCESS;
+#include <gsl/gsl_math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+const struct field_desc system_3_levels_user_params_fields[] = {
+    FIELD_DESC(struct system_3_levels_user_params,phi_ad_0),
+    FIELD_DESC(struct system_3_levels_user_params,phi_dc_0),
+    FIELD_DESC(struct system_3_levels_user_params,phi_df_0),
+    FIELD_DESC(struct system_3_levels_user_params,phi_fe_0),
+    FIELD_DESC(struct system_3_levels_user_params,r_top_0),
+    FIELD_DESC(struct system_3_levels_user_params,r_mid_0),
+    FIELD_DESC(struct system_3_levels_user_params,r_bot_0),
+    FIELD_DESC(struct system_3_levels_user_params,p_top_0),
+    FIELD_DESC(struct system_3_levels_user_params,p_mid_0),
+    FIELD_DESC(struct system_3_levels_user_params,p_bot_0),
+    FIELD_DESC(struct system_3_levels_user_params,Ax),
+    FIELD_DESC(struct system_3_levels_user_params,Ay),
+    FIELD_DESC(struct system_3_levels_user_params,Bx),
+    FIELD_DESC(struct system_3_levels_user_params,By),
+    FIELD_DESC(struct system_3_levels_user_params,p_atm),
+    FIELD_DESC(struct system_3_levels_user_params,p_ac),
+    FIELD_DESC(struct system_3_levels_user_params,k)
+};
+const size_t system_3_levels_user_params_n_fields = sizeof(system_3_levels_user_params_fields)/sizeof(struct field_desc);
+
+const struct field_desc system_3_levels_result_fields[] = {
+    FIELD_DESC(struct system_3_levels_result,phi_ad),
+    FIELD_DESC(struct system_3_levels_result,r_ad),
+    FIELD_DESC(struct system_3_levels_result,x_ad),
+    FIELD_DESC(struct system_3_levels_result,y_ad),
+    FIELD_DESC(struct system_3_levels_result,a_ad),
+    FIELD_DESC(struct system_3_levels_result,phi_cb),
+    FIELD_DESC(struct system_3_levels_result,r_cb),
+    FIELD_DESC(struct system_3_levels_result,x_cb),
+    FIELD_DESC(struct system_3_levels_result,y_cb),
+    FIELD_DESC(struct system_3_levels_result,a_cb),
+    FIELD_DESC(struct system_3_levels_result,phi_dc),
+    FIELD_DESC(struct system_3_levels_result,r_dc),
+    FIELD_DESC(struct system_3_levels_result,x_dc),
+    FIELD_DESC(struct system_3_levels_result,y_dc),
+    FIELD_DESC(struct system_3_levels_result,a_dc),
+    FIELD_DESC(struct system_3_levels_result,phi_df),
+    FIELD_DESC(struct system_3_levels_result,r_df),
+    FIELD_DESC(struct system_3_levels_result,x_df),
+    FIELD_DESC(struct system_3_levels_result,y_df),
+    FIELD_DESC(struct system_3_levels_result,a_df),
+    FIELD_DESC(struct system_3_levels_result,phi_ec),
+    FIELD_DESC(struct system_3_levels_result,r_ec),
+    FIELD_DESC(struct system_3_levels_result,x_ec),
+    FIELD_DESC(struct system_3_levels_result,y_ec),
+    FIELD_DESC(struct system_3_levels_result,a_ec),
+    FIELD_DESC(struct system_3_levels_result,phi_fe),
+    FIELD_DESC(struct system_3_levels_result,r_fe),
+    FIELD_DESC(struct system_3_levels_result,x_fe),
+    FIELD_DESC(struct system_3_levels_result,y_fe),
+    FIELD_DESC(struct system_3_levels_result,a_fe),
+    FIELD_DESC(struct system_3_levels_result,phi_ge),
+    FIELD_DESC(struct system_3_levels_result,r_ge),
+    FIELD_DESC(struct system_3_levels_result,y_ge),
+    FIELD_DESC(struct system_3_levels_result,phi_gf),
+    FIELD_DESC(struct system_3_levels_result,r_gf),
+    FIELD_DESC(struct system_3_levels_result,y_gf),
+    FIELD_DESC(struct system_3_levels_result,x_bot),
+    FIELD_DESC(struct system_3_levels_result,p_bot),
+    FIELD_DESC(struct system_3_levels_result,p_mid),
+    FIELD_DESC(struct system_3_levels_result,p_top)
+};
+const size_t system_3_levels_result_n_fields = sizeof(system_3_levels_result_fields)/sizeof(struct field_desc);
+
+
+void system_3_levels_default_user_params(struct system_3_levels_user_params *user_params)
+{
+    user_params->Ax = 0.482;
+    user_params->Ay = 1.8;
+    user_params->Bx = 0.78;
+    user_params->By = 1.25;
+    user_params->p_ac = 1500;
+    user_params->p_atm = 101325;
+    user_params->p_bot_0 = 6500;
+    user_params->p_mid_0 = 12000;
+    user_params->p_top_0 = 20000;
+    user_params->phi_ad_0 = 3.129;
+    user_params->phi_dc_0 = 1.162;
+    user_params->phi_df_0 = 1.8;
+    user_params->phi_fe_0 = 1.0;
+    user_params->r_bot_0 = 0.3;
+    user_params->r_mid_0 = 0.4;
+    user_params->r_top_0 = 0.5;
+    user_params->k = 1.4;
 }
 
 
-int system_3_levels_df(const gsl_vector *x, void *p, gsl_matrix *J)
-{
-    struct system_3_levels_params *params = (struct system_3_levels_params*)p;
-    
-    const double phi_ad = gsl_vector_get(x,0);
-    const double r_ad = gsl_vector_get(x,1);
-    //const double x_ad = gsl_vector_get(x,2);
-    //const double y_ad = gsl_vector_get(x,3);
-    const double a_ad = gsl_vector_get(x,4);
-    const double phi_cb = gsl_vector_get(x,5);
-    const double r_cb = gsl_vector_get(x,6);
-    //const double x_cb = gsl_vector_get(x,7);
-    //const double y_cb = gsl_vector_get(x,8);
-    const double a_cb = gsl_vector_get(x,9);
-    const double phi_dc = gsl_vector_get(x,10);
-    const double r_dc = gsl_vector_get(x,11);
-    //const double x_dc = gsl_vector_get(x,12);
-    //const double y_dc = gsl_vector_get(x,13);
-    const double a_dc = gsl_vector_get(x,14);
-    const double phi_df = gsl_vector_get(x,15);
-    const double r_df = gsl_vector_get(x,16);
-    //const double x_df = gsl_vector_get(x,17);
-    //const double y_df = gsl_vector_get(x,18);
-    const double a_df = gsl_vector_get(x,19);
-    const double phi_ec = gsl_vector_get(x,20);
-    const double r_ec = gsl_vector_get(x,21);
-    //const double x_ec = gsl_vector_get(x,22);
-    //const double y_ec = gsl_vector_get(x,23);
-    const double a_ec = gsl_vector_get(x,24);
-    const double phi_fe = gsl_vector_get(x,25);
-    const double r_fe = gsl_vector_get(x,26);
-    //const double x_fe = gsl_vector_get(x,27);
-    //const double y_fe = gsl_vector_get(x,28);
-    const double a_fe = gsl_vector_get(x,29);
-    const double phi_ge = gsl_vector_get(x,30);
-    const double r_ge = gsl_vector_get(x,31);
-    //const double y_ge = gsl_vector_get(x,32);
-    const double phi_gf = gsl_vector_get(x,33);
-    const double r_gf = gsl_vector_get(x,34);
-    //const double y_gf = gsl_vector_get(x,35);
-    //const double x_bot = gsl_vector_get(x,36);
-    const double p_top = gsl_vector_get(x,37);
-    const double p_mid = gsl_vector_get(x,38);
-    const double p_bot = gsl_vector_get(x,39);
-
-    const double a_ge = 3*M_PI_2;
-    const double a_gf = 3*M_PI_2;
-
-    gsl_matrix_set_all(J,0);
-
-    // Preservation of length
-    gsl_matrix_set(J,0,0,r_ad);
-    gsl_matrix_set(J,0,1,phi_ad);
-    
-    gsl_matrix_set(J,1,5,r_cb);
-    gsl_matrix_set(J,1,6,phi_cb);
-
-    gsl_matrix_set(J,2,10,r_dc);
-    gsl_matrix_set(J,2,11,phi_dc);
-    
-    gsl_matrix_set(J,3,15,r_df);
-    gsl_matrix_set(J,3,16,phi_df);
-
-    gsl_matrix_set(J,4,20,r_ec);
-    gsl_matrix_set(J,4,21,phi_ec);
-
-    gsl_matrix_set(J,5,25,r_fe);
-    gsl_matrix_set(J,5,26,phi_fe);
-
-    gsl_matrix_set(J,6,30,r_ge);
-    gsl_matrix_set(J,6,31,phi_ge);
-    gsl_matrix_set(J,6,33,r_gf);
-    gsl_matrix_set(J,6,34,phi_gf);
-
-
-    // Point A continuity
-    gsl_matrix_set(J,7,1,-gsl_sf_cos(a_ad));
-    gsl_matrix_set(J,7,2,1);
-    gsl_matrix_set(J,7,4,r_ad*gsl_sf_sin(a_ad));
-    
-    gsl_matrix_set(J,8,1,gsl_sf_sin(a_ad));
-    gsl_matrix_set(J,8,3,1);
-    gsl_matrix_set(J,8,4,r_ad*gsl_sf_cos(a_ad));
-    
-
-    // Point B continuity
-    gsl_matrix_set(J,9,5,r_cb*gsl_sf_sin(phi_cb+a_cb));
-    gsl_matrix_set(J,9,6,-gsl_sf_cos(phi_cb+a_cb));
-    gsl_matrix_set(J,9,7,1);
-    gsl_matrix_set(J,9,9,r_cb*gsl_sf_sin(phi_cb+a_cb));
-    
-    gsl_matrix_set(J,10,5,r_cb*gsl_sf_cos(phi_cb+a_cb));
-    gsl_matrix_set(J,10,6,gsl_sf_sin(phi_cb+a_cb));
-    gsl_matrix_set(J,10,8,1);
-    gsl_matrix_set(J,10,9,r_cb*gsl_sf_cos(phi_cb+a_cb));
-    
-
-    // Point C continuity
-    gsl_matrix_set(J,11,6,gsl_sf_cos(a_cb));
-    gsl_matrix_set(J,11,7,-1);
-    gsl_matrix_set(J,11,9,-r_cb*gsl_sf_sin(a_cb));
-    gsl_matrix_set(J,11,10,r_dc*gsl_sf_sin(phi_dc+a_dc));
-    gsl_matrix_set(J,11,11,-gsl_sf_cos(phi_dc+a_dc));
-    gsl_matrix_set(J,11,12,1);
-    gsl_matrix_set(J,11,14,r_dc*gsl_sf_sin(phi_dc+a_dc));
-
-    gsl_matrix_set(J,12,6,-gsl_sf_sin(a_cb));
-    gsl_matrix_set(J,12,8,-1);
-    gsl_matrix_set(J,12,9,-r_cb*gsl_sf_cos(a_cb));
-    gsl_matrix_set(J,12,10,r_dc*gsl_sf_cos(phi_dc+a_dc));
-    gsl_matrix_set(J,12,11,gsl_sf_sin(phi_dc+a_dc));
-    gsl_matrix_set(J,12,13,1);
-    gsl_matrix_set(J,12,14,r_dc*gsl_sf_cos(phi_dc+a_dc));
-    
-    gsl_matrix_set(J,13,10,r_dc*gsl_sf_sin(phi_dc+a_dc));
-    gsl_matrix_set(J,13,11,-gsl_sf_cos(phi_dc+a_dc));
-    gsl_matrix_set(J,13,12,1);
-    gsl_matrix_set(J,13,14,r_dc*gsl_sf_sin(phi_dc+a_dc));
-    gsl_matrix_set(J,13,20,-r_ec*gsl_sf_sin(a_ec+phi_ec));
-    gsl_matrix_set(J,13,21,gsl_sf_cos(a_ec+phi_ec));
-    gsl_matrix_set(J,13,22,-1);
-    gsl_matrix_set(J,13,24,-r_ec*gsl_sf_sin(a_ec+phi_ec));
-
-    gsl_matrix_set(J,14,10,r_dc*gsl_sf_cos(phi_dc+a_dc));
-    gsl_matrix_set(J,14,11,gsl_sf_sin(phi_dc+a_dc));
-    gsl_matrix_set(J,14,13,1);
-    gsl_matrix_set(J,14,14,r_dc*gsl_sf_cos(phi_dc+a_dc));
-    gsl_matrix_set(J,14,20,-r_ec*gsl_sf_cos(a_ec+phi_ec));
-    gsl_matrix_set(J,14,21,-gsl_sf_sin(a_ec+phi_ec));
-    gsl_matrix_set(J,14,23,-1);
-    gsl_matrix_set(J,14,24,-r_ec*gsl_sf_cos(a_ec+phi_ec));
-
-
-    // Point D continuity
-    gsl_matrix_set(J,15,0,r_ad*gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,15,1,-gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,15,2,1);
-    gsl_matrix_set(J,15,4,r_ad*gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,15,11,gsl_sf_cos(a_dc));
-    gsl_matrix_set(J,15,12,-1);
-    gsl_matrix_set(J,15,14,-r_dc*gsl_sf_sin(a_dc));
-
-    gsl_matrix_set(J,16,0,r_ad*gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,16,1,gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,16,3,1);
-    gsl_matrix_set(J,16,4,r_ad*gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,16,11,-gsl_sf_sin(a_dc));
-    gsl_matrix_set(J,16,13,-1);
-    gsl_matrix_set(J,16,14,-r_dc*gsl_sf_cos(a_dc));
-
-    gsl_matrix_set(J,17,0,r_ad*gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,17,1,-gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,17,2,1);
-    gsl_matrix_set(J,17,4,r_ad*gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,17,16,gsl_sf_cos(a_df));
-    gsl_matrix_set(J,17,17,-1);
-    gsl_matrix_set(J,17,19,-r_df*gsl_sf_sin(a_df));
-
-    gsl_matrix_set(J,18,0,r_ad*gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,18,1,gsl_sf_sin(phi_ad+a_ad));
-    gsl_matrix_set(J,18,3,1);
-    gsl_matrix_set(J,18,4,r_ad*gsl_sf_cos(phi_ad+a_ad));
-    gsl_matrix_set(J,18,16,-gsl_sf_sin(a_df));
-    gsl_matrix_set(J,18,18,-1);
-    gsl_matrix_set(J,18,19,-r_df*gsl_sf_cos(a_df));
-
-
-    // Point E continuity
-    gsl_matrix_set(J,19,21,-gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,19,22,1);
-    gsl_matrix_set(J,19,24,r_ec*gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,19,25,-r_fe*gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,19,26,gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,19,27,-1);
-    gsl_matrix_set(J,19,29,-r_fe*gsl_sf_sin(a_fe+phi_fe));
-
-    gsl_matrix_set(J,20,21,gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,20,23,1);
-    gsl_matrix_set(J,20,24,r_ec*gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,20,25,-r_fe*gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,20,26,-gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,20,28,-1);
-    gsl_matrix_set(J,20,29,-r_fe*gsl_sf_cos(a_fe+phi_fe));
-
-    gsl_matrix_set(J,21,21,-gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,21,22,1);
-    gsl_matrix_set(J,21,24,r_ec*gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,21,30,-r_ge*gsl_sf_sin(a_ge+phi_ge));
-    gsl_matrix_set(J,21,31,gsl_sf_cos(a_ge+phi_ge));
-    gsl_matrix_set(J,21,36,-1);
-
-    gsl_matrix_set(J,22,21,gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,22,23,1);
-    gsl_matrix_set(J,22,24,r_ec*gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,22,30,-r_ge*gsl_sf_cos(a_ge+phi_ge));
-    gsl_matrix_set(J,22,31,-gsl_sf_sin(a_ge+phi_ge));
-    gsl_matrix_set(J,22,32,-1);
-
-
-    // Point F continuity
-    gsl_matrix_set(J,23,26,-gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,23,27,1);
-    gsl_matrix_set(J,23,29,r_fe*gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,23,15,-r_df*gsl_sf_sin(a_df+phi_df));
-    gsl_matrix_set(J,23,16,gsl_sf_cos(a_df+phi_df));
-    gsl_matrix_set(J,23,17,-1);
-    gsl_matrix_set(J,23,19,-r_df*gsl_sf_sin(a_df+phi_df));
-
-    gsl_matrix_set(J,24,26,gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,24,28,1);
-    gsl_matrix_set(J,24,29,r_fe*gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,24,15,-r_df*gsl_sf_cos(a_df+phi_df));
-    gsl_matrix_set(J,24,16,-gsl_sf_sin(a_df+phi_df));
-    gsl_matrix_set(J,24,18,-1);
-    gsl_matrix_set(J,24,19,-r_df*gsl_sf_cos(a_df+phi_df));
-
-    gsl_matrix_set(J,25,26,-gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,25,27,1);
-    gsl_matrix_set(J,25,29,r_fe*gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,25,33,r_gf*gsl_sf_sin(a_gf-phi_gf));
-    gsl_matrix_set(J,25,34,gsl_sf_cos(a_gf-phi_gf));
-    gsl_matrix_set(J,25,36,-1);
-
-    gsl_matrix_set(J,26,26,gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,26,28,1);
-    gsl_matrix_set(J,26,29,r_fe*gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,26,33,r_gf*gsl_sf_cos(a_gf-phi_gf));
-    gsl_matrix_set(J,26,34,-gsl_sf_sin(a_gf-phi_gf));
-    gsl_matrix_set(J,26,35,-1);
-
-    // Point G continuity
-    gsl_matrix_set(J,27,31,-1);
-    gsl_matrix_set(J,27,32,1);
-    gsl_matrix_set(J,27,34,1);
-    gsl_matrix_set(J,27,35,-1);
-
-
-    // Point D steadiness
-    gsl_matrix_set(J,28,0,-p_top*r_ad*gsl_sf_cos(a_ad+phi_ad));
-    gsl_matrix_set(J,28,1,-p_top*gsl_sf_sin(a_ad+phi_ad));
-    gsl_matrix_set(J,28,4,-p_top*r_ad*gsl_sf_cos(a_ad+phi_ad));
-    gsl_matrix_set(J,28,11,(p_top-p_mid)*gsl_sf_sin(a_dc));
-    gsl_matrix_set(J,28,14,(p_top-p_mid)*r_dc*gsl_sf_cos(a_dc));
-    gsl_matrix_set(J,28,16,p_mid*gsl_sf_sin(a_df));
-    gsl_matrix_set(J,28,19,p_mid*r_df*gsl_sf_cos(a_df));
-    gsl_matrix_set(J,28,37,-r_ad*gsl_sf_sin(a_ad+phi_ad) + r_dc*gsl_sf_sin(a_dc));
-    gsl_matrix_set(J,28,38,-r_dc*gsl_sf_sin(a_dc) + r_df*gsl_sf_sin(a_df));
-
-    gsl_matrix_set(J,29,0,p_top*r_ad*gsl_sf_sin(a_ad+phi_ad));
-    gsl_matrix_set(J,29,1,-p_top*gsl_sf_cos(a_ad+phi_ad));
-    gsl_matrix_set(J,29,4,p_top*r_ad*gsl_sf_sin(a_ad+phi_ad));
-    gsl_matrix_set(J,29,11,(p_top-p_mid)*gsl_sf_cos(a_dc));
-    gsl_matrix_set(J,29,14,-(p_top-p_mid)*r_dc*gsl_sf_sin(a_dc));
-    gsl_matrix_set(J,29,16,p_mid*gsl_sf_cos(a_df));
-    gsl_matrix_set(J,29,19,-p_mid*r_df*gsl_sf_sin(a_df));
-    gsl_matrix_set(J,29,37,-r_ad*gsl_sf_cos(a_ad+phi_ad) + r_dc*gsl_sf_cos(a_dc));
-    gsl_matrix_set(J,29,38,-r_dc*gsl_sf_cos(a_dc) + r_df*gsl_sf_cos(a_df));
-
-
-    // Point C steadiness
-    gsl_matrix_set(J,30,6,(p_top-params->p_ac)*gsl_sf_sin(a_cb));
-    gsl_matrix_set(J,30,9,(p_top-params->p_ac)*r_cb*gsl_sf_cos(a_cb));
-    gsl_matrix_set(J,30,10,-(p_top-p_mid)*r_dc*gsl_sf_cos(a_dc+phi_dc));
-    gsl_matrix_set(J,30,11,-(p_top-p_mid)*gsl_sf_sin(a_dc+phi_dc));
-    gsl_matrix_set(J,30,14,-(p_top-p_mid)*r_dc*gsl_sf_cos(a_dc+phi_dc));
-    gsl_matrix_set(J,30,20,-(p_mid-params->p_ac)*r_ec*gsl_sf_cos(a_ec+phi_ec));
-    gsl_matrix_set(J,30,21,-(p_mid-params->p_ac)*gsl_sf_sin(a_ec+phi_ec));
-    gsl_matrix_set(J,30,24,-(p_mid-params->p_ac)*r_ec*gsl_sf_cos(a_ec+phi_ec));
-    gsl_matrix_set(J,30,37,r_cb*gsl_sf_sin(a_cb) - r_dc*gsl_sf_sin(a_dc+phi_dc));
-    gsl_matrix_set(J,30,38,r_dc*gsl_sf_sin(a_dc+phi_dc) - r_ec*gsl_sf_sin(a_ec+phi_ec));
-
-    gsl_matrix_set(J,31,6,(p_top-params->p_ac)*gsl_sf_cos(a_cb));
-    gsl_matrix_set(J,31,9,-(p_top-params->p_ac)*r_cb*gsl_sf_sin(a_cb));
-    gsl_matrix_set(J,31,10,(p_top-p_mid)*r_dc*gsl_sf_sin(a_dc+phi_dc));
-    gsl_matrix_set(J,31,11,-(p_top-p_mid)*gsl_sf_cos(a_dc+phi_dc));
-    gsl_matrix_set(J,31,14,(p_top-p_mid)*r_dc*gsl_sf_sin(a_dc+phi_dc));
-    gsl_matrix_set(J,31,20,(p_mid-params->p_ac)*r_ec*gsl_sf_sin(a_ec+phi_ec));
-    gsl_matrix_set(J,31,21,-(p_mid-params->p_ac)*gsl_sf_cos(a_ec+phi_ec));
-    gsl_matrix_set(J,31,24,(p_mid-params->p_ac)*r_ec*gsl_sf_sin(a_ec+phi_ec));
-    gsl_matrix_set(J,31,37,r_cb*gsl_sf_cos(a_cb) - r_dc*gsl_sf_cos(a_dc+phi_dc));
-    gsl_matrix_set(J,31,38,r_dc*gsl_sf_cos(a_dc+phi_dc) - r_ec*gsl_sf_cos(a_ec+phi_ec));
-
-
-    // Point E steadiness
-    gsl_matrix_set(J,32,21,(p_mid-params->p_ac)*gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,32,24,(p_mid-params->p_ac)*r_ec*gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,32,25,-(p_mid-p_bot)*r_fe*gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,32,26,-(p_mid-p_bot)*gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,32,29,-(p_mid-p_bot)*r_fe*gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,32,30,-(p_bot-params->p_ac)*r_ge*gsl_sf_cos(a_ge+phi_ge));
-    gsl_matrix_set(J,32,31,-(p_bot-params->p_ac)*gsl_sf_sin(a_ge+phi_ge));
-    gsl_matrix_set(J,32,38,r_ec*gsl_sf_sin(a_ec) - r_fe*gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,32,39,r_fe*gsl_sf_sin(a_fe+phi_fe) - r_ge*gsl_sf_sin(a_ge+phi_ge));
-
-    gsl_matrix_set(J,33,21,(p_mid-params->p_ac)*gsl_sf_cos(a_ec));
-    gsl_matrix_set(J,33,24,-(p_mid-params->p_ac)*r_ec*gsl_sf_sin(a_ec));
-    gsl_matrix_set(J,33,25,(p_mid-p_bot)*r_fe*gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,33,26,-(p_mid-p_bot)*gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,33,29,(p_mid-p_bot)*r_fe*gsl_sf_sin(a_fe+phi_fe));
-    gsl_matrix_set(J,33,30,(p_bot-params->p_ac)*r_ge*gsl_sf_sin(a_ge+phi_ge));
-    gsl_matrix_set(J,33,31,-(p_bot-params->p_ac)*gsl_sf_cos(a_ge+phi_ge));
-    gsl_matrix_set(J,33,38,r_ec*gsl_sf_cos(a_ec) - r_fe*gsl_sf_cos(a_fe+phi_fe));
-    gsl_matrix_set(J,33,39,r_fe*gsl_sf_cos(a_fe+phi_fe) - r_ge*gsl_sf_cos(a_ge+phi_ge));
-
-
-    // Point F steadiness
-    gsl_matrix_set(J,34,15,-p_mid*r_df*gsl_sf_cos(a_df+phi_df));
-    gsl_matrix_set(J,34,16,-p_mid*gsl_sf_sin(a_df+phi_df));
-    gsl_matrix_set(J,34,19,-p_mid*r_df*gsl_sf_cos(a_df+phi_df));
-    gsl_matrix_set(J,34,26,(p_mid-p_bot)*gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,34,29,(p_mid-p_bot)*r_fe*gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,34,33,-p_bot*r_gf*gsl_sf_cos(a_gf-phi_gf));
-    gsl_matrix_set(J,34,34,p_bot*gsl_sf_sin(a_gf-phi_gf));
-    gsl_matrix_set(J,34,38,-r_df*gsl_sf_sin(a_df+phi_df) + r_fe*gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,34,39,-r_fe*gsl_sf_sin(a_fe) + r_gf*gsl_sf_sin(a_gf-phi_gf));
-
-    gsl_matrix_set(J,35,15,p_mid*r_df*gsl_sf_sin(a_df+phi_df));
-    gsl_matrix_set(J,35,16,-p_mid*gsl_sf_cos(a_df+phi_df));
-    gsl_matrix_set(J,35,19,p_mid*r_df*gsl_sf_sin(a_df+phi_df));
-    gsl_matrix_set(J,35,26,(p_mid-p_bot)*gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,35,29,-(p_mid-p_bot)*r_fe*gsl_sf_sin(a_fe));
-    gsl_matrix_set(J,35,33,p_bot*r_gf*gsl_sf_sin(a_gf-phi_gf));
-    gsl_matrix_set(J,35,34,p_bot*gsl_sf_cos(a_gf-phi_gf));
-    gsl_matrix_set(J,35,38,-r_df*gsl_sf_cos(a_df+phi_df) + r_fe*gsl_sf_cos(a_fe));
-    gsl_matrix_set(J,35,39,-r_fe*gsl_sf_cos(a_fe) + r_gf*gsl_sf_cos(a_gf-phi_gf));
-
-
-    // Point E steadiness
-    gsl_matrix_set(J,36,34,-p_bot);
-    gsl_matrix_set(J,36,31,(p_bot-params->p_ac));
-    gsl_matrix_set(J,36,39,r_ge-r_gf);
-
-    
-    // Balloons pressures
-    gsl_matrix_set(J,37,37,1);
-    gsl_matrix_set(J,38,38,1);
-    gsl_matrix_set(J,39,39,1);
-
-    return GSL_SUCCESS;
+// The model is the stack of three levels of system_n_levels_stack, arcs ad,
+// cb, dc and df, ec, fe are its upper levels and gf, ge the halves of its
+// bottom one. Members of the stack params, parallel to
+// system_3_levels_user_params_fields
+static const size_t __system_3_levels_stack_offsets[] = {
+    offsetof(struct system_n_levels_user_params,phi_left_0[0]),
+    offsetof(struct system_n_levels_user_params,phi_membrane_0[0]),
+    offsetof(struct system_n_levels_user_params,phi_left_0[1]),
+    offsetof(struct system_n_levels_user_params,phi_membrane_0[1]),
+    offsetof(struct system_n_levels_user_params,r_0[0]),
+    offsetof(struct system_n_levels_user_params,r_0[1]),
+    offsetof(struct system_n_levels_user_params,r_0[2]),
+    offsetof(struct system_n_levels_user_params,p_0[0]),
+    offsetof(struct system_n_levels_user_params,p_0[1]),
+    offsetof(struct system_n_levels_user_params,p_0[2]),
+    offsetof(struct system_n_levels_user_params,Ax),
+    offsetof(struct system_n_levels_user_params,Ay),
+    offsetof(struct system_n_levels_user_params,Bx),
+    offsetof(struct system_n_levels_user_params,By),
+    offsetof(struct system_n_levels_user_params,p_atm),
+    offsetof(struct system_n_levels_user_params,p_ac),
+    offsetof(struct system_n_levels_user_params,k)
+};
+
+
+void system_3_levels_stack_params(const struct system_3_levels_user_params *user_params, struct system_n_levels_user_params *stack)
+{
+    memset(stack,0,sizeof(struct system_n_levels_user_params));
+    stack->n_levels = 3;
+    for(size_t i = 0; i < system_3_levels_user_params_n_fields; ++i)
+        *(double*)((char*)stack + __system_3_levels_stack_offsets[i]) = *(const double*)((const char*)user_params + system_3_levels_user_params_fields[i].offset);
 }
 
 
-int system_3_levels_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J)
+static void __system_3_levels_res_to_stack(const struct system_3_levels_result *result, struct system_n_levels_result *stack)
 {
-    system_3_levels_f(x,p,f);
-    system_3_levels_df(x,p,J);
+    stack->n_arcs = 8;
+    stack->n_chambers = 3;
+    stack->arcs[0] = (struct system_n_levels_arc_state){result->phi_ad,result->r_ad,result->x_ad,result->y_ad,result->a_ad};
+    stack->arcs[1] = (struct system_n_levels_arc_state){result->phi_cb,result->r_cb,result->x_cb,result->y_cb,result->a_cb};
+    stack->arcs[2] = (struct system_n_levels_arc_state){result->phi_dc,result->r_dc,result->x_dc,result->y_dc,result->a_dc};
+    stack->arcs[3] = (struct system_n_levels_arc_state){result->phi_df,result->r_df,result->x_df,result->y_df,result->a_df};
+    stack->arcs[4] = (struct system_n_levels_arc_state){result->phi_ec,result->r_ec,result->x_ec,result->y_ec,result->a_ec};
+    stack->arcs[5] = (struct system_n_levels_arc_state){result->phi_fe,result->r_fe,result->x_fe,result->y_fe,result->a_fe};
+    stack->arcs[6] = (struct system_n_levels_arc_state){result->phi_gf,result->r_gf,result->x_bot,result->y_gf,3*M_PI_2};
+    stack->arcs[7] = (struct system_n_levels_arc_state){result->phi_ge,result->r_ge,result->x_bot,result->y_ge,3*M_PI_2};
+    stack->p[0] = result->p_top;
+    stack->p[1] = result->p_mid;
+    stack->p[2] = result->p_bot;
+}
 
-    return GSL_SUCCESS;
+
+static void __system_3_levels_res_from_stack(const struct system_n_levels_result *stack, struct system_3_levels_result *result)
+{
+    const struct system_n_levels_arc_state *q = stack->arcs;
+    *result = (struct system_3_levels_result){
+        q[0].phi, q[0].r, q[0].cx, q[0].cy, q[0].a,
+        q[1].phi, q[1].r, q[1].cx, q[1].cy, q[1].a,
+        q[2].phi, q[2].r, q[2].cx, q[2].cy, q[2].a,
+        q[3].phi, q[3].r, q[3].cx, q[3].cy, q[3].a,
+        q[4].phi, q[4].r, q[4].cx, q[4].cy, q[4].a,
+        q[5].phi, q[5].r, q[5].cx, q[5].cy, q[5].a,
+        q[7].phi, q[7].r, q[7].cy,
+        q[6].phi, q[6].r, q[6].cy,
+        q[6].cx,
+        stack->p[2], stack->p[1], stack->p[0]
+    };
 }
 
 
-int system_3_levels_compute_init_config(const struct system_3_levels_user_params *user_params, gsl_vector *x0, struct system_3_levels_params *params)
-{
-    params->Ax = user_params->Ax;
-    params->Ay = user_params->Ay;
-    params->Bx = user_params->Bx;
-    params->By = user_params->By;
-    params->p_ac = user_params->p_ac;
-    params->p_atm = user_params->p_atm;
-    params->p_bot_0 = user_params->p_bot_0;
-    params->p_mid_0 = user_params->p_mid_0;
-    params->p_top_0 = user_params->p_top_0;
-    params->phi_ad_0 = user_params->phi_ad_0;
-    params->phi_dc_0 = user_params->phi_dc_0;
-    params->phi_df_0 = user_params->phi_df_0;
-    params->phi_fe_0 = user_params->phi_fe_0;
-    params->r_bot_0 = user_params->r_bot_0;
-    params->r_mid_0 = user_params->r_mid_0;
-    params->r_top_0 = user_params->r_top_0;
-
-    gsl_vector *A = gsl_vector_alloc(2);
-    gsl_vector_set(A,0,params->Ax);
-    gsl_vector_set(A,1,params->Ay);
-    gsl_vector *B = gsl_vector_alloc(2);
-    gsl_vector_set(B,0,params->Bx);
-    gsl_vector_set(B,1,params->By);
-
-    gsl_vector *center_top = gsl_vector_alloc(2);
-    if(center_from_points_and_radius(A,B,params->r_top_0,center_top) != GSL_SUCCESS)
+// Debug output of eval_f, one row named after the result fields
+static int __system_3_levels_write_table(const char *path, const struct system_n_levels *sys, const gsl_vector *x)
+{
+    struct system_n_levels_result stack_result;
+    struct system_3_levels_result result;
+    system_n_levels_x_to_res(sys,x,&stack_result);
+    __system_3_levels_res_from_stack(&stack_result,&result);
+
+    FILE *out = fopen(path,"wb");
+    if(!out)
+        return GSL_EFAILED;
+
+    int status = GSL_EFAILED;
+    struct table_writer *writer = table_writer_alloc_fields(out,2,system_3_levels_result_fields,system_3_levels_result_n_fields);
+    if(writer)
     {
-        fprintf(stderr,"Failed to compute top level center point\n");
-        exit(1);
+        table_writer_append_fields(writer,system_3_levels_result_fields,&result);
+        status = table_writer_close(writer);
     }
+    if(fclose(out))
+        status = GSL_EFAILED;
 
-    gsl_vector *uX = gsl_vector_calloc(2);
-    gsl_vector_set(uX,0,-1);
-    gsl_vector *cA = vector_centred(A,center_top);
-    double a_ad;
-    if(vectors_ang_clockwise(uX,cA,&a_ad) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute alpha AD\n");
-        exit(1);
-    }
+    return status;
+}
 
-    double a_dc = a_ad+params->phi_ad_0;
-    double a_cb = a_dc+params->phi_dc_0;
 
-    gsl_vector *D = gsl_vector_alloc(2);
-    if(point_from_alpha(a_dc,params->r_top_0,center_top,D) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute point D\n");
-        exit(1);
-    }
+int system_3_levels_eval_f()
+{
+    struct system_3_levels_user_params user_params;
+    struct system_n_levels_user_params stack_params;
+    system_3_levels_default_user_params(&user_params);
+    system_3_levels_stack_params(&user_params,&stack_params);
 
-    gsl_vector *C = gsl_vector_alloc(2);
-    if(point_from_alpha(a_cb,params->r_top_0,center_top,C) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute point C\n");
-        exit(1);
-    }
+    FILE *f_diff = fopen("diff.txt","w");
+    if(!f_diff)
+        perror("diff.txt");
 
-    gsl_vector *cB = vector_centred(B,center_top);
-    gsl_vector *cC_top = vector_centred(C,center_top);
-    double phi_cb;
-    if(vectors_ang_clockwise(cC_top,cB,&phi_cb) != GSL_SUCCESS)
+    struct system_n_levels sys;
+    gsl_vector *x0 = NULL;
+    const enum system_n_levels_pressure_law laws[] = {SYSTEM_N_LEVELS_ISOTHERMAL,SYSTEM_N_LEVELS_ADIABATIC};
+    for(size_t l = 0; l < 2; ++l)
     {
-        fprintf(stderr,"Failed to compute phi CB\n");
-        exit(1);
+        struct system_n_levels_topology topo;
+        int status = system_n_levels_stack(&stack_params,laws[l],&topo);
+        if(!status)
+            status = system_n_levels_assemble(&topo,&sys);
+        if(status)
+            return status;
+
+        if(!x0)
+            x0 = gsl_vector_alloc(sys.n_eq);
+        system_n_levels_x0(&sys,x0);
+        const struct system_n_levels_kernels *kernels = system_n_levels_kernels(&sys);
+        if(f_diff)
+            print_J_diff(f_diff,x0,&sys,kernels->f,kernels->df);
     }
+    if(f_diff)
+        fclose(f_diff);
 
-    gsl_vector *center_mid = gsl_vector_alloc(2);
-    if(center_from_points_and_radius(C,D,params->r_mid_0,center_mid) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute middle level center point\n");
-        exit(1);
-    }
+    // sys is the isothermal one again
+    struct system_n_levels_topology topo;
+    system_n_levels_stack(&stack_params,SYSTEM_N_LEVELS_ISOTHERMAL,&topo);
+    system_n_levels_assemble(&topo,&sys);
+    system_n_levels_x0(&sys,x0);
+    __system_3_levels_write_table("3_levels_init.cwt",&sys,x0);
 
-    gsl_vector *cD_mid = vector_centred(D,center_mid);
-    double a_df;
-    if(vectors_ang_clockwise(uX,cD_mid,&a_df) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute alpha DF");
-        exit(1);
-    }
+    const struct system_n_levels_kernels *kernels = system_n_levels_kernels(&sys);
+    gsl_multiroot_fdfsolver *s = gsl_multiroot_fdfsolver_alloc(gsl_multiroot_fdfsolver_hybridsj,sys.n_eq);
 
-    double a_fe = a_df+params->phi_df_0;
-    double a_ec = a_fe+params->phi_fe_0;
+    gsl_multiroot_function_fdf fdf;
+    fdf.f = kernels->f;
+    fdf.df = kernels->df;
+    fdf.fdf = kernels->fdf;
+    fdf.n = sys.n_eq;
+    fdf.params = &sys;
 
-    gsl_vector *F = gsl_vector_alloc(2);
-    if(point_from_alpha(a_fe,params->r_mid_0,center_mid,F) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute point F");
-        exit(1);
-    }
+    gsl_multiroot_fdfsolver_set(s,&fdf,x0);
 
-    gsl_vector *E = gsl_vector_alloc(2);
-    if(point_from_alpha(a_ec,params->r_mid_0,center_mid,E) != GSL_SUCCESS)
+    size_t max_iters = 100;
+    size_t iter = 0;
+    double eps = 1e-7;
+    int status;
+    do
     {
-        fprintf(stderr,"Failed to compute point E");
-        exit(1);
-    }
+        status = gsl_multiroot_fdfsolver_iterate(s);
+        if(status)
+            break;
+        
+        status = gsl_multiroot_test_residual(s->f,eps);
+        ++iter;
+    } while(status == GSL_CONTINUE && iter < max_iters);
 
-    gsl_vector *cE_mid = vector_centred(E,center_mid);
-    gsl_vector *cC_mid = vector_centred(C,center_mid);
-    double phi_ec;
-    if(vectors_ang_clockwise(cE_mid,cC_mid,&phi_ec) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute phi EC");
-        exit(1);
-    }
+    __system_3_levels_write_table("3_levels.cwt",&sys,s->x);
 
-    gsl_vector *center_bot = gsl_vector_alloc(2);
-    if(center_from_points_and_radius(E,F,params->r_bot_0,center_bot) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute bottom level center point\n");
-        exit(1);
-    }
+    gsl_multiroot_fdfsolver_free(s);
+    gsl_vector_free(x0);
 
-    gsl_vector *G = gsl_vector_alloc(2);
-    gsl_vector_set(G,0,gsl_vector_get(center_bot,0));
-    gsl_vector_set(G,1,gsl_vector_get(center_bot,1)-params->r_bot_0);
-    // gsl_vector_fprintf(stderr,E,"%g");
+    return GSL_SUCCESS;
+}
 
-    gsl_vector *cG = vector_centred(G,center_bot);
-    gsl_vector *cF_bot = vector_centred(F,center_bot);
-    gsl_vector *cE_bot = vector_centred(E,center_bot);
 
-    double phi_gf;
-    if(vectors_ang_clockwise(cF_bot,cG,&phi_gf) != GSL_SUCCESS)
-    {
-        fprintf(stderr,"Failed to compute phi GF\n");
-        exit(1);
-    }
+struct __system_3_levels_model
+{
+    enum system_n_levels_pressure_law law;
+    enum solver_backend backend;    // of the one-shot evals
+};
+
+static const struct __system_3_levels_model __system_3_levels_isothermal = {
+    SYSTEM_N_LEVELS_ISOTHERMAL,
+    SOLVER_BACKEND_SPARSE_NEWTON
+};
+
+// Cold starts of the adiabatic model converge far less often without the
+// damping of the fixed backend, it stays the default
+static const struct __system_3_levels_model __system_3_levels_adiabatic = {
+    SYSTEM_N_LEVELS_ADIABATIC,
+    SOLVER_BACKEND_FIXED_NEWTON
+};
+
+
+enum solver_backend system_3_levels_default_backend(bool adiabatic)
+{
+    return adiabatic ? __system_3_levels_adiabatic.backend : __system_3_levels_isothermal.backend;
+}
+
+
+// Every backend solves the stack, the context only translates results
+struct system_3_levels_ctx
+{
+    struct system_n_levels_ctx *stack;
+};
 
-    double phi_ge;
-    if(vectors_ang_clockwise(cG,cE_bot,&phi_ge) != GSL_SUCCESS)
+
+struct system_3_levels_ctx *system_3_levels_ctx_alloc(enum solver_backend backend)
+{
+    struct system_3_levels_ctx *ctx = calloc(1,sizeof(struct system_3_levels_ctx));
+    if(!ctx)
+        return NULL;
+
+    ctx->stack = system_n_levels_ctx_alloc(backend);
+    if(!ctx->stack)
     {
-        fprintf(stderr,"Failed to compute phi GE\n");
-        exit(1);
+        system_3_levels_ctx_free(ctx);
+        return NULL;
     }
 
-    params->phi_cb_0 = phi_cb;
-    params->phi_ec_0 = phi_ec;
-    params->phi_ge_0 = phi_ge;
-    params->phi_gf_0 = phi_gf;
-
-    double x_center_top = gsl_vector_get(center_top,0);
-    double y_center_top = gsl_vector_get(center_top,1);
-    double x_center_mid = gsl_vector_get(center_mid,0);
-    double y_center_mid = gsl_vector_get(center_mid,1);
-    double x_center_bot = gsl_vector_get(center_bot,0);
-    double y_center_bot = gsl_vector_get(center_bot,1);
-
-    gsl_vector_set(x0,0,params->phi_ad_0);
-    gsl_vector_set(x0,1,params->r_top_0);
-    gsl_vector_set(x0,2,x_center_top);
-    gsl_vector_set(x0,3,y_center_top);
-    gsl_vector_set(x0,4,a_ad);
-    gsl_vector_set(x0,5,phi_cb);
-    gsl_vector_set(x0,6,params->r_top_0);
-    gsl_vector_set(x0,7,x_center_top);
-    gsl_vector_set(x0,8,y_center_top);
-    gsl_vector_set(x0,9,a_cb);
-    gsl_vector_set(x0,10,params->phi_dc_0);
-    gsl_vector_set(x0,11,params->r_top_0);
-    gsl_vector_set(x0,12,x_center_top);
-    gsl_vector_set(x0,13,y_center_top);
-    gsl_vector_set(x0,14,a_dc);
-    gsl_vector_set(x0,15,params->phi_df_0);
-    gsl_vector_set(x0,16,params->r_mid_0);
-    gsl_vector_set(x0,17,x_center_mid);
-    gsl_vector_set(x0,18,y_center_mid);
-    gsl_vector_set(x0,19,a_df);
-    gsl_vector_set(x0,20,phi_ec);
-    gsl_vector_set(x0,21,params->r_mid_0);
-    gsl_vector_set(x0,22,x_center_mid);
-    gsl_vector_set(x0,23,y_center_mid);
-    gsl_vector_set(x0,24,a_ec);
-    gsl_vector_set(x0,25,params->phi_fe_0);
-    gsl_vector_set(x0,26,params->r_mid_0);
-    gsl_vector_set(x0,27,x_center_mid);
-    gsl_vector_set(x0,28,y_center_mid);
-    gsl_vector_set(x0,29,a_fe);
-    gsl_vector_set(x0,30,phi_ge);
-    gsl_vector_set(x0,31,params->r_bot_0);
-    gsl_vector_set(x0,32,y_center_bot);
-    gsl_vector_set(x0,33,phi_gf);
-    gsl_vector_set(x0,34,params->r_bot_0);
-    gsl_vector_set(x0,35,y_center_bot);
-    gsl_vector_set(x0,36,x_center_bot);
-    gsl_vector_set(x0,37,params->p_top_0);
-    gsl_vector_set(x0,38,params->p_mid_0);
-    gsl_vector_set(x0,39,params->p_bot_0);
-
-    gsl_vector_free(cA);
-    gsl_vector_free(cB);
-    gsl_vector_free(cC_mid);
-    gsl_vector_free(cC_top);
-    gsl_vector_free(C);
-    gsl_vector_free(cD_mid);
-    gsl_vector_free(D);
-    gsl_vector_free(E);
-    gsl_vector_free(cE_mid);
-    gsl_vector_free(cE_bot);
-    gsl_vector_free(F);
-    gsl_vector_free(cF_bot);
-    gsl_vector_free(G);
-    gsl_vector_free(cG);
-    gsl_vector_free(uX);
-    gsl_vector_free(center_bot);
-    gsl_vector_free(center_mid);
-    gsl_vector_free(center_top);
-    gsl_vector_free(A);
-    gsl_vector_free(B);
+    return ctx;
+}
 
-    return GSL_SUCCESS;
+
+void system_3_levels_ctx_free(struct system_3_levels_ctx *ctx)
+{
+    if(!ctx)
+        return;
+    system_n_levels_ctx_free(ctx->stack);
+    free(ctx);
 }
 
 
-void system_3_levels_x_to_res(const gsl_vector *x, struct system_3_levels_result *result)
-{
-    result->phi_ad = gsl_vector_get(x,0);
-    result->r_ad = gsl_vector_get(x,1);
-    result->x_ad = gsl_vector_get(x,2);
-    result->y_ad = gsl_vector_get(x,3);
-    result->a_ad = gsl_vector_get(x,4);
-    result->phi_cb = gsl_vector_get(x,5);
-    result->r_cb = gsl_vector_get(x,6);
-    result->x_cb = gsl_vector_get(x,7);
-    result->y_cb = gsl_vector_get(x,8);
-    result->a_cb = gsl_vector_get(x,9);
-    result->phi_dc = gsl_vector_get(x,10);
-    result->r_dc = gsl_vector_get(x,11);
-    result->x_dc = gsl_vector_get(x,12);
-    result->y_dc = gsl_vector_get(x,13);
-    result->a_dc = gsl_vector_get(x,14);
-    result->phi_df = gsl_vector_get(x,15);
-    result->r_df = gsl_vector_get(x,16);
-    result->x_df = gsl_vector_get(x,17);
-    result->y_df = gsl_vector_get(x,18);
-    result->a_df = gsl_vector_get(x,19);
-    result->phi_ec = gsl_vector_get(x,20);
-    result->r_ec = gsl_vector_get(x,21);
-    result->x_ec = gsl_vector_get(x,22);
-    result->y_ec = gsl_vector_get(x,23);
-    result->a_ec = gsl_vector_get(x,24);
-    result->phi_fe = gsl_vector_get(x,25);
-    result->r_fe = gsl_vector_get(x,26);
-    result->x_fe = gsl_vector_get(x,27);
-    result->y_fe = gsl_vector_get(x,28);
-    result->a_fe = gsl_vector_get(x,29);
-    result->phi_ge = gsl_vector_get(x,30);
-    result->r_ge = gsl_vector_get(x,31);
-    result->y_ge = gsl_vector_get(x,32);
-    result->phi_gf = gsl_vector_get(x,33);
-    result->r_gf = gsl_vector_get(x,34);
-    result->y_gf = gsl_vector_get(x,35);
-    result->x_bot = gsl_vector_get(x,36);
-    result->p_top = gsl_vector_get(x,37);
-    result->p_mid = gsl_vector_get(x,38);
-    result->p_bot = gsl_vector_get(x,39);
+void system_3_levels_ctx_set_warm(struct system_3_levels_ctx *ctx, const struct system_3_levels_result *warm)
+{
+    struct system_n_levels_result stack_warm;
+    if(warm)
+        __system_3_levels_res_to_stack(warm,&stack_warm);
+    system_n_levels_ctx_set_warm(ctx->stack,warm ? &stack_warm : NULL);
 }
 
 
-int system_3_levels_eval_f()
+size_t system_3_levels_ctx_iterations(const struct system_3_levels_ctx *ctx)
 {
-    struct system_3_levels_user_params user_params;
-    struct system_3_levels_params params;
-    gsl_vector *x0 = gsl_vector_alloc(N_eq);
-    user_params.Ax = 0.482;
-    user_params.Ay = 1.8;
-    user_params.Bx = 0.78;
-    user_params.By = 1.25;
-    user_params.p_ac = 1500;
-    user_params.p_atm = 101325;
-    user_params.p_bot_0 = 6500;
-    user_params.p_mid_0 = 12000;
-    user_params.p_top_0 = 20000;
-    user_params.phi_ad_0 = 3.129;
-    user_params.phi_dc_0 = 1.162;
-    user_params.phi_df_0 = 1.8;
-    user_params.phi_fe_0 = 1.0;
-    user_params.r_bot_0 = 0.3;
-    user_params.r_mid_0 = 0.4;
-    user_params.r_top_0 = 0.5;
-    system_3_levels_compute_init_config(&user_params,x0,&params);
-
-    const gsl_multiroot_fdfsolver_type *T = gsl_multiroot_fdfsolver_newton;
-    gsl_multiroot_fdfsolver *s = gsl_multiroot_fdfsolver_alloc(T,N_eq);
+    return system_n_levels_ctx_iterations(ctx->stack);
+}
 
-    gsl_multiroot_function_fdf fdf;
-    fdf.f = system_3_levels_f;
-    fdf.df = system_3_levels_df;
-    fdf.fdf = system_3_levels_fdf;
-    fdf.n = N_eq;
-    fdf.params = &params;
 
-    FILE *f_diff = fopen("diff.txt","w");
-    print_J_diff(f_diff,x0,&params,fdf.f,fdf.df);
-    fclose(f_diff);
+void system_3_levels_ctx_set_stats(struct system_3_levels_ctx *ctx, struct solver_stats *stats)
+{
+    system_n_levels_ctx_set_stats(ctx->stack,stats);
+}
 
-    FILE *fx0 = fopen("3_levels_init.txt","w");
-    gsl_vector_fprintf(fx0,x0,"%g");
-    fclose(fx0);
 
-    gsl_multiroot_fdfsolver_set(s,&fdf,x0);
+void system_3_levels_ctx_set_cancel(struct system_3_levels_ctx *ctx, solver_cancel_t cancelled, void *data)
+{
+    system_n_levels_ctx_set_cancel(ctx->stack,cancelled,data);
+}
 
-    size_t max_iters = 100;
-    size_t iter = 0;
-    double eps = 1e-7;
-    int status;
-    do
-    {
-        status = gsl_multiroot_fdfsolver_iterate(s);
-        if(status)
-            break;
-        
-        status = gsl_multiroot_test_residual(s->f,eps);
-        ++iter;
-    } while(status == GSL_CONTINUE && iter < max_iters);
 
-    FILE *fx = fopen("3_levels.txt","w");
-    gsl_vector_fprintf(fx,s->x,"%g");
-    fclose(fx);
+int __system_3_levels_ctx_eval_general(struct system_3_levels_ctx *ctx, const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result, const struct __system_3_levels_model *model)
+{
+    struct system_n_levels_user_params stack_params;
+    struct system_n_levels_topology topo;
+    struct system_n_levels_result stack_result;
+    system_3_levels_stack_params(user_params,&stack_params);
+    int status = system_n_levels_stack(&stack_params,model->law,&topo);
+    if(status)
+        return status;
+
+    // Initial configuration is the result of a solve that fails to start
+    for(size_t i = 0; i < topo.n_arcs; ++i)
+        stack_result.arcs[i] = topo.arcs[i].s0;
+    for(size_t c = 0; c < topo.n_chambers; ++c)
+        stack_result.p[c] = topo.chambers[c].p_0;
+
+    status = system_n_levels_ctx_solve(ctx->stack,&topo,&stack_result);
+    __system_3_levels_res_from_stack(&stack_result,result);
+
+    return status;
+}
 
-    gsl_vector_free(x0);
-    gsl_multiroot_fdfsolver_free(s);
 
-    return GSL_SUCCESS;
+int system_3_levels_ctx_eval(struct system_3_levels_ctx *ctx, const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result)
+{
+    if(!ctx || !user_params || !result)
+        return -1;
+
+    return __system_3_levels_ctx_eval_general(ctx,user_params,result,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_ctx_adiabatic_eval(struct system_3_levels_ctx *ctx, const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result)
+{
+    if(!ctx || !user_params || !result)
+        return -1;
+
+    return __system_3_levels_ctx_eval_general(ctx,user_params,result,&__system_3_levels_adiabatic);
+}
+
+
+int __system_3_levels_eval_general(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result, enum solver_backend backend, struct solver_stats *stats, const struct __system_3_levels_model *model)
+{
+    struct system_3_levels_ctx *ctx = system_3_levels_ctx_alloc(backend);
+    if(!ctx)
+        return GSL_ENOMEM;
+
+    system_3_levels_ctx_set_warm(ctx,warm);
+    system_3_levels_ctx_set_stats(ctx,stats);
+    int status = __system_3_levels_ctx_eval_general(ctx,user_params,result,model);
+
+    system_3_levels_ctx_free(ctx);
+
+    return status;
 }
 
 
@@ -856,40 +419,219 @@ int system_3_levels_eval(const struct system_3_levels_user_params *user_params,
     if(!user_params || !result)
         return -1;
 
-    struct system_3_levels_params params;
-    gsl_vector *x0 = gsl_vector_alloc(N_eq);
-    system_3_levels_compute_init_config(user_params,x0,&params);
+    return __system_3_levels_eval_general(user_params,NULL,result,__system_3_levels_isothermal.backend,NULL,&__system_3_levels_isothermal);
+}
 
-    const gsl_multiroot_fdfsolver_type *T = gsl_multiroot_fdfsolver_newton;
-    gsl_multiroot_fdfsolver *s = gsl_multiroot_fdfsolver_alloc(T,N_eq);
 
-    gsl_multiroot_function_fdf fdf;
-    fdf.f = system_3_levels_f;
-    fdf.df = system_3_levels_df;
-    fdf.fdf = system_3_levels_fdf;
-    fdf.n = N_eq;
-    fdf.params = &params;
+int system_3_levels_adiabatic_eval(const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result)
+{
+    if(!user_params || !result)
+        return -1;
 
-    gsl_multiroot_fdfsolver_set(s,&fdf,x0);
+    return __system_3_levels_eval_general(user_params,NULL,result,__system_3_levels_adiabatic.backend,NULL,&__system_3_levels_adiabatic);
+}
 
-    size_t max_iters = 100;
-    size_t iter = 0;
-    double eps = 1e-7;
-    int status;
-    do
+
+int system_3_levels_eval_warm(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,__system_3_levels_isothermal.backend,NULL,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_adiabatic_eval_warm(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,__system_3_levels_adiabatic.backend,NULL,&__system_3_levels_adiabatic);
+}
+
+
+int system_3_levels_eval_backend(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result, enum solver_backend backend)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,backend,NULL,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_adiabatic_eval_backend(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result, enum solver_backend backend)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,backend,NULL,&__system_3_levels_adiabatic);
+}
+
+
+int system_3_levels_eval_stats(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result, enum solver_backend backend, struct solver_stats *stats)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,backend,stats,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_adiabatic_eval_stats(const struct system_3_levels_user_params *user_params, const struct system_3_levels_result *warm, struct system_3_levels_result *result, enum solver_backend backend, struct solver_stats *stats)
+{
+    if(!user_params || !result)
+        return -1;
+
+    return __system_3_levels_eval_general(user_params,warm,result,backend,stats,&__system_3_levels_adiabatic);
+}
+
+
+struct system_3_levels_batch_data
+{
+    const struct system_3_levels_user_params *in;
+    struct system_3_levels_result *out;
+    int *status;
+    struct solver_stats *stats;
+    const struct __system_3_levels_model *model;
+};
+
+
+void *__system_3_levels_batch_worker_alloc(void *data)
+{
+    struct system_3_levels_batch_data *batch = (struct system_3_levels_batch_data*)data;
+    return system_3_levels_ctx_alloc(batch->model->backend);
+}
+
+
+void __system_3_levels_batch_worker_free(void *worker, void *data)
+{
+    system_3_levels_ctx_free((struct system_3_levels_ctx*)worker);
+}
+
+
+void __system_3_levels_batch_item(size_t i, void *worker, void *data)
+{
+    struct system_3_levels_batch_data *batch = (struct system_3_levels_batch_data*)data;
+    struct system_3_levels_ctx *ctx = (struct system_3_levels_ctx*)worker;
+    system_3_levels_ctx_set_stats(ctx,batch->stats ? &batch->stats[i] : NULL);
+    int status = __system_3_levels_ctx_eval_general(ctx,&batch->in[i],&batch->out[i],batch->model);
+    if(batch->status)
+        batch->status[i] = status;
+}
+
+
+int __system_3_levels_eval_batch_general(const struct system_3_levels_user_params *in, size_t n, struct system_3_levels_result *out, int *status, struct solver_stats *stats, int nthreads, const struct __system_3_levels_model *model)
+{
+    if(!in || !out)
+        return -1;
+
+    struct system_3_levels_batch_data data;
+    data.in = in;
+    data.out = out;
+    data.status = status;
+    data.stats = stats;
+    data.model = model;
+
+    return batch_run(n,nthreads,__system_3_levels_batch_worker_alloc,__system_3_levels_batch_item,__system_3_levels_batch_worker_free,&data);
+}
+
+
+int system_3_levels_eval_batch(const struct system_3_levels_user_params *in, size_t n, struct system_3_levels_result *out, int *status, int nthreads)
+{
+    return __system_3_levels_eval_batch_general(in,n,out,status,NULL,nthreads,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_eval_batch_stats(const struct system_3_levels_user_params *in, size_t n, struct system_3_levels_result *out, int *status, struct solver_stats *stats, int nthreads)
+{
+    return __system_3_levels_eval_batch_general(in,n,out,status,stats,nthreads,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_adiabatic_eval_batch(const struct system_3_levels_user_params *in, size_t n, struct system_3_levels_result *out, int *status, int nthreads)
+{
+    return __system_3_levels_eval_batch_general(in,n,out,status,NULL,nthreads,&__system_3_levels_adiabatic);
+}
+
+
+int system_3_levels_adiabatic_eval_batch_stats(const struct system_3_levels_user_params *in, size_t n, struct system_3_levels_result *out, int *status, struct solver_stats *stats, int nthreads)
+{
+    return __system_3_levels_eval_batch_general(in,n,out,status,stats,nthreads,&__system_3_levels_adiabatic);
+}
+
+
+
+int __system_3_levels_continuation_general(const struct system_3_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_3_levels_branch *branch, const struct __system_3_levels_model *model)
+{
+    branch->n_points = 0;
+    branch->capacity = 0;
+    branch->lambda = NULL;
+    branch->iters = NULL;
+    branch->results = NULL;
+
+    size_t stack_offset = 0;
+    for(size_t i = 0; i < system_3_levels_user_params_n_fields; ++i)
+        if(system_3_levels_user_params_fields[i].offset == param_offset)
+            stack_offset = __system_3_levels_stack_offsets[i];
+    if(!stack_offset)
+        return -1;
+
+    struct system_n_levels_user_params stack_params;
+    struct system_n_levels_branch stack_branch = {0};
+    system_3_levels_stack_params(user_params,&stack_params);
+    int status = model->law == SYSTEM_N_LEVELS_ADIABATIC ?
+        system_n_levels_adiabatic_continuation(&stack_params,stack_offset,lambda_end,opts,&stack_branch) :
+        system_n_levels_continuation(&stack_params,stack_offset,lambda_end,opts,&stack_branch);
+
+    // Points up to a failure are kept, as the stack branch does
+    if(stack_branch.n_points)
     {
-        status = gsl_multiroot_fdfsolver_iterate(s);
-        if(status)
-            break;
-        
-        status = gsl_multiroot_test_residual(s->f,eps);
-        ++iter;
-    } while(status == GSL_CONTINUE && iter < max_iters);
+        branch->results = malloc(stack_branch.n_points*sizeof(struct system_3_levels_result));
+        if(branch->results)
+        {
+            for(size_t i = 0; i < stack_branch.n_points; ++i)
+                __system_3_levels_res_from_stack(&stack_branch.results[i],&branch->results[i]);
+            branch->n_points = branch->capacity = stack_branch.n_points;
+            branch->lambda = stack_branch.lambda;
+            branch->iters = stack_branch.iters;
+            stack_branch.lambda = NULL;
+            stack_branch.iters = NULL;
+        }
+        else
+            status = GSL_ENOMEM;
+    }
+    system_n_levels_branch_free(&stack_branch);
 
-    system_3_levels_x_to_res(s->x,result);
+    return status;
+}
 
-    gsl_vector_free(x0);
-    gsl_multiroot_fdfsolver_free(s);
 
-    return GSL_SUCCESS;
-}
\ No newline at end of file
+int system_3_levels_continuation(const struct system_3_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_3_levels_branch *branch)
+{
+    if(!user_params || !branch)
+        return -1;
+
+    return __system_3_levels_continuation_general(user_params,param_offset,lambda_end,opts,branch,&__system_3_levels_isothermal);
+}
+
+
+int system_3_levels_adiabatic_continuation(const struct system_3_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_3_levels_branch *branch)
+{
+    if(!user_params || !branch)
+        return -1;
+
+    return __system_3_levels_continuation_general(user_params,param_offset,lambda_end,opts,branch,&__system_3_levels_adiabatic);
+}
+
+
+void system_3_levels_branch_free(struct system_3_levels_branch *branch)
+{
+    free(branch->lambda);
+    free(branch->iters);
+    free(branch->results);
+    branch->lambda = NULL;
+    branch->iters = NULL;
+    branch->results = NULL;
+    branch->n_points = 0;
+    branch->capacity = 0;
+}
@@ -0,0 +1,278 @@
+#include <equations/atlas.h>
+#include <gsl/gsl_errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static const char __atlas_magic[8] = "CWATLAS";
+
+
+struct atlas
+{
+    void *map;
+    size_t map_size;
+    const struct atlas_header *header;
+    const double *base;
+    const float *values;
+    size_t strides[ATLAS_MAX_AXES];
+};
+
+
+static size_t __atlas_size(const struct atlas_header *header)
+{
+    return sizeof(struct atlas_header) + header->n_params*sizeof(double) + header->n_points*header->n_results*sizeof(float);
+}
+
+
+static int __atlas_check(const struct atlas_header *header)
+{
+    if(header->n_axes == 0 || header->n_axes > ATLAS_MAX_AXES || header->n_params == 0 || header->n_results == 0)
+        return GSL_EINVAL;
+
+    // The grid must hold every point and the file size must fit a size_t
+    uint64_t n_points = 1;
+    for(size_t a = 0; a < header->n_axes; ++a)
+    {
+        const struct atlas_axis *axis = &header->axes[a];
+        if(axis->param >= header->n_params || axis->n < 2 || !(axis->hi > axis->lo))
+            return GSL_EINVAL;
+        if(n_points > UINT64_MAX/axis->n)
+            return GSL_EINVAL;
+        n_points *= axis->n;
+    }
+    if(n_points != header->n_points)
+        return GSL_EINVAL;
+
+    const size_t head = sizeof(struct atlas_header) + (size_t)header->n_params*sizeof(double);
+    if(n_points > (SIZE_MAX - head)/((size_t)header->n_results*sizeof(float)))
+        return GSL_EINVAL;
+
+    return GSL_SUCCESS;
+}
+
+
+int atlas_write(const char *path, struct atlas_header *header, const double *base, const float *values)
+{
+    if(!path || !header || !base || !values)
+        return -1;
+
+    memcpy(header->magic,__atlas_magic,sizeof(header->magic));
+    header->version = ATLAS_VERSION;
+    header->n_points = 1;
+    for(size_t a = 0; a < header->n_axes && a < ATLAS_MAX_AXES; ++a)
+        header->n_points *= header->axes[a].n;
+    if(__atlas_check(header))
+        return GSL_EINVAL;
+
+    FILE *out = fopen(path,"wb");
+    if(!out)
+        return GSL_EFAILED;
+
+    bool ok = fwrite(header,sizeof(struct atlas_header),1,out) == 1;
+    ok = ok && fwrite(base,sizeof(double),header->n_params,out) == header->n_params;
+    ok = ok && fwrite(values,sizeof(float)*header->n_results,header->n_points,out) == header->n_points;
+    ok = (fclose(out) == 0) && ok;
+
+    return ok ? GSL_SUCCESS : GSL_EFAILED;
+}
+
+
+struct atlas *atlas_open(const char *path)
+{
+    if(!path)
+        return NULL;
+
+    int fd = open(path,O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if(!fstat(fd,&st) && (size_t)st.st_size >= sizeof(struct atlas_header))
+        map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    const struct atlas_header *header = (const struct atlas_header*)map;
+    struct atlas *atlas = NULL;
+    if(!memcmp(header->magic,__atlas_magic,sizeof(header->magic)) && header->version == ATLAS_VERSION &&
+       !__atlas_check(header) && __atlas_size(header) == (size_t)st.st_size)
+        atlas = malloc(sizeof(struct atlas));
+    if(!atlas)
+    {
+        munmap(map,st.st_size);
+        return NULL;
+    }
+
+    atlas->map = map;
+    atlas->map_size = st.st_size;
+    atlas->header = header;
+    atlas->base = (const double*)(header + 1);
+    atlas->values = (const float*)(atlas->base + header->n_params);
+
+    size_t stride = header->n_results;
+    for(size_t a = header->n_axes; a-- > 0;)
+    {
+        atlas->strides[a] = stride;
+        stride *= header->axes[a].n;
+    }
+
+    return atlas;
+}
+
+
+void atlas_close(struct atlas *atlas)
+{
+    if(!atlas)
+        return;
+
+    munmap(atlas->map,atlas->map_size);
+    free(atlas);
+}
+
+
+const struct atlas_header *atlas_get_header(const struct atlas *atlas)
+{
+    return atlas ? atlas->header : NULL;
+}
+
+
+const double *atlas_get_base(const struct atlas *atlas)
+{
+    return atlas ? atlas->base : NULL;
+}
+
+
+int atlas_lookup(const struct atlas *atlas, const double *user_params, double *result)
+{
+    if(!atlas || !user_params || !result)
+        return -1;
+
+    const struct atlas_header *header = atlas->header;
+    const size_t n_axes = header->n_axes;
+
+    // Everything off the axes must match the configuration of the atlas
+    bool on_axis[header->n_params];
+    memset(on_axis,0,sizeof(on_axis));
+    for(size_t a = 0; a < n_axes; ++a)
+        on_axis[header->axes[a].param] = true;
+    for(size_t i = 0; i < header->n_params; ++i)
+        if(!on_axis[i] && fabs(user_params[i] - atlas->base[i]) > 1e-9*fmax(1,fabs(atlas->base[i])))
+            return GSL_EDOM;
+
+    size_t cell = 0;
+    double frac[ATLAS_MAX_AXES];
+    for(size_t a = 0; a < n_axes; ++a)
+    {
+        const struct atlas_axis *axis = &header->axes[a];
+        const double t = (user_params[axis->param] - axis->lo)/(axis->hi - axis->lo)*(axis->n - 1);
+        if(!(t >= -1e-9 && t <= axis->n - 1 + 1e-9))
+            return GSL_EDOM;
+        size_t i = t <= 0 ? 0 : (size_t)t;
+        if(i > axis->n - 2)
+            i = axis->n - 2;
+        frac[a] = fmin(fmax(t - i,0),1);
+        cell += i*atlas->strides[a];
+    }
+
+    for(size_t r = 0; r < header->n_results; ++r)
+        result[r] = 0;
+
+    double w_sum = 0;
+    for(size_t corner = 0; corner < ((size_t)1 << n_axes); ++corner)
+    {
+        double w = 1;
+        size_t offset = cell;
+        for(size_t a = 0; a < n_axes; ++a)
+        {
+            if(corner & ((size_t)1 << a))
+            {
+                w *= frac[a];
+                offset += atlas->strides[a];
+            }
+            else
+                w *= 1 - frac[a];
+        }
+        const float *v = atlas->values + offset;
+        if(w == 0 || isnan(v[0]))
+            continue;
+
+        w_sum += w;
+        for(size_t r = 0; r < header->n_results; ++r)
+            result[r] += w*v[r];
+    }
+    if(w_sum < 1e-6)
+        return GSL_EDOM;
+
+    for(size_t r = 0; r < header->n_results; ++r)
+        result[r] /= w_sum;
+
+    return GSL_SUCCESS;
+}
+
+
+static int __atlas_model_lookup(const struct atlas *atlas, size_t n_levels, size_t params_size, size_t result_size,
+                                const void *user_params, bool adiabatic, void *result)
+{
+    if(!atlas || !user_params || !result)
+        return -1;
+
+    const struct atlas_header *header = atlas->header;
+    if(header->n_levels != n_levels || (bool)header->adiabatic != adiabatic ||
+       header->n_params*sizeof(double) != params_size || header->n_results*sizeof(double) != result_size)
+        return GSL_EINVAL;
+
+    return atlas_lookup(atlas,user_params,result);
+}
+
+
+int system_2_levels_atlas_lookup(const struct atlas *atlas, const struct system_2_levels_user_params *user_params, bool adiabatic, struct system_2_levels_result *result)
+{
+    return __atlas_model_lookup(atlas,2,sizeof(struct system_2_levels_user_params),sizeof(struct system_2_levels_result),
+                                user_params,adiabatic,result);
+}
+
+
+int system_3_levels_atlas_lookup(const struct atlas *atlas, const struct system_3_levels_user_params *user_params, bool adiabatic, struct system_3_levels_result *result)
+{
+    return __atlas_model_lookup(atlas,3,sizeof(struct system_3_levels_user_params),sizeof(struct system_3_levels_result),
+                                user_params,adiabatic,result);
+}
+
+
+int system_2_levels_atlas_eval(const struct atlas *atlas, struct system_2_levels_ctx *ctx, const struct system_2_levels_user_params *user_params, bool adiabatic, struct system_2_levels_result *result)
+{
+    if(!ctx || !user_params || !result)
+        return -1;
+
+    struct system_2_levels_result warm;
+    if(system_2_levels_atlas_lookup(atlas,user_params,adiabatic,&warm) == GSL_SUCCESS)
+        system_2_levels_ctx_set_warm(ctx,&warm);
+
+    if(adiabatic)
+        return system_2_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_2_levels_ctx_eval(ctx,user_params,result);
+}
+
+
+int system_3_levels_atlas_eval(const struct atlas *atlas, struct system_3_levels_ctx *ctx, const struct system_3_levels_user_params *user_params, bool adiabatic, struct system_3_levels_result *result)
+{
+    if(!ctx || !user_params || !result)
+        return -1;
+
+    struct system_3_levels_result warm;
+    if(system_3_levels_atlas_lookup(atlas,user_params,adiabatic,&warm) == GSL_SUCCESS)
+        system_3_levels_ctx_set_warm(ctx,&warm);
+
+    if(adiabatic)
+        return system_3_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_3_levels_ctx_eval(ctx,user_params,result);
+}
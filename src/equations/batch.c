@@ -0,0 +1,212 @@
+#include <equations/batch.h>
+#include <gsl/gsl_errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+struct batch_range
+{
+    pthread_mutex_t lock;
+    size_t begin, end;
+};
+
+
+struct batch_pool
+{
+    size_t n_workers;
+    struct batch_range *ranges;
+
+    batch_worker_alloc_t worker_alloc;
+    batch_item_t item;
+    batch_worker_free_t worker_free;
+    void *data;
+
+    pthread_mutex_t status_lock;
+    int status;
+};
+
+
+struct batch_worker_arg
+{
+    struct batch_pool *pool;
+    size_t id;
+};
+
+
+int batch_default_threads()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+
+static bool __batch_pop(struct batch_range *range, size_t *i)
+{
+    bool found = false;
+    pthread_mutex_lock(&range->lock);
+    if(range->begin < range->end)
+    {
+        *i = range->begin++;
+        found = true;
+    }
+    pthread_mutex_unlock(&range->lock);
+
+    return found;
+}
+
+
+// Moves the upper half of the fullest other range into the thief's own
+static bool __batch_steal(struct batch_pool *pool, size_t thief)
+{
+    while(true)
+    {
+        size_t victim = thief;
+        size_t victim_size = 0;
+        for(size_t w = 0; w < pool->n_workers; ++w)
+        {
+            if(w == thief)
+                continue;
+            struct batch_range *r = &pool->ranges[w];
+            pthread_mutex_lock(&r->lock);
+            size_t size = r->end - r->begin;
+            pthread_mutex_unlock(&r->lock);
+            if(size > victim_size)
+            {
+                victim = w;
+                victim_size = size;
+            }
+        }
+        if(victim_size == 0)
+            return false;
+
+        struct batch_range *v = &pool->ranges[victim];
+        size_t begin = 0, end = 0;
+        pthread_mutex_lock(&v->lock);
+        size_t size = v->end - v->begin;
+        if(size > 0)
+        {
+            size_t take = (size + 1)/2;
+            end = v->end;
+            begin = end - take;
+            v->end = begin;
+        }
+        pthread_mutex_unlock(&v->lock);
+
+        // Victim may have drained its range meanwhile, look again
+        if(begin == end)
+            continue;
+
+        struct batch_range *own = &pool->ranges[thief];
+        pthread_mutex_lock(&own->lock);
+        own->begin = begin;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+
+        return true;
+    }
+}
+
+
+static void *__batch_worker(void *p)
+{
+    struct batch_worker_arg *arg = (struct batch_worker_arg*)p;
+    struct batch_pool *pool = arg->pool;
+
+    void *worker = NULL;
+    if(pool->worker_alloc)
+    {
+        worker = pool->worker_alloc(pool->data);
+        if(!worker)
+        {
+            pthread_mutex_lock(&pool->status_lock);
+            pool->status = GSL_ENOMEM;
+            pthread_mutex_unlock(&pool->status_lock);
+            // Leave own slice to the others
+            return NULL;
+        }
+    }
+
+    size_t i;
+    do
+    {
+        while(__batch_pop(&pool->ranges[arg->id],&i))
+            pool->item(i,worker,pool->data);
+    } while(__batch_steal(pool,arg->id));
+
+    if(pool->worker_free)
+        pool->worker_free(worker,pool->data);
+
+    return NULL;
+}
+
+
+int batch_run(size_t n, int nthreads, batch_worker_alloc_t worker_alloc, batch_item_t item, batch_worker_free_t worker_free, void *data)
+{
+    if(!item)
+        return -1;
+    if(n == 0)
+        return GSL_SUCCESS;
+
+    size_t n_workers = nthreads > 0 ? (size_t)nthreads : (size_t)batch_default_threads();
+    if(n_workers > n)
+        n_workers = n;
+
+    struct batch_pool pool;
+    pool.n_workers = n_workers;
+    pool.worker_alloc = worker_alloc;
+    pool.item = item;
+    pool.worker_free = worker_free;
+    pool.data = data;
+    pool.status = GSL_SUCCESS;
+    pool.ranges = malloc(n_workers*sizeof(struct batch_range));
+    pthread_t *threads = malloc(n_workers*sizeof(pthread_t));
+    struct batch_worker_arg *args = malloc(n_workers*sizeof(struct batch_worker_arg));
+    if(!pool.ranges || !threads || !args)
+    {
+        free(pool.ranges);
+        free(threads);
+        free(args);
+        return GSL_ENOMEM;
+    }
+    pthread_mutex_init(&pool.status_lock,NULL);
+
+    for(size_t w = 0; w < n_workers; ++w)
+    {
+        pthread_mutex_init(&pool.ranges[w].lock,NULL);
+        pool.ranges[w].begin = n*w/n_workers;
+        pool.ranges[w].end = n*(w+1)/n_workers;
+        args[w].pool = &pool;
+        args[w].id = w;
+    }
+
+    // Calling thread is worker 0
+    size_t started = 1;
+    for(size_t w = 1; w < n_workers; ++w)
+    {
+        if(pthread_create(&threads[w],NULL,__batch_worker,&args[w]))
+            break;
+        ++started;
+    }
+    __batch_worker(&args[0]);
+    for(size_t w = 1; w < started; ++w)
+        pthread_join(threads[w],NULL);
+
+    // Slices of workers that failed to start or to allocate are picked up
+    // by stealing, leftovers mean that nobody was able to work at all
+    int status = GSL_SUCCESS;
+    for(size_t w = 0; w < n_workers; ++w)
+    {
+        if(pool.ranges[w].begin < pool.ranges[w].end)
+            status = pool.status != GSL_SUCCESS ? pool.status : GSL_EFAILED;
+        pthread_mutex_destroy(&pool.ranges[w].lock);
+    }
+
+    pthread_mutex_destroy(&pool.status_lock);
+    free(args);
+    free(threads);
+    free(pool.ranges);
+
+    return status;
+}
@@ -0,0 +1,304 @@
+#include <equations/cache.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CACHE_NONE ((size_t)-1)
+
+
+// Entries live in one array and are linked by index, both into the chains
+// of the hash buckets and into the recency list (head is the newest)
+struct result_cache_entry
+{
+    size_t next_in_bucket;
+    size_t prev, next;
+    uint64_t hash;
+    int tag;
+};
+
+
+struct result_cache
+{
+    pthread_mutex_t lock;
+
+    size_t capacity, n_key, value_size;
+    double quantum;
+
+    size_t n_buckets;
+    size_t *buckets;
+    struct result_cache_entry *entries;
+    double *keys;
+    unsigned char *values;
+    size_t size;
+    size_t head, tail;
+
+    size_t hits, misses;
+    size_t insertions, evictions;
+};
+
+
+// Rounds the mantissa to a multiple of quantum, -0 and 0 become the same key
+static double __cache_quantise(double x, double quantum)
+{
+    if(x == 0)
+        return 0;
+    if(quantum <= 0 || !isfinite(x))
+        return x;
+
+    int e;
+    double m = frexp(x,&e);
+    return ldexp(round(m/quantum)*quantum,e);
+}
+
+
+// FNV-1a over the quantised key and the tag
+static uint64_t __cache_hash(const double *key, size_t n_key, int tag)
+{
+    uint64_t h = 1469598103934665603ULL;
+    const unsigned char *bytes = (const unsigned char*)key;
+    for(size_t i = 0; i < n_key*sizeof(double); ++i)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= (uint64_t)(unsigned)tag;
+    h *= 1099511628211ULL;
+
+    return h;
+}
+
+
+struct result_cache *result_cache_alloc(size_t capacity, size_t n_key, size_t value_size, double quantum)
+{
+    if(capacity == 0 || n_key == 0)
+        return NULL;
+
+    struct result_cache *cache = calloc(1,sizeof(struct result_cache));
+    if(!cache)
+        return NULL;
+
+    cache->capacity = capacity;
+    cache->n_key = n_key;
+    cache->value_size = value_size;
+    cache->quantum = quantum;
+
+    // Power of two and at least twice the capacity keeps the chains short
+    cache->n_buckets = 1;
+    while(cache->n_buckets < 2*capacity)
+        cache->n_buckets *= 2;
+
+    cache->buckets = malloc(cache->n_buckets*sizeof(size_t));
+    cache->entries = malloc(capacity*sizeof(struct result_cache_entry));
+    cache->keys = malloc(capacity*n_key*sizeof(double));
+    cache->values = malloc(capacity*value_size + 1);
+    if(!cache->buckets || !cache->entries || !cache->keys || !cache->values)
+    {
+        result_cache_free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock,NULL);
+    result_cache_clear(cache);
+
+    return cache;
+}
+
+
+void result_cache_free(struct result_cache *cache)
+{
+    if(!cache)
+        return;
+
+    if(cache->buckets && cache->entries && cache->keys && cache->values)
+        pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->entries);
+    free(cache->keys);
+    free(cache->values);
+    free(cache);
+}
+
+
+void result_cache_clear(struct result_cache *cache)
+{
+    if(!cache)
+        return;
+
+    pthread_mutex_lock(&cache->lock);
+    for(size_t b = 0; b < cache->n_buckets; ++b)
+        cache->buckets[b] = CACHE_NONE;
+    cache->size = 0;
+    cache->head = cache->tail = CACHE_NONE;
+    cache->hits = cache->misses = 0;
+    cache->insertions = cache->evictions = 0;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+static void __cache_unlink(struct result_cache *cache, size_t i)
+{
+    struct result_cache_entry *e = &cache->entries[i];
+    if(e->prev != CACHE_NONE)
+        cache->entries[e->prev].next = e->next;
+    else
+        cache->head = e->next;
+    if(e->next != CACHE_NONE)
+        cache->entries[e->next].prev = e->prev;
+    else
+        cache->tail = e->prev;
+}
+
+
+static void __cache_push_front(struct result_cache *cache, size_t i)
+{
+    struct result_cache_entry *e = &cache->entries[i];
+    e->prev = CACHE_NONE;
+    e->next = cache->head;
+    if(cache->head != CACHE_NONE)
+        cache->entries[cache->head].prev = i;
+    cache->head = i;
+    if(cache->tail == CACHE_NONE)
+        cache->tail = i;
+}
+
+
+static void __cache_remove_from_bucket(struct result_cache *cache, size_t i)
+{
+    size_t *link = &cache->buckets[cache->entries[i].hash & (cache->n_buckets - 1)];
+    while(*link != i)
+        link = &cache->entries[*link].next_in_bucket;
+    *link = cache->entries[i].next_in_bucket;
+}
+
+
+static size_t __cache_find(struct result_cache *cache, const double *key_q, uint64_t hash, int tag)
+{
+    size_t i = cache->buckets[hash & (cache->n_buckets - 1)];
+    while(i != CACHE_NONE)
+    {
+        const struct result_cache_entry *e = &cache->entries[i];
+        if(e->hash == hash && e->tag == tag && !memcmp(&cache->keys[i*cache->n_key],key_q,cache->n_key*sizeof(double)))
+            return i;
+        i = e->next_in_bucket;
+    }
+
+    return CACHE_NONE;
+}
+
+
+bool result_cache_lookup(struct result_cache *cache, const double *key, int tag, void *value)
+{
+    if(!cache || !key)
+        return false;
+
+    double key_q[cache->n_key];
+    for(size_t k = 0; k < cache->n_key; ++k)
+        key_q[k] = __cache_quantise(key[k],cache->quantum);
+    const uint64_t hash = __cache_hash(key_q,cache->n_key,tag);
+
+    pthread_mutex_lock(&cache->lock);
+    size_t i = __cache_find(cache,key_q,hash,tag);
+    if(i != CACHE_NONE)
+    {
+        if(value)
+            memcpy(value,&cache->values[i*cache->value_size],cache->value_size);
+        __cache_unlink(cache,i);
+        __cache_push_front(cache,i);
+        ++cache->hits;
+    }
+    else
+        ++cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+
+    return i != CACHE_NONE;
+}
+
+
+bool result_cache_contains(struct result_cache *cache, const double *key, int tag)
+{
+    if(!cache || !key)
+        return false;
+
+    double key_q[cache->n_key];
+    for(size_t k = 0; k < cache->n_key; ++k)
+        key_q[k] = __cache_quantise(key[k],cache->quantum);
+    const uint64_t hash = __cache_hash(key_q,cache->n_key,tag);
+
+    pthread_mutex_lock(&cache->lock);
+    const bool found = __cache_find(cache,key_q,hash,tag) != CACHE_NONE;
+    pthread_mutex_unlock(&cache->lock);
+
+    return found;
+}
+
+
+void result_cache_insert(struct result_cache *cache, const double *key, int tag, const void *value)
+{
+    if(!cache || !key || !value)
+        return;
+
+    double key_q[cache->n_key];
+    for(size_t k = 0; k < cache->n_key; ++k)
+        key_q[k] = __cache_quantise(key[k],cache->quantum);
+    const uint64_t hash = __cache_hash(key_q,cache->n_key,tag);
+
+    pthread_mutex_lock(&cache->lock);
+    size_t i = __cache_find(cache,key_q,hash,tag);
+    if(i != CACHE_NONE)
+        __cache_unlink(cache,i);
+    else
+    {
+        if(cache->size < cache->capacity)
+            i = cache->size++;
+        else
+        {
+            i = cache->tail;
+            __cache_unlink(cache,i);
+            __cache_remove_from_bucket(cache,i);
+            ++cache->evictions;
+        }
+
+        struct result_cache_entry *e = &cache->entries[i];
+        e->hash = hash;
+        e->tag = tag;
+        size_t *bucket = &cache->buckets[hash & (cache->n_buckets - 1)];
+        e->next_in_bucket = *bucket;
+        *bucket = i;
+        memcpy(&cache->keys[i*cache->n_key],key_q,cache->n_key*sizeof(double));
+        ++cache->insertions;
+    }
+    memcpy(&cache->values[i*cache->value_size],value,cache->value_size);
+    __cache_push_front(cache,i);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+void result_cache_get_stats(struct result_cache *cache, struct result_cache_stats *stats)
+{
+    if(!cache || !stats)
+        return;
+
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->insertions = cache->insertions;
+    stats->evictions = cache->evictions;
+    stats->size = cache->size;
+    stats->capacity = cache->capacity;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+double result_cache_hit_rate(struct result_cache *cache)
+{
+    struct result_cache_stats stats;
+    if(!cache)
+        return 0;
+
+    result_cache_get_stats(cache,&stats);
+    const size_t lookups = stats.hits + stats.misses;
+
+    return lookups ? (double)stats.hits/lookups : 0;
+}
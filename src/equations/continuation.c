@@ -0,0 +1,280 @@
+#include <equations/continuation.h>
+#include <gsl/gsl_multiroots.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_math.h>
+#include <math.h>
+#include <stdbool.h>
+
+
+// Branch is traced in (z, mu) space: z = w*x with w chosen so that every unknown
+// is O(1), and mu in [0,1] maps linearly onto [lambda_start, lambda_end]
+struct continuation_workspace
+{
+    const struct continuation_problem *problem;
+    size_t n;
+
+    gsl_vector *w;
+    gsl_vector *f;
+    gsl_vector *f_h;
+    gsl_vector *f_mu;
+    gsl_matrix *J;
+
+    gsl_matrix *A;
+    gsl_permutation *perm;
+    gsl_vector *rhs;
+    gsl_vector *dy;
+};
+
+
+void continuation_default_options(struct continuation_options *opts)
+{
+    opts->ds_init = 0.05;
+    opts->ds_min = 1e-6;
+    opts->ds_max = 0.25;
+    opts->max_points = 10000;
+    opts->max_corrector_iters = 10;
+    opts->eps = 1e-7;
+}
+
+
+static void __continuation_set_mu(struct continuation_workspace *ws, double mu)
+{
+    const struct continuation_problem *problem = ws->problem;
+    double lambda = problem->lambda_start + mu*(problem->lambda_end - problem->lambda_start);
+    problem->set_lambda(lambda,problem->lambda_data);
+}
+
+
+static void __continuation_eval(struct continuation_workspace *ws, const gsl_vector *x, double mu)
+{
+    const struct continuation_problem *problem = ws->problem;
+    const double h = 1e-7;
+
+    __continuation_set_mu(ws,mu+h);
+    problem->f(x,problem->params,ws->f_h);
+
+    __continuation_set_mu(ws,mu);
+    problem->f(x,problem->params,ws->f);
+    problem->df(x,problem->params,ws->J);
+
+    gsl_vector_memcpy(ws->f_mu,ws->f_h);
+    gsl_vector_sub(ws->f_mu,ws->f);
+    gsl_vector_scale(ws->f_mu,1.0/h);
+}
+
+
+// Augmented matrix [J/w F_mu; row] for the current point, factorised in place
+static int __continuation_factorize(struct continuation_workspace *ws, const gsl_vector *row)
+{
+    size_t n = ws->n;
+    for(size_t i = 0; i < n; ++i)
+    {
+        for(size_t j = 0; j < n; ++j)
+            gsl_matrix_set(ws->A,i,j,gsl_matrix_get(ws->J,i,j)/gsl_vector_get(ws->w,j));
+        gsl_matrix_set(ws->A,i,n,gsl_vector_get(ws->f_mu,i));
+    }
+    for(size_t j = 0; j < n+1; ++j)
+        gsl_matrix_set(ws->A,n,j,gsl_vector_get(row,j));
+
+    int signum;
+    int status = gsl_linalg_LU_decomp(ws->A,ws->perm,&signum);
+    if(status)
+        return status;
+
+    // LU_decomp succeeds on singular matrices, e.g. at a turning point
+    for(size_t i = 0; i < n+1; ++i)
+    {
+        double u = gsl_matrix_get(ws->A,i,i);
+        if(u == 0 || !gsl_finite(u))
+            return GSL_ESING;
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+static int __continuation_tangent(struct continuation_workspace *ws, const gsl_vector *x, double mu, const gsl_vector *t_prev, gsl_vector *t)
+{
+    __continuation_eval(ws,x,mu);
+    int status = __continuation_factorize(ws,t_prev);
+    if(status)
+        return status;
+
+    gsl_vector_set_zero(ws->rhs);
+    gsl_vector_set(ws->rhs,ws->n,1);
+    status = gsl_linalg_LU_solve(ws->A,ws->perm,ws->rhs,t);
+    if(status)
+        return status;
+
+    double norm = gsl_blas_dnrm2(t);
+    if(!gsl_finite(norm) || norm == 0)
+        return GSL_ESING;
+    gsl_vector_scale(t,1.0/norm);
+
+    return GSL_SUCCESS;
+}
+
+
+// Newton on [F(x,mu); row*(y - y_pred)] = 0 starting from the predicted point
+static int __continuation_correct(struct continuation_workspace *ws, gsl_vector *x, double *mu, const gsl_vector *row, size_t max_iters, double eps, size_t *iters)
+{
+    size_t n = ws->n;
+    for(size_t iter = 0; iter <= max_iters; ++iter)
+    {
+        __continuation_eval(ws,x,*mu);
+        if(!gsl_finite(gsl_blas_dnrm2(ws->f)))
+            return GSL_EBADFUNC;
+
+        if(gsl_multiroot_test_residual(ws->f,eps) == GSL_SUCCESS)
+        {
+            *iters = iter;
+            return GSL_SUCCESS;
+        }
+
+        if(iter == max_iters)
+            break;
+
+        if(__continuation_factorize(ws,row) != GSL_SUCCESS)
+            return GSL_ESING;
+        for(size_t i = 0; i < n; ++i)
+            gsl_vector_set(ws->rhs,i,-gsl_vector_get(ws->f,i));
+        gsl_vector_set(ws->rhs,n,0);
+        if(gsl_linalg_LU_solve(ws->A,ws->perm,ws->rhs,ws->dy) != GSL_SUCCESS)
+            return GSL_ESING;
+
+        for(size_t i = 0; i < n; ++i)
+            gsl_vector_set(x,i,gsl_vector_get(x,i) + gsl_vector_get(ws->dy,i)/gsl_vector_get(ws->w,i));
+        *mu += gsl_vector_get(ws->dy,n);
+    }
+
+    return GSL_EMAXITER;
+}
+
+
+int continuation_run(const struct continuation_problem *problem, const gsl_vector *x_start, const struct continuation_options *opts, continuation_emit_t emit, void *emit_data)
+{
+    struct continuation_options default_opts;
+    if(!opts)
+    {
+        continuation_default_options(&default_opts);
+        opts = &default_opts;
+    }
+
+    const size_t n = problem->n;
+    struct continuation_workspace ws;
+    ws.problem = problem;
+    ws.n = n;
+    ws.w = gsl_vector_alloc(n);
+    ws.f = gsl_vector_alloc(n);
+    ws.f_h = gsl_vector_alloc(n);
+    ws.f_mu = gsl_vector_alloc(n);
+    ws.J = gsl_matrix_alloc(n,n);
+    ws.A = gsl_matrix_alloc(n+1,n+1);
+    ws.perm = gsl_permutation_alloc(n+1);
+    ws.rhs = gsl_vector_alloc(n+1);
+    ws.dy = gsl_vector_alloc(n+1);
+
+    for(size_t i = 0; i < n; ++i)
+        gsl_vector_set(ws.w,i,1.0/GSL_MAX(1.0,fabs(gsl_vector_get(x_start,i))));
+
+    gsl_vector *x = gsl_vector_alloc(n);
+    gsl_vector *x_prev = gsl_vector_alloc(n);
+    gsl_vector *t = gsl_vector_alloc(n+1);
+    gsl_vector *t_new = gsl_vector_alloc(n+1);
+    gsl_vector *e_mu = gsl_vector_calloc(n+1);
+    gsl_vector_set(e_mu,n,1);
+
+    gsl_vector_memcpy(x,x_start);
+    double mu = 0;
+    gsl_vector_memcpy(t,e_mu);
+
+    int status = GSL_SUCCESS;
+    if((status = emit(x,problem->lambda_start,0,emit_data)))
+        goto cleanup;
+
+    double ds = opts->ds_init;
+    size_t points = 1;
+    while(true)
+    {
+        if(points >= opts->max_points)
+        {
+            status = GSL_EMAXITER;
+            break;
+        }
+
+        status = __continuation_tangent(&ws,x,mu,t,t_new);
+        if(status)
+            break;
+        gsl_vector_memcpy(t,t_new);
+
+        gsl_vector_memcpy(x_prev,x);
+        double mu_prev = mu;
+        size_t iters = 0;
+        while(true)
+        {
+            // Predictor along the tangent, then arclength-constrained corrector
+            for(size_t i = 0; i < n; ++i)
+                gsl_vector_set(x,i,gsl_vector_get(x_prev,i) + ds*gsl_vector_get(t,i)/gsl_vector_get(ws.w,i));
+            mu = mu_prev + ds*gsl_vector_get(t,n);
+
+            status = __continuation_correct(&ws,x,&mu,t,opts->max_corrector_iters,opts->eps,&iters);
+            if(status == GSL_SUCCESS)
+                break;
+
+            ds /= 2;
+            if(ds < opts->ds_min)
+            {
+                gsl_vector_memcpy(x,x_prev);
+                mu = mu_prev;
+                status = GSL_EFAILED;
+                goto cleanup;
+            }
+        }
+
+        if(iters <= 2)
+            ds = GSL_MIN(ds*1.5,opts->ds_max);
+        else if(iters >= opts->max_corrector_iters/2)
+            ds *= 0.7;
+
+        if(mu >= 1)
+        {
+            // Land exactly on lambda_end: interpolate between the last two points
+            // and correct with mu pinned
+            double frac = (1 - mu_prev)/(mu - mu_prev);
+            for(size_t i = 0; i < n; ++i)
+            {
+                double xi_prev = gsl_vector_get(x_prev,i);
+                gsl_vector_set(x,i,xi_prev + frac*(gsl_vector_get(x,i) - xi_prev));
+            }
+            mu = 1;
+            status = __continuation_correct(&ws,x,&mu,e_mu,opts->max_corrector_iters,opts->eps,&iters);
+            if(status == GSL_SUCCESS)
+                status = emit(x,problem->lambda_end,iters,emit_data);
+            break;
+        }
+
+        double lambda = problem->lambda_start + mu*(problem->lambda_end - problem->lambda_start);
+        ++points;
+        if((status = emit(x,lambda,iters,emit_data)))
+            break;
+    }
+
+cleanup:
+    gsl_vector_free(e_mu);
+    gsl_vector_free(t_new);
+    gsl_vector_free(t);
+    gsl_vector_free(x_prev);
+    gsl_vector_free(x);
+    gsl_vector_free(ws.dy);
+    gsl_vector_free(ws.rhs);
+    gsl_permutation_free(ws.perm);
+    gsl_matrix_free(ws.A);
+    gsl_matrix_free(ws.J);
+    gsl_vector_free(ws.f_mu);
+    gsl_vector_free(ws.f_h);
+    gsl_vector_free(ws.f);
+    gsl_vector_free(ws.w);
+
+    return status;
+}
@@ -0,0 +1,1345 @@
+#include <equations/n_levels.h>
+#include <equations/sparse.h>
+#include <equations/utils.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_multiroots.h>
+#include <gsl/gsl_sf_trig.h>
+#include <gsl/gsl_math.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Positions of the arc parameters in system_n_levels.idx
+enum { ARC_PHI, ARC_R, ARC_CX, ARC_CY, ARC_A };
+
+
+#define __SYSTEM_N_LEVELS_PARAMS_LEVEL(i) \
+    FIELD_DESC(struct system_n_levels_user_params,r_0[i]), \
+    FIELD_DESC(struct system_n_levels_user_params,p_0[i]), \
+    FIELD_DESC(struct system_n_levels_user_params,phi_left_0[i]), \
+    FIELD_DESC(struct system_n_levels_user_params,phi_membrane_0[i])
+
+// Angles of the bottom level are not used
+const struct field_desc system_n_levels_user_params_fields[] = {
+    FIELD_DESC(struct system_n_levels_user_params,Ax),
+    FIELD_DESC(struct system_n_levels_user_params,Ay),
+    FIELD_DESC(struct system_n_levels_user_params,Bx),
+    FIELD_DESC(struct system_n_levels_user_params,By),
+    FIELD_DESC(struct system_n_levels_user_params,p_atm),
+    FIELD_DESC(struct system_n_levels_user_params,p_ac),
+    FIELD_DESC(struct system_n_levels_user_params,k),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(0),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(1),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(2),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(3),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(4),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(5),
+    __SYSTEM_N_LEVELS_PARAMS_LEVEL(6),
+    FIELD_DESC(struct system_n_levels_user_params,r_0[7]),
+    FIELD_DESC(struct system_n_levels_user_params,p_0[7])
+};
+
+#define __SYSTEM_N_LEVELS_RESULT_ARC(i) \
+    FIELD_DESC(struct system_n_levels_result,arcs[i].phi), \
+    FIELD_DESC(struct system_n_levels_result,arcs[i].r), \
+    FIELD_DESC(struct system_n_levels_result,arcs[i].cx), \
+    FIELD_DESC(struct system_n_levels_result,arcs[i].cy), \
+    FIELD_DESC(struct system_n_levels_result,arcs[i].a)
+
+// Pressure, left and right walls and membrane of every level but the bottom
+// one, which has its halves only
+const struct field_desc system_n_levels_result_fields[] = {
+    FIELD_DESC(struct system_n_levels_result,p[0]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(0), __SYSTEM_N_LEVELS_RESULT_ARC(1), __SYSTEM_N_LEVELS_RESULT_ARC(2),
+    FIELD_DESC(struct system_n_levels_result,p[1]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(3), __SYSTEM_N_LEVELS_RESULT_ARC(4), __SYSTEM_N_LEVELS_RESULT_ARC(5),
+    FIELD_DESC(struct system_n_levels_result,p[2]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(6), __SYSTEM_N_LEVELS_RESULT_ARC(7), __SYSTEM_N_LEVELS_RESULT_ARC(8),
+    FIELD_DESC(struct system_n_levels_result,p[3]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(9), __SYSTEM_N_LEVELS_RESULT_ARC(10), __SYSTEM_N_LEVELS_RESULT_ARC(11),
+    FIELD_DESC(struct system_n_levels_result,p[4]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(12), __SYSTEM_N_LEVELS_RESULT_ARC(13), __SYSTEM_N_LEVELS_RESULT_ARC(14),
+    FIELD_DESC(struct system_n_levels_result,p[5]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(15), __SYSTEM_N_LEVELS_RESULT_ARC(16), __SYSTEM_N_LEVELS_RESULT_ARC(17),
+    FIELD_DESC(struct system_n_levels_result,p[6]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(18), __SYSTEM_N_LEVELS_RESULT_ARC(19), __SYSTEM_N_LEVELS_RESULT_ARC(20),
+    FIELD_DESC(struct system_n_levels_result,p[7]),
+    __SYSTEM_N_LEVELS_RESULT_ARC(21), __SYSTEM_N_LEVELS_RESULT_ARC(22)
+};
+
+
+size_t system_n_levels_user_params_n_fields(size_t n_levels)
+{
+    n_levels = n_levels < SYSTEM_N_LEVELS_MIN ? SYSTEM_N_LEVELS_MIN : MIN(n_levels,SYSTEM_N_LEVELS_MAX);
+    return 7 + 4*(n_levels-1) + 2;
+}
+
+
+size_t system_n_levels_result_n_fields(size_t n_levels)
+{
+    n_levels = n_levels < SYSTEM_N_LEVELS_MIN ? SYSTEM_N_LEVELS_MIN : MIN(n_levels,SYSTEM_N_LEVELS_MAX);
+    return 16*(n_levels-1) + 11;
+}
+
+
+void system_n_levels_default_user_params(struct system_n_levels_user_params *user_params, size_t n_levels)
+{
+    n_levels = n_levels < SYSTEM_N_LEVELS_MIN ? SYSTEM_N_LEVELS_MIN : MIN(n_levels,SYSTEM_N_LEVELS_MAX);
+    memset(user_params,0,sizeof(struct system_n_levels_user_params));
+    user_params->n_levels = n_levels;
+    user_params->p_atm = 101325;
+    user_params->p_ac = 1500;
+    user_params->k = 1.4;
+
+    // Same configurations as the 2- and 3-level defaults
+    if(n_levels == 2)
+    {
+        user_params->Ax = 0.482;
+        user_params->Ay = 1.4;
+        user_params->Bx = 0.28;
+        user_params->By = 0.85;
+        user_params->phi_left_0[0] = 3.129;
+        user_params->phi_membrane_0[0] = 1.162;
+        user_params->r_0[0] = 0.5;
+        user_params->r_0[1] = 0.35;
+        user_params->p_0[0] = 20000;
+        user_params->p_0[1] = 6500;
+        return;
+    }
+    if(n_levels == 3)
+    {
+        user_params->Ax = 0.482;
+        user_params->Ay = 1.8;
+        user_params->Bx = 0.78;
+        user_params->By = 1.25;
+        user_params->phi_left_0[0] = 3.129;
+        user_params->phi_membrane_0[0] = 1.162;
+        user_params->phi_left_0[1] = 1.8;
+        user_params->phi_membrane_0[1] = 1.0;
+        user_params->r_0[0] = 0.5;
+        user_params->r_0[1] = 0.4;
+        user_params->r_0[2] = 0.3;
+        user_params->p_0[0] = 20000;
+        user_params->p_0[1] = 12000;
+        user_params->p_0[2] = 6500;
+        return;
+    }
+
+    // Deeper stacks hang straight down as nested cups: A and B are level and
+    // every membrane has the same chord and bulges far into the level below,
+    // whose walls stay short. Flat membranes, which small pressure differences
+    // give, converge poorly. Pressures fall geometrically so that p_ac stays a
+    // small load on every level
+    const double gap = 0.6;
+    const double r_top = 0.5;
+    const double phi_top_membrane = 1.8;
+    const double phi_membrane = 2.5;
+    const double chord = 2*r_top*sin(phi_top_membrane/2);
+
+    user_params->Ax = 0.5 + r_top*sin(gap);
+    user_params->Ay = 1.8 + r_top*cos(gap);
+    user_params->Bx = 0.5 - r_top*sin(gap);
+    user_params->By = user_params->Ay;
+    user_params->phi_left_0[0] = M_PI - gap - phi_top_membrane/2;
+    user_params->phi_membrane_0[0] = phi_top_membrane;
+    user_params->r_0[0] = r_top;
+
+    for(size_t i = 0; i < n_levels; ++i)
+    {
+        user_params->p_0[i] = 60000*pow(0.1,i/(double)(n_levels-1));
+        if(i == 0)
+            continue;
+        if(i+1 == n_levels)
+        {
+            user_params->r_0[i] = 1.25*chord/2;
+            continue;
+        }
+        user_params->r_0[i] = chord/(2*sin(phi_membrane/2));
+        user_params->phi_membrane_0[i] = phi_membrane;
+        user_params->phi_left_0[i] = M_PI - phi_membrane;
+    }
+}
+
+
+// Centre of the circle of radius r through p1 and p2 on the same side as
+// center_from_points_and_radius picks, GSL_EDOM if the chord is too long
+int __system_n_levels_center(double x1, double y1, double x2, double y2, double r, double *cx, double *cy)
+{
+    double p1_data[2] = {x1,y1}, p2_data[2] = {x2,y2}, c_data[2];
+    gsl_vector_view p1 = gsl_vector_view_array(p1_data,2);
+    gsl_vector_view p2 = gsl_vector_view_array(p2_data,2);
+    gsl_vector_view c = gsl_vector_view_array(c_data,2);
+    center_from_points_and_radius(&p1.vector,&p2.vector,r,&c.vector);
+    if(!gsl_finite(c_data[0]) || !gsl_finite(c_data[1]))
+        return GSL_EDOM;
+
+    *cx = c_data[0];
+    *cy = c_data[1];
+
+    return GSL_SUCCESS;
+}
+
+
+// Clockwise angle from (ax, ay) to (bx, by)
+double __system_n_levels_ang(double ax, double ay, double bx, double by)
+{
+    double a_data[2] = {ax,ay}, b_data[2] = {bx,by};
+    gsl_vector_view a = gsl_vector_view_array(a_data,2);
+    gsl_vector_view b = gsl_vector_view_array(b_data,2);
+    double ang;
+    vectors_ang_clockwise(&a.vector,&b.vector,&ang);
+
+    return ang;
+}
+
+
+void __system_n_levels_arc_init(struct system_n_levels_arc *arc, double phi, double r, double cx, double cy, double a, int inner, int outer, int membrane)
+{
+    arc->s0 = (struct system_n_levels_arc_state){phi,r,cx,cy,a};
+    arc->alpha = 0;
+    arc->a_fixed = false;
+    arc->cx_shared = -1;
+    arc->inner = inner;
+    arc->outer = outer;
+    arc->membrane = membrane;
+}
+
+
+void __system_n_levels_junction_init(struct system_n_levels_junction *junction, int arc_0, int t_0, int arc_1, int t_1, int arc_2, int t_2)
+{
+    junction->n_ends = 3;
+    junction->ends[0] = (struct system_n_levels_end){arc_0,t_0};
+    junction->ends[1] = (struct system_n_levels_end){arc_1,t_1};
+    junction->ends[2] = (struct system_n_levels_end){arc_2,t_2};
+    junction->fixed = false;
+    junction->eqs = SYSTEM_N_LEVELS_CONT_X | SYSTEM_N_LEVELS_CONT_Y | SYSTEM_N_LEVELS_BAL_X | SYSTEM_N_LEVELS_BAL_Y;
+}
+
+
+// Level by level from A and B down: the top circle passes through A and B,
+// every next one through the lower corners of the previous level. The bottom
+// level hangs from them as two halves of one circle meeting at its lowest point
+int system_n_levels_stack(const struct system_n_levels_user_params *user_params, enum system_n_levels_pressure_law law, struct system_n_levels_topology *topo)
+{
+    if(!user_params || !topo)
+        return -1;
+
+    const size_t n = user_params->n_levels;
+    if(n < SYSTEM_N_LEVELS_MIN || n > SYSTEM_N_LEVELS_MAX)
+        return GSL_EINVAL;
+
+    memset(topo,0,sizeof(struct system_n_levels_topology));
+    topo->n_levels = n;
+    topo->law = law;
+    topo->p_ac = user_params->p_ac;
+    topo->k = user_params->k;
+    topo->n_arcs = 3*(n-1) + 2;
+    topo->n_chambers = n;
+    topo->n_membranes = 3*(n-1) + 1;
+    topo->n_junctions = 2*n + 1;
+
+    struct system_n_levels_junction *A = &topo->junctions[0];
+    A->n_ends = 1;
+    A->ends[0] = (struct system_n_levels_end){SYSTEM_N_LEVELS_ARC_LEFT(0),0};
+    A->fixed = true;
+    A->x = user_params->Ax;
+    A->y = user_params->Ay;
+    A->eqs = SYSTEM_N_LEVELS_CONT_X | SYSTEM_N_LEVELS_CONT_Y;
+
+    struct system_n_levels_junction *B = &topo->junctions[1];
+    B->n_ends = 1;
+    B->ends[0] = (struct system_n_levels_end){SYSTEM_N_LEVELS_ARC_RIGHT(0),1};
+    B->fixed = true;
+    B->x = user_params->Bx;
+    B->y = user_params->By;
+    B->eqs = SYSTEM_N_LEVELS_CONT_X | SYSTEM_N_LEVELS_CONT_Y;
+
+    // Upper corners of the current level
+    double left_x = user_params->Ax, left_y = user_params->Ay;
+    double right_x = user_params->Bx, right_y = user_params->By;
+    for(size_t i = 0; i+1 < n; ++i)
+    {
+        const double r = user_params->r_0[i];
+        double cx, cy;
+        int status = i == 0 ? __system_n_levels_center(left_x,left_y,right_x,right_y,r,&cx,&cy)
+                            : __system_n_levels_center(right_x,right_y,left_x,left_y,r,&cx,&cy);
+        if(status)
+            return status;
+
+        const double a_left = __system_n_levels_ang(-1,0,left_x-cx,left_y-cy);
+        const double a_membrane = a_left + user_params->phi_left_0[i];
+        const double a_right = a_membrane + user_params->phi_membrane_0[i];
+
+        const double lower_left_x = cx - r*gsl_sf_cos(a_membrane);
+        const double lower_left_y = cy + r*gsl_sf_sin(a_membrane);
+        const double lower_right_x = cx - r*gsl_sf_cos(a_right);
+        const double lower_right_y = cy + r*gsl_sf_sin(a_right);
+        const double phi_right = __system_n_levels_ang(lower_right_x-cx,lower_right_y-cy,right_x-cx,right_y-cy);
+
+        const int level = (int)i;
+        const int left = SYSTEM_N_LEVELS_ARC_LEFT(i);
+        const int right = SYSTEM_N_LEVELS_ARC_RIGHT(i);
+        const int membrane = SYSTEM_N_LEVELS_ARC_MEMBRANE(i);
+        __system_n_levels_arc_init(&topo->arcs[left],user_params->phi_left_0[i],r,cx,cy,a_left,level,SYSTEM_N_LEVELS_AMBIENT_LEFT,left);
+        __system_n_levels_arc_init(&topo->arcs[right],phi_right,r,cx,cy,a_right,level,SYSTEM_N_LEVELS_AMBIENT_RIGHT,right);
+        __system_n_levels_arc_init(&topo->arcs[membrane],user_params->phi_membrane_0[i],r,cx,cy,a_membrane,level,level+1,membrane);
+
+        // Lower corners, shared with the walls of the next level
+        __system_n_levels_junction_init(&topo->junctions[2+2*i],left,1,membrane,0,SYSTEM_N_LEVELS_ARC_LEFT(i+1),0);
+        __system_n_levels_junction_init(&topo->junctions[3+2*i],right,0,membrane,1,SYSTEM_N_LEVELS_ARC_RIGHT(i+1),1);
+
+        struct system_n_levels_chamber *chamber = &topo->chambers[i];
+        chamber->n_arcs = 3;
+        chamber->arcs[0] = left;
+        chamber->arcs[1] = membrane;
+        chamber->arcs[2] = right;
+        chamber->p_0 = user_params->p_0[i];
+
+        left_x = lower_left_x;
+        left_y = lower_left_y;
+        right_x = lower_right_x;
+        right_y = lower_right_y;
+    }
+
+    const size_t b = n-1;
+    const double r = user_params->r_0[b];
+    double cx, cy;
+    int status = __system_n_levels_center(right_x,right_y,left_x,left_y,r,&cx,&cy);
+    if(status)
+        return status;
+
+    // Lowest point G, both halves start there at 3*pi/2
+    const double a_bot = 3*M_PI_2;
+    const double phi_left = __system_n_levels_ang(left_x-cx,left_y-cy,0,-r);
+    const double phi_right = __system_n_levels_ang(0,-r,right_x-cx,right_y-cy);
+
+    // Both halves are one membrane, numbered after the upper arcs
+    const int left = SYSTEM_N_LEVELS_ARC_LEFT(b);
+    const int right = SYSTEM_N_LEVELS_ARC_RIGHT(b);
+    const int membrane = left;
+    __system_n_levels_arc_init(&topo->arcs[left],phi_left,r,cx,cy,a_bot,(int)b,SYSTEM_N_LEVELS_AMBIENT_LEFT,membrane);
+    topo->arcs[left].alpha = -1;
+    topo->arcs[left].a_fixed = true;
+    __system_n_levels_arc_init(&topo->arcs[right],phi_right,r,cx,cy,a_bot,(int)b,SYSTEM_N_LEVELS_AMBIENT_RIGHT,membrane);
+    topo->arcs[right].a_fixed = true;
+    topo->arcs[right].cx_shared = left;
+
+    // G lies on the shared vertical through the centre, tangents there are horizontal
+    struct system_n_levels_junction *G = &topo->junctions[2*n];
+    G->n_ends = 2;
+    G->ends[0] = (struct system_n_levels_end){right,0};
+    G->ends[1] = (struct system_n_levels_end){left,1};
+    G->fixed = false;
+    G->eqs = SYSTEM_N_LEVELS_CONT_Y | SYSTEM_N_LEVELS_BAL_X;
+
+    struct system_n_levels_chamber *chamber = &topo->chambers[b];
+    chamber->n_arcs = 2;
+    chamber->arcs[0] = right;
+    chamber->arcs[1] = left;
+    chamber->p_0 = user_params->p_0[b];
+
+    return GSL_SUCCESS;
+}
+
+
+static size_t __system_n_levels_popcount(unsigned v)
+{
+    size_t n = 0;
+    for(; v; v >>= 1)
+        n += v & 1u;
+    return n;
+}
+
+
+size_t __system_n_levels_junction_rows(const struct system_n_levels_junction *junction)
+{
+    const size_t cont = __system_n_levels_popcount(junction->eqs & (SYSTEM_N_LEVELS_CONT_X | SYSTEM_N_LEVELS_CONT_Y));
+    const size_t bal = __system_n_levels_popcount(junction->eqs & (SYSTEM_N_LEVELS_BAL_X | SYSTEM_N_LEVELS_BAL_Y));
+
+    return (junction->fixed ? cont : cont*(junction->n_ends-1)) + bal;
+}
+
+
+void __system_n_levels_chamber_arcs(const struct system_n_levels *sys, const struct system_n_levels_arc_state *q, const struct system_n_levels_chamber *chamber, struct chamber_arc *arcs)
+{
+    for(size_t i = 0; i < chamber->n_arcs; ++i)
+    {
+        const int k = chamber->arcs[i];
+        const int *idx = sys->idx[k];
+        arcs[i] = (struct chamber_arc){q[k].cx,q[k].cy,q[k].r,q[k].a,q[k].phi,sys->topo.arcs[k].alpha,1,
+                                       idx[ARC_CX],idx[ARC_CY],idx[ARC_R],idx[ARC_A],idx[ARC_PHI]};
+    }
+}
+
+
+static uint64_t __system_n_levels_hash_add(uint64_t h, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    for(size_t i = 0; i < size; ++i)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+
+// FNV-1a over what decides the equations and the unknowns they read, not
+// over the configuration. Fields are hashed one by one to skip padding
+static uint64_t __system_n_levels_topology_hash(const struct system_n_levels_topology *topo)
+{
+    uint64_t h = 1469598103934665603ULL;
+#define HASH(v) h = __system_n_levels_hash_add(h,&(v),sizeof(v))
+    HASH(topo->n_arcs);
+    HASH(topo->n_junctions);
+    HASH(topo->n_chambers);
+    HASH(topo->n_membranes);
+    HASH(topo->law);
+    for(size_t i = 0; i < topo->n_arcs; ++i)
+    {
+        const struct system_n_levels_arc *arc = &topo->arcs[i];
+        HASH(arc->alpha);
+        HASH(arc->a_fixed);
+        HASH(arc->cx_shared);
+        HASH(arc->inner);
+        HASH(arc->outer);
+        HASH(arc->membrane);
+    }
+    for(size_t j = 0; j < topo->n_junctions; ++j)
+    {
+        const struct system_n_levels_junction *junction = &topo->junctions[j];
+        HASH(junction->n_ends);
+        for(size_t k = 0; k < junction->n_ends; ++k)
+        {
+            HASH(junction->ends[k].arc);
+            HASH(junction->ends[k].t);
+        }
+        HASH(junction->fixed);
+        HASH(junction->eqs);
+    }
+    for(size_t c = 0; c < topo->n_chambers; ++c)
+    {
+        const struct system_n_levels_chamber *chamber = &topo->chambers[c];
+        HASH(chamber->n_arcs);
+        for(size_t i = 0; i < chamber->n_arcs; ++i)
+            HASH(chamber->arcs[i]);
+    }
+#undef HASH
+
+    return h;
+}
+
+
+int system_n_levels_assemble(const struct system_n_levels_topology *topo, struct system_n_levels *sys)
+{
+    if(!topo || !sys)
+        return -1;
+    if(topo->n_arcs > SYSTEM_N_LEVELS_MAX_ARCS || topo->n_junctions > SYSTEM_N_LEVELS_MAX_JUNCTIONS ||
+       topo->n_chambers > SYSTEM_N_LEVELS_MAX_CHAMBERS || topo->n_membranes > SYSTEM_N_LEVELS_MAX_MEMBRANES)
+        return GSL_EINVAL;
+
+    sys->topo = *topo;
+
+    int n = 0;
+    for(size_t i = 0; i < topo->n_arcs; ++i)
+    {
+        const struct system_n_levels_arc *arc = &topo->arcs[i];
+        int *idx = sys->idx[i];
+        idx[ARC_PHI] = n++;
+        idx[ARC_R] = n++;
+        if(arc->cx_shared >= 0)
+        {
+            if((size_t)arc->cx_shared >= i)
+                return GSL_EINVAL;
+            idx[ARC_CX] = sys->idx[arc->cx_shared][ARC_CX];
+        }
+        else
+            idx[ARC_CX] = n++;
+        idx[ARC_CY] = n++;
+        idx[ARC_A] = arc->a_fixed ? -1 : n++;
+    }
+    for(size_t c = 0; c < topo->n_chambers; ++c)
+        sys->p_idx[c] = n++;
+    sys->n_eq = (size_t)n;
+    sys->topology_hash = __system_n_levels_topology_hash(topo);
+
+    size_t rows = topo->n_membranes + topo->n_chambers;
+    for(size_t j = 0; j < topo->n_junctions; ++j)
+        rows += __system_n_levels_junction_rows(&topo->junctions[j]);
+    if(rows != sys->n_eq)
+        return GSL_EBADLEN;
+
+    struct system_n_levels_arc_state q[SYSTEM_N_LEVELS_MAX_ARCS];
+    for(size_t m = 0; m < topo->n_membranes; ++m)
+        sys->L_0[m] = 0;
+    for(size_t i = 0; i < topo->n_arcs; ++i)
+    {
+        q[i] = topo->arcs[i].s0;
+        sys->L_0[topo->arcs[i].membrane] += q[i].r*q[i].phi;
+    }
+    for(size_t c = 0; c < topo->n_chambers; ++c)
+    {
+        struct chamber_arc arcs[3];
+        __system_n_levels_chamber_arcs(sys,q,&topo->chambers[c],arcs);
+        sys->S_0[c] = chamber_area(arcs,topo->chambers[c].n_arcs,NULL);
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+void system_n_levels_x0(const struct system_n_levels *sys, gsl_vector *x)
+{
+    struct system_n_levels_result res;
+    res.n_arcs = sys->topo.n_arcs;
+    res.n_chambers = sys->topo.n_chambers;
+    for(size_t i = 0; i < sys->topo.n_arcs; ++i)
+        res.arcs[i] = sys->topo.arcs[i].s0;
+    for(size_t c = 0; c < sys->topo.n_chambers; ++c)
+        res.p[c] = sys->topo.chambers[c].p_0;
+
+    system_n_levels_res_to_x(sys,&res,x);
+}
+
+
+static inline double __system_n_levels_get(const gsl_vector *x, int i, double fixed)
+{
+    return i >= 0 ? gsl_vector_get(x,(size_t)i) : fixed;
+}
+
+
+void system_n_levels_x_to_res(const struct system_n_levels *sys, const gsl_vector *x, struct system_n_levels_result *result)
+{
+    result->n_arcs = sys->topo.n_arcs;
+    result->n_chambers = sys->topo.n_chambers;
+    for(size_t i = 0; i < sys->topo.n_arcs; ++i)
+    {
+        const struct system_n_levels_arc_state *s0 = &sys->topo.arcs[i].s0;
+        const int *idx = sys->idx[i];
+        result->arcs[i].phi = __system_n_levels_get(x,idx[ARC_PHI],s0->phi);
+        result->arcs[i].r = __system_n_levels_get(x,idx[ARC_R],s0->r);
+        result->arcs[i].cx = __system_n_levels_get(x,idx[ARC_CX],s0->cx);
+        result->arcs[i].cy = __system_n_levels_get(x,idx[ARC_CY],s0->cy);
+        result->arcs[i].a = __system_n_levels_get(x,idx[ARC_A],s0->a);
+    }
+    for(size_t c = 0; c < sys->topo.n_chambers; ++c)
+        result->p[c] = gsl_vector_get(x,(size_t)sys->p_idx[c]);
+}
+
+
+void system_n_levels_res_to_x(const struct system_n_levels *sys, const struct system_n_levels_result *result, gsl_vector *x)
+{
+    for(size_t i = 0; i < sys->topo.n_arcs; ++i)
+    {
+        const double v[5] = {result->arcs[i].phi,result->arcs[i].r,result->arcs[i].cx,result->arcs[i].cy,result->arcs[i].a};
+        for(size_t k = 0; k < 5; ++k)
+            if(sys->idx[i][k] >= 0)
+                gsl_vector_set(x,(size_t)sys->idx[i][k],v[k]);
+    }
+    for(size_t c = 0; c < sys->topo.n_chambers; ++c)
+        gsl_vector_set(x,(size_t)sys->p_idx[c],result->p[c]);
+}
+
+
+static inline void __system_n_levels_J_add(struct jacobian *J, size_t row, int col, double v)
+{
+    if(col >= 0)
+        *jacobian_entry(J,row,(size_t)col) += v;
+}
+
+
+// Coordinate comp (0 is x, 1 is y) of an arc end, scale times its gradient is added to the row of J
+double __system_n_levels_end_point(const struct system_n_levels *sys, const struct system_n_levels_arc_state *q, struct system_n_levels_end end, int comp, double scale, struct jacobian *J, size_t row)
+{
+    const struct system_n_levels_arc_state *s = &q[end.arc];
+    const int *idx = sys->idx[end.arc];
+    const double dang_dphi = sys->topo.arcs[end.arc].alpha + end.t;
+    const double ang = s->a + dang_dphi*s->phi;
+    const double sin_ang = gsl_sf_sin(ang);
+    const double cos_ang = gsl_sf_cos(ang);
+
+    if(comp == 0)
+    {
+        if(J)
+        {
+            __system_n_levels_J_add(J,row,idx[ARC_CX],scale);
+            __system_n_levels_J_add(J,row,idx[ARC_R],-scale*cos_ang);
+            __system_n_levels_J_add(J,row,idx[ARC_A],scale*s->r*sin_ang);
+            __system_n_levels_J_add(J,row,idx[ARC_PHI],scale*s->r*sin_ang*dang_dphi);
+        }
+        return s->cx - s->r*cos_ang;
+    }
+
+    if(J)
+    {
+        __system_n_levels_J_add(J,row,idx[ARC_CY],scale);
+        __system_n_levels_J_add(J,row,idx[ARC_R],scale*sin_ang);
+        __system_n_levels_J_add(J,row,idx[ARC_A],scale*s->r*cos_ang);
+        __system_n_levels_J_add(J,row,idx[ARC_PHI],scale*s->r*cos_ang*dang_dphi);
+    }
+    return s->cy + s->r*sin_ang;
+}
+
+
+// Pressure on one side of an arc and its position in x, -1 for the ambient
+double __system_n_levels_side_p(const struct system_n_levels *sys, const double *p, int side, int *idx)
+{
+    if(side >= 0)
+    {
+        *idx = sys->p_idx[side];
+        return p[side];
+    }
+
+    *idx = -1;
+    return side == SYSTEM_N_LEVELS_AMBIENT_RIGHT ? sys->topo.p_ac : 0;
+}
+
+
+// Tension (p_inner - p_outer)*r of an arc pulls its end along the tangent
+// (sin, cos) of theta, inwards from the start and outwards from the end
+double __system_n_levels_tension(const struct system_n_levels *sys, const struct system_n_levels_arc_state *q, const double *p, struct system_n_levels_end end, int comp, struct jacobian *J, size_t row)
+{
+    const struct system_n_levels_arc *arc = &sys->topo.arcs[end.arc];
+    const struct system_n_levels_arc_state *s = &q[end.arc];
+    const int *idx = sys->idx[end.arc];
+    const double sign = end.t == 0 ? 1 : -1;
+    const double dang_dphi = arc->alpha + end.t;
+    const double ang = s->a + dang_dphi*s->phi;
+    const double sin_ang = gsl_sf_sin(ang);
+    const double cos_ang = gsl_sf_cos(ang);
+    const double trig = comp == 0 ? sin_ang : cos_ang;
+    const double dtrig = comp == 0 ? cos_ang : -sin_ang;
+
+    int i_inner, i_outer;
+    const double dp = __system_n_levels_side_p(sys,p,arc->inner,&i_inner) - __system_n_levels_side_p(sys,p,arc->outer,&i_outer);
+
+    if(J)
+    {
+        __system_n_levels_J_add(J,row,i_inner,sign*s->r*trig);
+        __system_n_levels_J_add(J,row,i_outer,-sign*s->r*trig);
+        __system_n_levels_J_add(J,row,idx[ARC_R],sign*dp*trig);
+        __system_n_levels_J_add(J,row,idx[ARC_A],sign*dp*s->r*dtrig);
+        __system_n_levels_J_add(J,row,idx[ARC_PHI],sign*dp*s->r*dtrig*dang_dphi);
+    }
+
+    return sign*dp*s->r*trig;
+}
+
+
+// Either of f and J may be NULL
+void __system_n_levels_fdf_general(const gsl_vector *x, const struct system_n_levels *sys, gsl_vector *f, struct jacobian *J)
+{
+    const struct system_n_levels_topology *topo = &sys->topo;
+
+    struct system_n_levels_result state;
+    system_n_levels_x_to_res(sys,x,&state);
+    const struct system_n_levels_arc_state *q = state.arcs;
+    const double *p = state.p;
+
+    if(J)
+        jacobian_zero(J);
+
+    size_t row = 0;
+
+    // Preservation of length
+    for(size_t m = 0; m < topo->n_membranes; ++m, ++row)
+    {
+        double L = 0;
+        for(size_t i = 0; i < topo->n_arcs; ++i)
+        {
+            if(topo->arcs[i].membrane != (int)m)
+                continue;
+            L += q[i].r*q[i].phi;
+            if(J)
+            {
+                __system_n_levels_J_add(J,row,sys->idx[i][ARC_R],q[i].phi);
+                __system_n_levels_J_add(J,row,sys->idx[i][ARC_PHI],q[i].r);
+            }
+        }
+        if(f)
+            gsl_vector_set(f,row,L - sys->L_0[m]);
+    }
+
+    // Points continuity
+    for(size_t j = 0; j < topo->n_junctions; ++j)
+    {
+        const struct system_n_levels_junction *junction = &topo->junctions[j];
+        for(int comp = 0; comp < 2; ++comp)
+        {
+            if(!(junction->eqs & (comp == 0 ? SYSTEM_N_LEVELS_CONT_X : SYSTEM_N_LEVELS_CONT_Y)))
+                continue;
+
+            if(junction->fixed)
+            {
+                const double v = __system_n_levels_end_point(sys,q,junction->ends[0],comp,1,J,row);
+                if(f)
+                    gsl_vector_set(f,row,v - (comp == 0 ? junction->x : junction->y));
+                ++row;
+                continue;
+            }
+
+            for(size_t k = 1; k < junction->n_ends; ++k, ++row)
+            {
+                const double v0 = __system_n_levels_end_point(sys,q,junction->ends[0],comp,1,J,row);
+                const double vk = __system_n_levels_end_point(sys,q,junction->ends[k],comp,-1,J,row);
+                if(f)
+                    gsl_vector_set(f,row,v0 - vk);
+            }
+        }
+    }
+
+    // Points steadiness
+    for(size_t j = 0; j < topo->n_junctions; ++j)
+    {
+        const struct system_n_levels_junction *junction = &topo->junctions[j];
+        for(int comp = 0; comp < 2; ++comp)
+        {
+            if(!(junction->eqs & (comp == 0 ? SYSTEM_N_LEVELS_BAL_X : SYSTEM_N_LEVELS_BAL_Y)))
+                continue;
+
+            double v = 0;
+            for(size_t k = 0; k < junction->n_ends; ++k)
+                v += __system_n_levels_tension(sys,q,p,junction->ends[k],comp,J,row);
+            if(f)
+                gsl_vector_set(f,row,v);
+            ++row;
+        }
+    }
+
+    // Balloons pressures
+    for(size_t c = 0; c < topo->n_chambers; ++c, ++row)
+    {
+        const struct system_n_levels_chamber *chamber = &topo->chambers[c];
+        const int i_p = sys->p_idx[c];
+
+        if(topo->law == SYSTEM_N_LEVELS_ISOTHERMAL)
+        {
+            if(f)
+                gsl_vector_set(f,row,p[c] - chamber->p_0);
+            if(J)
+                __system_n_levels_J_add(J,row,i_p,1);
+            continue;
+        }
+
+        // p_0*S_0^k - p*S^k
+        struct chamber_arc arcs[3];
+        struct chamber_arc_grad grad[3];
+        __system_n_levels_chamber_arcs(sys,q,chamber,arcs);
+        const double S = chamber_area(arcs,chamber->n_arcs,J ? grad : NULL);
+        const double S_pow_k_1 = pow(S,topo->k-1);
+        if(f)
+            gsl_vector_set(f,row,chamber->p_0*pow(sys->S_0[c],topo->k) - p[c]*S_pow_k_1*S);
+        if(J)
+        {
+            chamber_area_grad_scatter(arcs,chamber->n_arcs,grad,-p[c]*topo->k*S_pow_k_1,J,row);
+            __system_n_levels_J_add(J,row,i_p,-S_pow_k_1*S);
+        }
+    }
+}
+
+
+int system_n_levels_f(const gsl_vector *x, void *p, gsl_vector *f)
+{
+    __system_n_levels_fdf_general(x,(struct system_n_levels*)p,f,NULL);
+
+    return GSL_SUCCESS;
+}
+
+
+int system_n_levels_df(const gsl_vector *x, void *p, gsl_matrix *J)
+{
+    struct jacobian jac = jacobian_dense(J);
+    __system_n_levels_fdf_general(x,(struct system_n_levels*)p,NULL,&jac);
+
+    return GSL_SUCCESS;
+}
+
+
+int system_n_levels_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J)
+{
+    struct jacobian jac = jacobian_dense(J);
+    __system_n_levels_fdf_general(x,(struct system_n_levels*)p,f,&jac);
+
+    return GSL_SUCCESS;
+}
+
+
+int system_n_levels_jac(const gsl_vector *x, void *p, struct jacobian *J)
+{
+    __system_n_levels_fdf_general(x,(struct system_n_levels*)p,NULL,J);
+
+    return GSL_SUCCESS;
+}
+
+
+#ifdef CW_GENERATED_KERNELS
+extern const struct system_n_levels_kernels __system_n_levels_generated[SYSTEM_N_LEVELS_MAX+1][2];
+#endif
+
+
+const struct system_n_levels_kernels *system_n_levels_kernels_find(const struct system_n_levels *sys)
+{
+#ifdef CW_GENERATED_KERNELS
+    const size_t n = sys->topo.n_levels;
+    if(n < SYSTEM_N_LEVELS_MIN || n > SYSTEM_N_LEVELS_MAX || (unsigned)sys->topo.law > SYSTEM_N_LEVELS_ADIABATIC)
+        return NULL;
+
+    // A stack edited after system_n_levels_stack keeps its n_levels
+    const struct system_n_levels_kernels *kernels = &__system_n_levels_generated[n][sys->topo.law];
+    if(kernels->n_eq == sys->n_eq && kernels->topology_hash == sys->topology_hash)
+        return kernels;
+#else
+    (void)sys;
+#endif
+    return NULL;
+}
+
+
+// Fixed solves of the generic residual, one per size of the plain stacks,
+// which have 16*n_levels - 8 unknowns
+#define FIXED_NEWTON_N          24
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_2_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          40
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_3_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          56
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_4_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          72
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_5_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          88
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_6_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          104
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_7_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define FIXED_NEWTON_N          120
+#define FIXED_NEWTON_NAME(s)    __system_n_levels_8_fixed_##s
+#define FIXED_NEWTON_F          system_n_levels_f
+#define FIXED_NEWTON_DF         system_n_levels_df
+#include <equations/fixed_newton.h>
+
+#define __SYSTEM_N_LEVELS_GENERIC(n) \
+    {system_n_levels_f,system_n_levels_df,system_n_levels_fdf,system_n_levels_jac,__system_n_levels_##n##_fixed_solve,16*(n)-8,0}
+
+static const struct system_n_levels_kernels __system_n_levels_generic[SYSTEM_N_LEVELS_MAX+1] = {
+    [2] = __SYSTEM_N_LEVELS_GENERIC(2),
+    [3] = __SYSTEM_N_LEVELS_GENERIC(3),
+    [4] = __SYSTEM_N_LEVELS_GENERIC(4),
+    [5] = __SYSTEM_N_LEVELS_GENERIC(5),
+    [6] = __SYSTEM_N_LEVELS_GENERIC(6),
+    [7] = __SYSTEM_N_LEVELS_GENERIC(7),
+    [8] = __SYSTEM_N_LEVELS_GENERIC(8)
+};
+
+#undef __SYSTEM_N_LEVELS_GENERIC
+
+
+const struct system_n_levels_kernels *system_n_levels_kernels(const struct system_n_levels *sys)
+{
+    static const struct system_n_levels_kernels generic = {system_n_levels_f,system_n_levels_df,system_n_levels_fdf,system_n_levels_jac};
+
+    const struct system_n_levels_kernels *kernels = system_n_levels_kernels_find(sys);
+    if(kernels)
+        return kernels;
+
+    const size_t n = (sys->n_eq + 8)/16;
+    if(n >= SYSTEM_N_LEVELS_MIN && n <= SYSTEM_N_LEVELS_MAX && __system_n_levels_generic[n].n_eq == sys->n_eq)
+        return &__system_n_levels_generic[n];
+
+    return &generic;
+}
+
+
+struct system_n_levels_ctx
+{
+    enum solver_backend backend;
+    struct system_n_levels sys;
+    size_t n;
+    gsl_vector *x0;
+    gsl_vector *x;
+    gsl_multiroot_fdfsolver *dense;
+    struct sparse_newton_workspace *sparse;
+    uint64_t sparse_hash;       // topology of the pattern sparse holds
+
+    struct system_n_levels_result warm;
+    bool warm_valid;
+    size_t iters;
+
+    struct solver_stats *stats;
+    struct solver_probe probe;
+    gsl_vector *f;
+
+    struct solver_cancel cancel;
+};
+
+
+struct system_n_levels_ctx *system_n_levels_ctx_alloc(enum solver_backend backend)
+{
+    struct system_n_levels_ctx *ctx = calloc(1,sizeof(struct system_n_levels_ctx));
+    if(!ctx)
+        return NULL;
+
+    ctx->backend = backend;
+    ctx->n = 0;
+    ctx->warm_valid = false;
+    ctx->iters = 0;
+
+    return ctx;
+}
+
+
+void __system_n_levels_ctx_release(struct system_n_levels_ctx *ctx)
+{
+    if(ctx->dense)
+        gsl_multiroot_fdfsolver_free(ctx->dense);
+    sparse_newton_free(ctx->sparse);
+    gsl_vector_free(ctx->f);
+    gsl_vector_free(ctx->x);
+    gsl_vector_free(ctx->x0);
+    ctx->dense = NULL;
+    ctx->sparse = NULL;
+    ctx->f = NULL;
+    ctx->x = NULL;
+    ctx->x0 = NULL;
+    ctx->n = 0;
+}
+
+
+void system_n_levels_ctx_free(struct system_n_levels_ctx *ctx)
+{
+    if(!ctx)
+        return;
+    __system_n_levels_ctx_release(ctx);
+    free(ctx);
+}
+
+
+// Workspaces are sized by the number of unknowns and kept while it does not change
+int __system_n_levels_ctx_reserve(struct system_n_levels_ctx *ctx, size_t n)
+{
+    if(ctx->n == n)
+        return GSL_SUCCESS;
+
+    __system_n_levels_ctx_release(ctx);
+    ctx->x0 = gsl_vector_alloc(n);
+    ctx->x = gsl_vector_alloc(n);
+    ctx->f = gsl_vector_alloc(n);
+    bool backend_ok = true;
+    switch(ctx->backend)
+    {
+        case SOLVER_BACKEND_SPARSE_NEWTON:
+            ctx->sparse = sparse_newton_alloc(n);
+            backend_ok = ctx->sparse != NULL;
+            break;
+        case SOLVER_BACKEND_FIXED_NEWTON:
+            break;
+        default:
+            ctx->dense = gsl_multiroot_fdfsolver_alloc(gsl_multiroot_fdfsolver_hybridsj,n);
+            backend_ok = ctx->dense != NULL;
+            break;
+    }
+    if(!ctx->x0 || !ctx->x || !ctx->f || !backend_ok)
+    {
+        __system_n_levels_ctx_release(ctx);
+        return GSL_ENOMEM;
+    }
+    ctx->n = n;
+
+    return GSL_SUCCESS;
+}
+
+
+void system_n_levels_ctx_set_warm(struct system_n_levels_ctx *ctx, const struct system_n_levels_result *warm)
+{
+    ctx->warm_valid = (warm != NULL);
+    if(warm)
+        memcpy(&ctx->warm,warm,sizeof(struct system_n_levels_result));
+}
+
+
+size_t system_n_levels_ctx_iterations(const struct system_n_levels_ctx *ctx)
+{
+    return ctx->iters;
+}
+
+
+void system_n_levels_ctx_set_stats(struct system_n_levels_ctx *ctx, struct solver_stats *stats)
+{
+    ctx->stats = stats;
+}
+
+
+void system_n_levels_ctx_set_cancel(struct system_n_levels_ctx *ctx, solver_cancel_t cancelled, void *data)
+{
+    ctx->cancel.cancelled = cancelled;
+    ctx->cancel.data = data;
+}
+
+
+int __system_n_levels_iterate(gsl_multiroot_fdfsolver *s, gsl_multiroot_function_fdf *fdf, const gsl_vector *x0, size_t max_iters, size_t *iters, const struct solver_cancel *cancel)
+{
+    gsl_multiroot_fdfsolver_set(s,fdf,x0);
+
+    size_t iter = 0;
+    double eps = 1e-7;
+    int status;
+    do
+    {
+        if(solver_cancelled(cancel))
+        {
+            status = SOLVER_ECANCELLED;
+            break;
+        }
+
+        status = gsl_multiroot_fdfsolver_iterate(s);
+        if(status)
+            break;
+
+        status = gsl_multiroot_test_residual(s->f,eps);
+        ++iter;
+    } while(status == GSL_CONTINUE && iter < max_iters);
+    if(status == GSL_CONTINUE)
+        status = GSL_EMAXITER;
+
+    *iters = iter;
+
+    return status;
+}
+
+
+// Solves from ctx->x in place with the backend the context was allocated for
+int __system_n_levels_ctx_run(struct system_n_levels_ctx *ctx, size_t max_iters, size_t *iters)
+{
+    const double eps = 1e-7;
+
+    const struct system_n_levels_kernels *kernels = system_n_levels_kernels(&ctx->sys);
+    if(ctx->backend == SOLVER_BACKEND_FIXED_NEWTON)
+    {
+        *iters = 0;
+        if(!kernels->fixed_solve)
+            return GSL_EUNIMPL;
+        return kernels->fixed_solve(&ctx->sys,ctx->x->data,max_iters,eps,iters,ctx->stats,&ctx->cancel);
+    }
+
+    // With stats attached the system is called through the probe
+    const struct system_n_levels_kernels probed = {solver_probe_f,solver_probe_df,solver_probe_fdf,solver_probe_jac};
+    void *params = &ctx->sys;
+    if(ctx->stats)
+    {
+        ctx->probe = (struct solver_probe){kernels->f,kernels->df,kernels->fdf,kernels->jac,&ctx->sys,ctx->stats};
+        kernels = &probed;
+        params = &ctx->probe;
+    }
+
+    if(ctx->backend == SOLVER_BACKEND_SPARSE_NEWTON)
+    {
+        if(ctx->sparse_hash != ctx->sys.topology_hash)
+            sparse_newton_reset(ctx->sparse);
+        ctx->sparse_hash = ctx->sys.topology_hash;
+        return sparse_newton_solve(ctx->sparse,kernels->f,kernels->jac,params,ctx->x,max_iters,eps,iters,&ctx->cancel);
+    }
+
+    gsl_multiroot_function_fdf fdf;
+    fdf.f = kernels->f;
+    fdf.df = kernels->df;
+    fdf.fdf = kernels->fdf;
+    fdf.n = ctx->n;
+    fdf.params = params;
+    int status = __system_n_levels_iterate(ctx->dense,&fdf,ctx->x,max_iters,iters,&ctx->cancel);
+    gsl_vector_memcpy(ctx->x,ctx->dense->x);
+
+    return status;
+}
+
+
+int system_n_levels_ctx_solve(struct system_n_levels_ctx *ctx, const struct system_n_levels_topology *topo, struct system_n_levels_result *result)
+{
+    if(!ctx || !topo || !result)
+        return -1;
+
+    const double t_start = ctx->stats ? solver_clock() : 0;
+    if(ctx->stats)
+        solver_stats_reset(ctx->stats);
+
+    int status = system_n_levels_assemble(topo,&ctx->sys);
+    if(status)
+        return status;
+    status = __system_n_levels_ctx_reserve(ctx,ctx->sys.n_eq);
+    if(status)
+        return status;
+    system_n_levels_x0(&ctx->sys,ctx->x0);
+    if(ctx->stats)
+        ctx->stats->t_init = solver_clock() - t_start;
+
+    // Warm start only carries over between stacks of the same shape
+    status = GSL_CONTINUE;
+    size_t iters = 0;
+    if(ctx->warm_valid && ctx->warm.n_arcs == topo->n_arcs && ctx->warm.n_chambers == topo->n_chambers)
+    {
+        system_n_levels_res_to_x(&ctx->sys,&ctx->warm,ctx->x);
+        status = __system_n_levels_ctx_run(ctx,50,&iters);
+        if(ctx->stats)
+            ctx->stats->warm = (status == GSL_SUCCESS);
+    }
+
+    if(status != GSL_SUCCESS && status != SOLVER_ECANCELLED)
+    {
+        size_t cold_iters = 0;
+        gsl_vector_memcpy(ctx->x,ctx->x0);
+        status = __system_n_levels_ctx_run(ctx,1000,&cold_iters);
+        iters += cold_iters;
+    }
+
+    if(ctx->stats)
+        solver_stats_finish(ctx->stats,status,iters,t_start,system_n_levels_kernels(&ctx->sys)->f,&ctx->sys,ctx->x,ctx->f);
+
+    system_n_levels_x_to_res(&ctx->sys,ctx->x,result);
+    ctx->iters = iters;
+    if(status != SOLVER_ECANCELLED)
+        system_n_levels_ctx_set_warm(ctx,status == GSL_SUCCESS ? result : NULL);
+
+    return status;
+}
+
+
+int __system_n_levels_ctx_eval_general(struct system_n_levels_ctx *ctx, const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, enum system_n_levels_pressure_law law)
+{
+    if(!ctx || !user_params || !result)
+        return -1;
+
+    struct system_n_levels_topology topo;
+    int status = system_n_levels_stack(user_params,law,&topo);
+    if(status)
+        return status;
+
+    return system_n_levels_ctx_solve(ctx,&topo,result);
+}
+
+
+int system_n_levels_ctx_eval(struct system_n_levels_ctx *ctx, const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result)
+{
+    return __system_n_levels_ctx_eval_general(ctx,user_params,result,SYSTEM_N_LEVELS_ISOTHERMAL);
+}
+
+
+int system_n_levels_ctx_adiabatic_eval(struct system_n_levels_ctx *ctx, const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result)
+{
+    return __system_n_levels_ctx_eval_general(ctx,user_params,result,SYSTEM_N_LEVELS_ADIABATIC);
+}
+
+
+enum solver_backend system_n_levels_default_backend(bool adiabatic)
+{
+    (void)adiabatic;
+    return SOLVER_BACKEND_SPARSE_NEWTON;
+}
+
+
+int __system_n_levels_eval_general(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, struct solver_stats *stats, enum system_n_levels_pressure_law law)
+{
+    if(!user_params || !result)
+        return -1;
+
+    struct system_n_levels_ctx *ctx = system_n_levels_ctx_alloc(system_n_levels_default_backend(law == SYSTEM_N_LEVELS_ADIABATIC));
+    if(!ctx)
+        return GSL_ENOMEM;
+
+    system_n_levels_ctx_set_stats(ctx,stats);
+    int status = __system_n_levels_ctx_eval_general(ctx,user_params,result,law);
+
+    system_n_levels_ctx_free(ctx);
+
+    return status;
+}
+
+
+int system_n_levels_eval(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result)
+{
+    return __system_n_levels_eval_general(user_params,result,NULL,SYSTEM_N_LEVELS_ISOTHERMAL);
+}
+
+
+int system_n_levels_adiabatic_eval(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result)
+{
+    return __system_n_levels_eval_general(user_params,result,NULL,SYSTEM_N_LEVELS_ADIABATIC);
+}
+
+
+int system_n_levels_eval_stats(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, struct solver_stats *stats)
+{
+    return __system_n_levels_eval_general(user_params,result,stats,SYSTEM_N_LEVELS_ISOTHERMAL);
+}
+
+
+int system_n_levels_adiabatic_eval_stats(const struct system_n_levels_user_params *user_params, struct system_n_levels_result *result, struct solver_stats *stats)
+{
+    return __system_n_levels_eval_general(user_params,result,stats,SYSTEM_N_LEVELS_ADIABATIC);
+}
+
+
+struct system_n_levels_continuation_data
+{
+    struct system_n_levels_user_params user_params;
+    enum system_n_levels_pressure_law law;
+    size_t param_offset;
+    struct system_n_levels sys;
+    int status;     // of the last rebuild of the stack
+
+    struct system_n_levels_branch *branch;
+};
+
+
+// Rebuilds the stack at lambda, its unknowns keep their positions
+void __system_n_levels_set_lambda(double lambda, void *data)
+{
+    struct system_n_levels_continuation_data *cont = (struct system_n_levels_continuation_data*)data;
+    *(double*)((char*)&cont->user_params + cont->param_offset) = lambda;
+
+    struct system_n_levels_topology topo;
+    cont->status = system_n_levels_stack(&cont->user_params,cont->law,&topo);
+    if(!cont->status)
+        cont->status = system_n_levels_assemble(&topo,&cont->sys);
+}
+
+
+int __system_n_levels_branch_emit(const gsl_vector *x, double lambda, size_t iters, void *data)
+{
+    struct system_n_levels_continuation_data *cont = (struct system_n_levels_continuation_data*)data;
+    // Points past a lambda the stack cannot be built at were solved on a stale one
+    if(cont->status)
+        return cont->status;
+
+    struct system_n_levels_branch *branch = cont->branch;
+    if(branch->n_points == branch->capacity)
+    {
+        size_t capacity = branch->capacity ? 2*branch->capacity : 64;
+        double *lambda_new = realloc(branch->lambda,capacity*sizeof(double));
+        size_t *iters_new = realloc(branch->iters,capacity*sizeof(size_t));
+        struct system_n_levels_result *results_new = realloc(branch->results,capacity*sizeof(struct system_n_levels_result));
+        if(lambda_new)
+            branch->lambda = lambda_new;
+        if(iters_new)
+            branch->iters = iters_new;
+        if(results_new)
+            branch->results = results_new;
+        if(!lambda_new || !iters_new || !results_new)
+            return GSL_ENOMEM;
+        branch->capacity = capacity;
+    }
+
+    branch->lambda[branch->n_points] = lambda;
+    branch->iters[branch->n_points] = iters;
+    system_n_levels_x_to_res(&cont->sys,x,&branch->results[branch->n_points]);
+    ++branch->n_points;
+
+    return GSL_SUCCESS;
+}
+
+
+int __system_n_levels_continuation_general(const struct system_n_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_n_levels_branch *branch, enum system_n_levels_pressure_law law)
+{
+    if(!user_params || !branch || param_offset < offsetof(struct system_n_levels_user_params,phi_left_0) ||
+       param_offset + sizeof(double) > sizeof(struct system_n_levels_user_params))
+        return -1;
+
+    branch->n_points = 0;
+    branch->capacity = 0;
+    branch->lambda = NULL;
+    branch->iters = NULL;
+    branch->results = NULL;
+
+    // Damped Newton is the most likely to converge from the cold start
+    struct system_n_levels_result start;
+    struct system_n_levels_ctx *ctx = system_n_levels_ctx_alloc(SOLVER_BACKEND_FIXED_NEWTON);
+    if(!ctx)
+        return GSL_ENOMEM;
+    int status = __system_n_levels_ctx_eval_general(ctx,user_params,&start,law);
+    system_n_levels_ctx_free(ctx);
+    if(status != GSL_SUCCESS)
+        return status;
+
+    struct system_n_levels_continuation_data *data = malloc(sizeof(struct system_n_levels_continuation_data));
+    if(!data)
+        return GSL_ENOMEM;
+    data->user_params = *user_params;
+    data->law = law;
+    data->param_offset = param_offset;
+    data->branch = branch;
+
+    struct continuation_problem problem;
+    problem.lambda_start = *(const double*)((const char*)user_params + param_offset);
+    problem.lambda_end = lambda_end;
+    __system_n_levels_set_lambda(problem.lambda_start,data);
+
+    const struct system_n_levels_kernels *kernels = system_n_levels_kernels(&data->sys);
+    problem.n = data->sys.n_eq;
+    problem.f = kernels->f;
+    problem.df = kernels->df;
+    problem.params = &data->sys;
+    problem.set_lambda = __system_n_levels_set_lambda;
+    problem.lambda_data = data;
+
+    gsl_vector *x_start = gsl_vector_alloc(problem.n);
+    if(x_start)
+    {
+        system_n_levels_res_to_x(&data->sys,&start,x_start);
+        status = continuation_run(&problem,x_start,opts,__system_n_levels_branch_emit,data);
+    }
+    else
+        status = GSL_ENOMEM;
+
+    gsl_vector_free(x_start);
+    free(data);
+
+    return status;
+}
+
+
+int system_n_levels_continuation(const struct system_n_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_n_levels_branch *branch)
+{
+    return __system_n_levels_continuation_general(user_params,param_offset,lambda_end,opts,branch,SYSTEM_N_LEVELS_ISOTHERMAL);
+}
+
+
+int system_n_levels_adiabatic_continuation(const struct system_n_levels_user_params *user_params, size_t param_offset, double lambda_end, const struct continuation_options *opts, struct system_n_levels_branch *branch)
+{
+    return __system_n_levels_continuation_general(user_params,param_offset,lambda_end,opts,branch,SYSTEM_N_LEVELS_ADIABATIC);
+}
+
+
+void system_n_levels_branch_free(struct system_n_levels_branch *branch)
+{
+    free(branch->lambda);
+    free(branch->iters);
+    free(branch->results);
+    branch->lambda = NULL;
+    branch->iters = NULL;
+    branch->results = NULL;
+    branch->n_points = 0;
+    branch->capacity = 0;
+}
@@ -0,0 +1,185 @@
+#include <equations/pool.h>
+#include <equations/batch.h>
+#include <gsl/gsl_errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+
+struct pool_job
+{
+    pool_job_t job;
+    pool_job_t release;
+    void *data;
+};
+
+
+// Ring buffer
+struct pool_queue
+{
+    struct pool_job *jobs;
+    size_t head, size;
+};
+
+
+struct pool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t capacity;
+    struct pool_queue queues[2];
+    atomic_size_t n_normal;
+    atomic_bool stopping;
+
+    size_t n_threads;
+    pthread_t *threads;
+};
+
+
+static bool __pool_pop(struct pool *pool, struct pool_job *job)
+{
+    for(size_t q = 0; q < 2; ++q)
+    {
+        struct pool_queue *queue = &pool->queues[q];
+        if(queue->size == 0)
+            continue;
+
+        *job = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % pool->capacity;
+        --queue->size;
+        if(q == POOL_PRIORITY_NORMAL)
+            atomic_fetch_sub(&pool->n_normal,1);
+        return true;
+    }
+
+    return false;
+}
+
+
+static void *__pool_worker(void *p)
+{
+    struct pool *pool = (struct pool*)p;
+
+    while(true)
+    {
+        struct pool_job job;
+        pthread_mutex_lock(&pool->lock);
+        while(!atomic_load(&pool->stopping) && !__pool_pop(pool,&job))
+            pthread_cond_wait(&pool->cond,&pool->lock);
+        const bool stop = atomic_load(&pool->stopping);
+        pthread_mutex_unlock(&pool->lock);
+
+        if(stop)
+            break;
+
+        job.job(job.data);
+        if(job.release)
+            job.release(job.data);
+    }
+
+    return NULL;
+}
+
+
+struct pool *pool_alloc(int nthreads, size_t capacity)
+{
+    if(capacity == 0)
+        return NULL;
+
+    struct pool *pool = calloc(1,sizeof(struct pool));
+    if(!pool)
+        return NULL;
+
+    pool->capacity = capacity;
+    pool->n_threads = nthreads > 0 ? (size_t)nthreads : (size_t)batch_default_threads();
+    pool->queues[0].jobs = malloc(capacity*sizeof(struct pool_job));
+    pool->queues[1].jobs = malloc(capacity*sizeof(struct pool_job));
+    pool->threads = malloc(pool->n_threads*sizeof(pthread_t));
+    if(!pool->queues[0].jobs || !pool->queues[1].jobs || !pool->threads)
+    {
+        free(pool->queues[0].jobs);
+        free(pool->queues[1].jobs);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock,NULL);
+    pthread_cond_init(&pool->cond,NULL);
+    atomic_init(&pool->n_normal,0);
+    atomic_init(&pool->stopping,false);
+
+    size_t started = 0;
+    for(; started < pool->n_threads; ++started)
+        if(pthread_create(&pool->threads[started],NULL,__pool_worker,pool))
+            break;
+    pool->n_threads = started;
+    if(started == 0)
+    {
+        pool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+
+void pool_free(struct pool *pool)
+{
+    if(!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->stopping,true);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(size_t t = 0; t < pool->n_threads; ++t)
+        pthread_join(pool->threads[t],NULL);
+
+    struct pool_job job;
+    while(__pool_pop(pool,&job))
+        if(job.release)
+            job.release(job.data);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->queues[0].jobs);
+    free(pool->queues[1].jobs);
+    free(pool->threads);
+    free(pool);
+}
+
+
+int pool_submit(struct pool *pool, enum pool_priority priority, pool_job_t job, pool_job_t release, void *data)
+{
+    if(!pool || !job || (priority != POOL_PRIORITY_NORMAL && priority != POOL_PRIORITY_IDLE))
+        return -1;
+
+    int status = GSL_EFAILED;
+    pthread_mutex_lock(&pool->lock);
+    struct pool_queue *queue = &pool->queues[priority];
+    if(!atomic_load(&pool->stopping) && queue->size < pool->capacity)
+    {
+        queue->jobs[(queue->head + queue->size) % pool->capacity] = (struct pool_job){job,release,data};
+        ++queue->size;
+        if(priority == POOL_PRIORITY_NORMAL)
+            atomic_fetch_add(&pool->n_normal,1);
+        pthread_cond_signal(&pool->cond);
+        status = GSL_SUCCESS;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return status;
+}
+
+
+bool pool_should_yield(struct pool *pool)
+{
+    return atomic_load(&pool->n_normal) > 0 || atomic_load(&pool->stopping);
+}
+
+
+bool pool_stopping(struct pool *pool)
+{
+    return atomic_load(&pool->stopping);
+}
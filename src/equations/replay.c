@@ -0,0 +1,360 @@
+#include <equations/replay.h>
+#include <gsl/gsl_errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct replay_model
+{
+    size_t user_params_size;
+    size_t result_size;
+
+    void *(*ctx_alloc)(enum solver_backend backend);
+    void (*ctx_free)(void *ctx);
+    void (*ctx_set_warm)(void *ctx, const void *warm);
+    void (*ctx_set_cancel)(void *ctx, solver_cancel_t cancelled, void *data);
+    size_t (*ctx_iterations)(const void *ctx);
+    int (*eval)(void *ctx, const void *user_params, void *result, bool adiabatic);
+};
+
+
+struct replay
+{
+    const struct replay_model *model;
+    void *ctx;
+    bool adiabatic;
+    struct replay_options opts;
+
+    size_t n_params, n_results;
+    size_t substeps;
+    size_t polls, budget;
+
+    // Last two equilibria, n_history of them are valid
+    size_t n_history;
+    double *params, *result;
+    double *params_prev, *result_prev;
+
+    double *params_sub, *result_sub, *warm;
+    double *params_mem, *result_mem;
+};
+
+
+static void *__replay_2_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_2_levels_ctx_alloc(backend);
+}
+
+static void __replay_2_levels_ctx_free(void *ctx)
+{
+    system_2_levels_ctx_free(ctx);
+}
+
+static void __replay_2_levels_ctx_set_warm(void *ctx, const void *warm)
+{
+    system_2_levels_ctx_set_warm(ctx,warm);
+}
+
+static void __replay_2_levels_ctx_set_cancel(void *ctx, solver_cancel_t cancelled, void *data)
+{
+    system_2_levels_ctx_set_cancel(ctx,cancelled,data);
+}
+
+static size_t __replay_2_levels_ctx_iterations(const void *ctx)
+{
+    return system_2_levels_ctx_iterations(ctx);
+}
+
+static int __replay_2_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_2_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_2_levels_ctx_eval(ctx,user_params,result);
+}
+
+
+static void *__replay_3_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_3_levels_ctx_alloc(backend);
+}
+
+static void __replay_3_levels_ctx_free(void *ctx)
+{
+    system_3_levels_ctx_free(ctx);
+}
+
+static void __replay_3_levels_ctx_set_warm(void *ctx, const void *warm)
+{
+    system_3_levels_ctx_set_warm(ctx,warm);
+}
+
+static void __replay_3_levels_ctx_set_cancel(void *ctx, solver_cancel_t cancelled, void *data)
+{
+    system_3_levels_ctx_set_cancel(ctx,cancelled,data);
+}
+
+static size_t __replay_3_levels_ctx_iterations(const void *ctx)
+{
+    return system_3_levels_ctx_iterations(ctx);
+}
+
+static int __replay_3_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_3_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_3_levels_ctx_eval(ctx,user_params,result);
+}
+
+
+static const struct replay_model __replay_2_levels = {
+    sizeof(struct system_2_levels_user_params), sizeof(struct system_2_levels_result),
+    __replay_2_levels_ctx_alloc, __replay_2_levels_ctx_free, __replay_2_levels_ctx_set_warm,
+    __replay_2_levels_ctx_set_cancel, __replay_2_levels_ctx_iterations, __replay_2_levels_eval
+};
+
+static const struct replay_model __replay_3_levels = {
+    sizeof(struct system_3_levels_user_params), sizeof(struct system_3_levels_result),
+    __replay_3_levels_ctx_alloc, __replay_3_levels_ctx_free, __replay_3_levels_ctx_set_warm,
+    __replay_3_levels_ctx_set_cancel, __replay_3_levels_ctx_iterations, __replay_3_levels_eval
+};
+
+
+void replay_default_options(struct replay_options *opts)
+{
+    opts->max_iters = 12;
+    opts->slow_iters = 5;
+    opts->max_substeps = 64;
+    opts->extrapolate = true;
+}
+
+
+// Iteration budget of a warm solve, polled by the solver before every
+// iteration. Also stops the cold retry of the context, which would
+// rather jump to another branch than follow this one
+static bool __replay_over_budget(void *data)
+{
+    struct replay *replay = (struct replay*)data;
+    return replay->polls++ >= replay->budget;
+}
+
+
+static struct replay *__replay_alloc(const struct replay_model *model, enum solver_backend backend, bool adiabatic, const struct replay_options *opts)
+{
+    struct replay *replay = calloc(1,sizeof(struct replay));
+    if(!replay)
+        return NULL;
+
+    replay->model = model;
+    replay->adiabatic = adiabatic;
+    if(opts)
+        replay->opts = *opts;
+    else
+        replay_default_options(&replay->opts);
+    if(replay->opts.max_substeps == 0)
+        replay->opts.max_substeps = 1;
+    replay->n_params = model->user_params_size/sizeof(double);
+    replay->n_results = model->result_size/sizeof(double);
+
+    replay->ctx = model->ctx_alloc(backend);
+    replay->params = replay->params_mem = malloc(3*model->user_params_size);
+    replay->result = replay->result_mem = malloc(4*model->result_size);
+    if(!replay->ctx || !replay->params_mem || !replay->result_mem)
+    {
+        replay_free(replay);
+        return NULL;
+    }
+    replay->params_prev = replay->params + replay->n_params;
+    replay->params_sub = replay->params_prev + replay->n_params;
+    replay->result_prev = replay->result + replay->n_results;
+    replay->result_sub = replay->result_prev + replay->n_results;
+    replay->warm = replay->result_sub + replay->n_results;
+
+    model->ctx_set_cancel(replay->ctx,__replay_over_budget,replay);
+    replay_reset(replay);
+
+    return replay;
+}
+
+
+struct replay *system_2_levels_replay_alloc(enum solver_backend backend, bool adiabatic, const struct replay_options *opts)
+{
+    return __replay_alloc(&__replay_2_levels,backend,adiabatic,opts);
+}
+
+
+struct replay *system_3_levels_replay_alloc(enum solver_backend backend, bool adiabatic, const struct replay_options *opts)
+{
+    return __replay_alloc(&__replay_3_levels,backend,adiabatic,opts);
+}
+
+
+void replay_free(struct replay *replay)
+{
+    if(!replay)
+        return;
+
+    if(replay->ctx)
+        replay->model->ctx_free(replay->ctx);
+    free(replay->params_mem);
+    free(replay->result_mem);
+    free(replay);
+}
+
+
+void replay_reset(struct replay *replay)
+{
+    if(!replay)
+        return;
+
+    replay->n_history = 0;
+    replay->substeps = 1;
+}
+
+
+// Without warm the context starts from the geometric initial guess, which
+// needs more than the budget of a warm solve
+static int __replay_solve(struct replay *replay, const double *params, const double *warm, double *result, size_t *iters)
+{
+    replay->polls = 0;
+    replay->budget = warm ? replay->opts.max_iters : SIZE_MAX;
+    replay->model->ctx_set_warm(replay->ctx,warm);
+
+    int status = replay->model->eval(replay->ctx,params,result,replay->adiabatic);
+    *iters += replay->model->ctx_iterations(replay->ctx);
+
+    return status == SOLVER_ECANCELLED ? GSL_EMAXITER : status;
+}
+
+
+// Secant through the last two equilibria, scaled by the projection of the
+// new step on the last one. Params are compared relative to their size
+static void __replay_predict(const struct replay *replay, const double *params, double *warm)
+{
+    double dot = 0, norm = 0;
+    for(size_t i = 0; i < replay->n_params; ++i)
+    {
+        const double scale = 1 + fabs(replay->params[i]);
+        const double step = (params[i] - replay->params[i])/scale;
+        const double step_prev = (replay->params[i] - replay->params_prev[i])/scale;
+        dot += step*step_prev;
+        norm += step_prev*step_prev;
+    }
+    const double s = norm > 0 ? fmin(fmax(dot/norm,-2),2) : 0;
+
+    for(size_t j = 0; j < replay->n_results; ++j)
+        warm[j] = replay->result[j] + s*(replay->result[j] - replay->result_prev[j]);
+}
+
+
+static void __replay_push(struct replay *replay, const double *params, const double *result)
+{
+    double *p = replay->params_prev, *r = replay->result_prev;
+    replay->params_prev = replay->params;
+    replay->result_prev = replay->result;
+    replay->params = p;
+    replay->result = r;
+    memcpy(replay->params,params,replay->n_params*sizeof(double));
+    memcpy(replay->result,result,replay->n_results*sizeof(double));
+    if(replay->n_history < 2)
+        ++replay->n_history;
+}
+
+
+static int __replay_step(struct replay *replay, const double *target, double *out, struct replay_step_info *info)
+{
+    const struct replay_options *opts = &replay->opts;
+    size_t iters = 0;
+    size_t k = 1;
+    int status;
+
+    if(replay->n_history == 0)
+        status = __replay_solve(replay,target,NULL,replay->result_sub,&iters);
+    else if(!memcmp(target,replay->params,replay->n_params*sizeof(double)))
+    {
+        // Logs repeat values a lot, nothing to solve then
+        memcpy(replay->result_sub,replay->result,replay->n_results*sizeof(double));
+        status = GSL_SUCCESS;
+    }
+    else
+    {
+        k = replay->substeps;
+        bool slow;
+        while(true)
+        {
+            status = GSL_SUCCESS;
+            slow = false;
+            memcpy(replay->warm,replay->result,replay->n_results*sizeof(double));
+            for(size_t j = 1; j <= k && status == GSL_SUCCESS; ++j)
+            {
+                const double lambda = (double)j/k;
+                for(size_t i = 0; i < replay->n_params; ++i)
+                    replay->params_sub[i] = j == k ? target[i] : replay->params[i] + (target[i] - replay->params[i])*lambda;
+                if(k == 1 && opts->extrapolate && replay->n_history == 2)
+                    __replay_predict(replay,replay->params_sub,replay->warm);
+
+                size_t sub_iters = 0;
+                status = __replay_solve(replay,replay->params_sub,replay->warm,replay->result_sub,&sub_iters);
+                iters += sub_iters;
+                if(status == GSL_SUCCESS)
+                    memcpy(replay->warm,replay->result_sub,replay->n_results*sizeof(double));
+                slow = slow || sub_iters > opts->slow_iters;
+            }
+
+            if(status == GSL_SUCCESS || 2*k > opts->max_substeps)
+                break;
+            k *= 2;
+        }
+
+        // Refine ahead of slow convergence, coarsen again once it is fast
+        if(status != GSL_SUCCESS || k > replay->substeps)
+            replay->substeps = k;
+        else if(slow)
+            replay->substeps = MIN(2*k,opts->max_substeps);
+        else if(k > 1)
+            replay->substeps = k/2;
+    }
+
+    if(status == GSL_SUCCESS)
+    {
+        __replay_push(replay,target,replay->result_sub);
+        memcpy(out,replay->result_sub,replay->n_results*sizeof(double));
+    }
+    else if(replay->n_history > 0)
+        // Last equilibrium on the way, the warm start of a single step may be the prediction
+        memcpy(out,k == 1 ? replay->result : replay->warm,replay->n_results*sizeof(double));
+    else
+        memcpy(out,replay->result_sub,replay->n_results*sizeof(double));
+
+    if(info)
+    {
+        info->status = status;
+        info->substeps = k;
+        info->iterations = iters;
+    }
+
+    return status;
+}
+
+
+static int __replay_model_step(struct replay *replay, const struct replay_model *model, const void *user_params, void *result, struct replay_step_info *info)
+{
+    if(!replay || !user_params || !result)
+        return -1;
+    if(replay->model != model)
+        return GSL_EINVAL;
+
+    return __replay_step(replay,user_params,result,info);
+}
+
+
+int system_2_levels_replay_step(struct replay *replay, const struct system_2_levels_user_params *user_params, struct system_2_levels_result *result, struct replay_step_info *info)
+{
+    return __replay_model_step(replay,&__replay_2_levels,user_params,result,info);
+}
+
+
+int system_3_levels_replay_step(struct replay *replay, const struct system_3_levels_user_params *user_params, struct system_3_levels_result *result, struct replay_step_info *info)
+{
+    return __replay_model_step(replay,&__replay_3_levels,user_params,result,info);
+}
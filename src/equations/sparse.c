@@ -0,0 +1,527 @@
+#include <equations/sparse.h>
+#include <gsl/gsl_multiroots.h>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_math.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct sparse_matrix *sparse_matrix_alloc(size_t n, const char *pattern)
+{
+    size_t nnz = 0;
+    for(size_t i = 0; i < n*n; ++i)
+        if(pattern[i])
+            ++nnz;
+
+    struct sparse_matrix *m = malloc(sizeof(struct sparse_matrix));
+    if(!m)
+        return NULL;
+    m->n = n;
+    m->nnz = nnz;
+    m->row_ptr = malloc((n+1)*sizeof(size_t));
+    m->col_idx = malloc(nnz*sizeof(size_t));
+    m->values = calloc(nnz,sizeof(double));
+    if(!m->row_ptr || !m->col_idx || !m->values)
+    {
+        sparse_matrix_free(m);
+        return NULL;
+    }
+
+    size_t p = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        m->row_ptr[i] = p;
+        for(size_t j = 0; j < n; ++j)
+            if(pattern[i*n+j])
+                m->col_idx[p++] = j;
+    }
+    m->row_ptr[n] = p;
+
+    return m;
+}
+
+
+void sparse_matrix_free(struct sparse_matrix *m)
+{
+    if(!m)
+        return;
+    free(m->row_ptr);
+    free(m->col_idx);
+    free(m->values);
+    free(m);
+}
+
+
+struct sparse_lu *sparse_lu_alloc(size_t n)
+{
+    struct sparse_lu *lu = calloc(1,sizeof(struct sparse_lu));
+    if(!lu)
+        return NULL;
+    lu->n = n;
+    lu->perm = malloc(n*sizeof(size_t));
+    lu->diag = malloc(n*sizeof(size_t));
+    lu->row_ptr = malloc((n+1)*sizeof(size_t));
+    lu->work = malloc(n*sizeof(double));
+    if(!lu->perm || !lu->diag || !lu->row_ptr || !lu->work)
+    {
+        sparse_lu_free(lu);
+        return NULL;
+    }
+    lu->analysed = false;
+
+    return lu;
+}
+
+
+void sparse_lu_free(struct sparse_lu *lu)
+{
+    if(!lu)
+        return;
+    free(lu->perm);
+    free(lu->diag);
+    free(lu->row_ptr);
+    free(lu->col_idx);
+    free(lu->values);
+    free(lu->work);
+    free(lu);
+}
+
+
+// Active part of a row of the pivot search, columns sorted
+struct __sparse_row
+{
+    size_t len, cap;
+    size_t *col;
+    double *val;
+};
+
+
+static int __sparse_row_reserve(struct __sparse_row *row, size_t len)
+{
+    if(len <= row->cap)
+        return GSL_SUCCESS;
+
+    const size_t cap = GSL_MAX(len,2*row->cap);
+    size_t *col = realloc(row->col,cap*sizeof(size_t));
+    if(col)
+        row->col = col;
+    double *val = realloc(row->val,cap*sizeof(double));
+    if(val)
+        row->val = val;
+    if(!col || !val)
+        return GSL_ENOMEM;
+    row->cap = cap;
+
+    return GSL_SUCCESS;
+}
+
+
+// Row order by threshold pivoting on the values of A, eliminated on sparse
+// rows: the pivot of column k is the sparsest remaining row whose entry in it
+// is within a factor of the largest one. Columns keep their order, so this is
+// the Markowitz choice among the acceptable rows
+static int __sparse_lu_pivot_order(struct sparse_lu *lu, const struct sparse_matrix *A)
+{
+    const double threshold = 0.1;
+    const size_t n = lu->n;
+    int status = GSL_ENOMEM;
+
+    struct __sparse_row *rows = calloc(n,sizeof(struct __sparse_row));
+    size_t *active = malloc(n*sizeof(size_t));
+    size_t *col = malloc(n*sizeof(size_t));
+    double *val = malloc(n*sizeof(double));
+    if(!rows || !active || !col || !val)
+        goto cleanup;
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        const size_t len = A->row_ptr[i+1] - A->row_ptr[i];
+        if(__sparse_row_reserve(&rows[i],GSL_MAX(len,1)))
+            goto cleanup;
+        memcpy(rows[i].col,A->col_idx + A->row_ptr[i],len*sizeof(size_t));
+        memcpy(rows[i].val,A->values + A->row_ptr[i],len*sizeof(double));
+        rows[i].len = len;
+        active[i] = i;
+    }
+
+    // Columns before k are eliminated, a row holds column k iff it leads it
+    size_t n_active = n;
+    for(size_t k = 0; k < n; ++k)
+    {
+        double col_max = 0;
+        for(size_t a = 0; a < n_active; ++a)
+        {
+            const struct __sparse_row *row = &rows[active[a]];
+            if(row->len && row->col[0] == k)
+                col_max = GSL_MAX(col_max,fabs(row->val[0]));
+        }
+
+        size_t best = n_active;
+        for(size_t a = 0; a < n_active; ++a)
+        {
+            const struct __sparse_row *row = &rows[active[a]];
+            if(!row->len || row->col[0] != k || fabs(row->val[0]) < threshold*col_max)
+                continue;
+            if(best == n_active || row->len < rows[active[best]].len ||
+               (row->len == rows[active[best]].len && fabs(row->val[0]) > fabs(rows[active[best]].val[0])))
+                best = a;
+        }
+
+        // Structurally singular, the zero pivot is left to the factorization
+        if(best == n_active)
+        {
+            best = 0;
+            struct __sparse_row *row = &rows[active[0]];
+            if(__sparse_row_reserve(row,row->len + 1))
+                goto cleanup;
+            memmove(row->col + 1,row->col,row->len*sizeof(size_t));
+            memmove(row->val + 1,row->val,row->len*sizeof(double));
+            row->col[0] = k;
+            row->val[0] = 0;
+            ++row->len;
+        }
+
+        const struct __sparse_row *pivot = &rows[active[best]];
+        lu->perm[k] = active[best];
+        active[best] = active[--n_active];
+
+        for(size_t a = 0; a < n_active; ++a)
+        {
+            struct __sparse_row *row = &rows[active[a]];
+            if(!row->len || row->col[0] != k)
+                continue;
+
+            // Fill is structural, cancelled entries stay in the pattern
+            const double l = pivot->val[0] != 0 ? row->val[0]/pivot->val[0] : 0;
+            size_t len = 0, p = 1, q = 1;
+            while(p < row->len || q < pivot->len)
+            {
+                if(q == pivot->len || (p < row->len && row->col[p] < pivot->col[q]))
+                {
+                    col[len] = row->col[p];
+                    val[len++] = row->val[p++];
+                }
+                else if(p == row->len || pivot->col[q] < row->col[p])
+                {
+                    col[len] = pivot->col[q];
+                    val[len++] = -l*pivot->val[q++];
+                }
+                else
+                {
+                    col[len] = row->col[p];
+                    val[len++] = row->val[p++] - l*pivot->val[q++];
+                }
+            }
+
+            if(__sparse_row_reserve(row,len))
+                goto cleanup;
+            memcpy(row->col,col,len*sizeof(size_t));
+            memcpy(row->val,val,len*sizeof(double));
+            row->len = len;
+        }
+    }
+    status = GSL_SUCCESS;
+
+cleanup:
+    if(rows)
+        for(size_t i = 0; i < n; ++i)
+        {
+            free(rows[i].col);
+            free(rows[i].val);
+        }
+    free(rows);
+    free(active);
+    free(col);
+    free(val);
+
+    return status;
+}
+
+
+// Row order from __sparse_lu_pivot_order, fill pattern from symbolic
+// row-by-row elimination of P*A in that order
+int sparse_lu_analyse(struct sparse_lu *lu, const struct sparse_matrix *A)
+{
+    const size_t n = lu->n;
+    lu->analysed = false;
+
+    int status = __sparse_lu_pivot_order(lu,A);
+    if(status)
+        return status;
+
+    // mark[j] == i+1 while row i holds column j
+    size_t *mark = calloc(n,sizeof(size_t));
+    size_t cap = A->nnz + n;
+    size_t *col_idx = realloc(lu->col_idx,cap*sizeof(size_t));
+    if(col_idx)
+        lu->col_idx = col_idx;
+    if(!mark || !col_idx)
+    {
+        free(mark);
+        return GSL_ENOMEM;
+    }
+
+    size_t nnz = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        lu->row_ptr[i] = nnz;
+        const size_t src = lu->perm[i];
+        for(size_t q = A->row_ptr[src]; q < A->row_ptr[src+1]; ++q)
+            mark[A->col_idx[q]] = i+1;
+        mark[i] = i+1;
+        for(size_t k = 0; k < i; ++k)
+        {
+            if(mark[k] != i+1)
+                continue;
+            for(size_t q = lu->diag[k]+1; q < lu->row_ptr[k+1]; ++q)
+                mark[lu->col_idx[q]] = i+1;
+        }
+
+        for(size_t j = 0; j < n; ++j)
+        {
+            if(mark[j] != i+1)
+                continue;
+            if(nnz == cap)
+            {
+                cap *= 2;
+                col_idx = realloc(lu->col_idx,cap*sizeof(size_t));
+                if(!col_idx)
+                {
+                    free(mark);
+                    return GSL_ENOMEM;
+                }
+                lu->col_idx = col_idx;
+            }
+            if(j == i)
+                lu->diag[i] = nnz;
+            lu->col_idx[nnz++] = j;
+        }
+    }
+    lu->row_ptr[n] = nnz;
+    free(mark);
+
+    double *values = realloc(lu->values,nnz*sizeof(double));
+    if(!values)
+        return GSL_ENOMEM;
+    lu->values = values;
+    lu->nnz = nnz;
+    lu->analysed = true;
+
+    return GSL_SUCCESS;
+}
+
+
+// GSL_ESING means the stored row order no longer fits the values,
+// analyse again to repivot
+int sparse_lu_factorize(struct sparse_lu *lu, const struct sparse_matrix *A)
+{
+    const size_t n = lu->n;
+    double *w = lu->work;
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        for(size_t p = lu->row_ptr[i]; p < lu->row_ptr[i+1]; ++p)
+            w[lu->col_idx[p]] = 0;
+        size_t src = lu->perm[i];
+        double row_max = 0;
+        for(size_t q = A->row_ptr[src]; q < A->row_ptr[src+1]; ++q)
+        {
+            w[A->col_idx[q]] = A->values[q];
+            row_max = GSL_MAX(row_max,fabs(A->values[q]));
+        }
+
+        for(size_t p = lu->row_ptr[i]; p < lu->diag[i]; ++p)
+        {
+            size_t k = lu->col_idx[p];
+            double l = w[k]/lu->values[lu->diag[k]];
+            w[k] = l;
+            for(size_t q = lu->diag[k]+1; q < lu->row_ptr[k+1]; ++q)
+                w[lu->col_idx[q]] -= l*lu->values[q];
+        }
+
+        for(size_t p = lu->row_ptr[i]; p < lu->row_ptr[i+1]; ++p)
+            lu->values[p] = w[lu->col_idx[p]];
+
+        double pivot = lu->values[lu->diag[i]];
+        if(!gsl_finite(pivot) || fabs(pivot) <= 1e-10*row_max)
+            return GSL_ESING;
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+int sparse_lu_solve(const struct sparse_lu *lu, const gsl_vector *b, gsl_vector *x)
+{
+    const size_t n = lu->n;
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        double s = gsl_vector_get(b,lu->perm[i]);
+        for(size_t p = lu->row_ptr[i]; p < lu->diag[i]; ++p)
+            s -= lu->values[p]*gsl_vector_get(x,lu->col_idx[p]);
+        gsl_vector_set(x,i,s);
+    }
+
+    for(size_t i = n; i-- > 0;)
+    {
+        double s = gsl_vector_get(x,i);
+        for(size_t p = lu->diag[i]+1; p < lu->row_ptr[i+1]; ++p)
+            s -= lu->values[p]*gsl_vector_get(x,lu->col_idx[p]);
+        gsl_vector_set(x,i,s/lu->values[lu->diag[i]]);
+    }
+
+    return GSL_SUCCESS;
+}
+
+
+struct sparse_newton_workspace *sparse_newton_alloc(size_t n)
+{
+    struct sparse_newton_workspace *ws = calloc(1,sizeof(struct sparse_newton_workspace));
+    if(!ws)
+        return NULL;
+    ws->n = n;
+    ws->pattern = malloc(n*n);
+    ws->J = NULL;
+    ws->lu = sparse_lu_alloc(n);
+    ws->f = gsl_vector_alloc(n);
+    ws->f_trial = gsl_vector_alloc(n);
+    ws->x_trial = gsl_vector_alloc(n);
+    ws->dx = gsl_vector_alloc(n);
+    if(!ws->pattern || !ws->lu || !ws->f || !ws->f_trial || !ws->x_trial || !ws->dx)
+    {
+        sparse_newton_free(ws);
+        return NULL;
+    }
+
+    return ws;
+}
+
+
+void sparse_newton_free(struct sparse_newton_workspace *ws)
+{
+    if(!ws)
+        return;
+    free(ws->pattern);
+    sparse_matrix_free(ws->J);
+    sparse_lu_free(ws->lu);
+    if(ws->f)
+        gsl_vector_free(ws->f);
+    if(ws->f_trial)
+        gsl_vector_free(ws->f_trial);
+    if(ws->x_trial)
+        gsl_vector_free(ws->x_trial);
+    if(ws->dx)
+        gsl_vector_free(ws->dx);
+    free(ws);
+}
+
+
+void sparse_newton_reset(struct sparse_newton_workspace *ws)
+{
+    sparse_matrix_free(ws->J);
+    ws->J = NULL;
+    ws->lu->analysed = false;
+}
+
+
+// Evaluates J at x into the CSR values and refactorises it. The pattern is
+// the set of entries the kernel writes plus the diagonal, recorded once
+static int __sparse_newton_jacobian(struct sparse_newton_workspace *ws, solver_jac_t jac, void *params, const gsl_vector *x)
+{
+    const size_t n = ws->n;
+    int status;
+
+    if(!ws->J)
+    {
+        memset(ws->pattern,0,n*n);
+        for(size_t i = 0; i < n; ++i)
+            ws->pattern[i*n+i] = 1;
+        struct jacobian record = {NULL,n,NULL,NULL,NULL,ws->pattern,0};
+        jac(x,params,&record);
+
+        ws->J = sparse_matrix_alloc(n,ws->pattern);
+        if(!ws->J)
+            return GSL_ENOMEM;
+        ws->lu->analysed = false;
+    }
+
+    struct jacobian J = {NULL,n,ws->J->row_ptr,ws->J->col_idx,ws->J->values,NULL,0};
+    jac(x,params,&J);
+
+    if(ws->lu->analysed && sparse_lu_factorize(ws->lu,ws->J) == GSL_SUCCESS)
+        return GSL_SUCCESS;
+
+    status = sparse_lu_analyse(ws->lu,ws->J);
+    if(status)
+        return status;
+
+    return sparse_lu_factorize(ws->lu,ws->J);
+}
+
+
+// Newton with backtracking on 0.5*|f|^2
+int sparse_newton_solve(struct sparse_newton_workspace *ws, gsl_solver_f_t f, solver_jac_t jac, void *params, gsl_vector *x, size_t max_iters, double eps, size_t *iters, const struct solver_cancel *cancel)
+{
+    size_t iter = 0;
+    int status;
+
+    f(x,params,ws->f);
+    double norm = gsl_blas_dnrm2(ws->f);
+    if(!gsl_finite(norm))
+        status = GSL_EBADFUNC;
+    else
+        status = gsl_multiroot_test_residual(ws->f,eps);
+
+    while(status == GSL_CONTINUE && iter < max_iters)
+    {
+        if(solver_cancelled(cancel))
+        {
+            status = SOLVER_ECANCELLED;
+            break;
+        }
+
+        status = __sparse_newton_jacobian(ws,jac,params,x);
+        if(status)
+            break;
+
+        sparse_lu_solve(ws->lu,ws->f,ws->dx);
+        gsl_vector_scale(ws->dx,-1);
+
+        const double phi_0 = 0.5*norm*norm;
+        double t = 1;
+        double norm_trial;
+        while(true)
+        {
+            gsl_vector_memcpy(ws->x_trial,x);
+            gsl_blas_daxpy(t,ws->dx,ws->x_trial);
+            f(ws->x_trial,params,ws->f_trial);
+            norm_trial = gsl_blas_dnrm2(ws->f_trial);
+            if(gsl_finite(norm_trial) && 0.5*norm_trial*norm_trial <= (1 - 2e-4*t)*phi_0)
+                break;
+            if(t < 1e-4)
+                break;
+            t /= 2;
+        }
+        if(!gsl_finite(norm_trial))
+        {
+            status = GSL_EBADFUNC;
+            break;
+        }
+
+        gsl_vector_memcpy(x,ws->x_trial);
+        gsl_vector_memcpy(ws->f,ws->f_trial);
+        norm = norm_trial;
+        ++iter;
+
+        status = gsl_multiroot_test_residual(ws->f,eps);
+    }
+    if(status == GSL_CONTINUE)
+        status = GSL_EMAXITER;
+
+    if(iters)
+        *iters = iter;
+
+    return status;
+}
@@ -0,0 +1,139 @@
+#include <equations/table.h>
+#include <gsl/gsl_errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+
+static const char __table_magic[8] = "CWTABLE";
+
+
+struct table_writer
+{
+    FILE *stream;
+    off_t start;                // -1 when the stream cannot seek
+    size_t n_columns;
+    uint64_t n_rows;
+    bool failed;
+};
+
+
+static struct table_writer *__table_writer_alloc(FILE *stream, uint32_t model, const char *(*name)(const void *names, size_t i), const void *names, size_t n_columns)
+{
+    if(!stream || !names || n_columns == 0 || n_columns > (UINT32_MAX - sizeof(struct table_header))/TABLE_NAME_SIZE)
+        return NULL;
+
+    for(size_t i = 0; i < n_columns; ++i)
+        if(strlen(name(names,i)) >= TABLE_NAME_SIZE)
+            return NULL;
+
+    struct table_writer *writer = malloc(sizeof(struct table_writer));
+    if(!writer)
+        return NULL;
+
+    writer->stream = stream;
+    writer->start = ftello(stream);
+    writer->n_columns = n_columns;
+    writer->n_rows = 0;
+    writer->failed = false;
+
+    struct table_header header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,__table_magic,sizeof(header.magic));
+    header.version = TABLE_VERSION;
+    header.model = model;
+    header.n_columns = n_columns;
+    header.header_size = sizeof(struct table_header) + n_columns*TABLE_NAME_SIZE;
+    header.n_rows = TABLE_ROWS_UNKNOWN;
+
+    bool ok = fwrite(&header,sizeof(header),1,stream) == 1;
+    for(size_t i = 0; i < n_columns && ok; ++i)
+    {
+        char padded[TABLE_NAME_SIZE];
+        memset(padded,0,sizeof(padded));
+        strcpy(padded,name(names,i));
+        ok = fwrite(padded,sizeof(padded),1,stream) == 1;
+    }
+    if(!ok)
+    {
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+
+static const char *__table_name_array(const void *names, size_t i)
+{
+    return ((const char *const*)names)[i];
+}
+
+
+static const char *__table_name_field(const void *names, size_t i)
+{
+    return ((const struct field_desc*)names)[i].name;
+}
+
+
+struct table_writer *table_writer_alloc(FILE *stream, uint32_t model, const char *const *names, size_t n_columns)
+{
+    return __table_writer_alloc(stream,model,__table_name_array,names,n_columns);
+}
+
+
+struct table_writer *table_writer_alloc_fields(FILE *stream, uint32_t model, const struct field_desc *fields, size_t n_fields)
+{
+    return __table_writer_alloc(stream,model,__table_name_field,fields,n_fields);
+}
+
+
+int table_writer_append(struct table_writer *writer, const double *rows, size_t n_rows)
+{
+    if(!writer || (!rows && n_rows))
+        return -1;
+
+    if(fwrite(rows,writer->n_columns*sizeof(double),n_rows,writer->stream) != n_rows)
+    {
+        writer->failed = true;
+        return GSL_EFAILED;
+    }
+    writer->n_rows += n_rows;
+
+    return GSL_SUCCESS;
+}
+
+
+int table_writer_append_fields(struct table_writer *writer, const struct field_desc *fields, const void *record)
+{
+    if(!writer || !fields || !record)
+        return -1;
+
+    double row[writer->n_columns];
+    for(size_t i = 0; i < writer->n_columns; ++i)
+        row[i] = *(const double*)((const unsigned char*)record + fields[i].offset);
+
+    return table_writer_append(writer,row,1);
+}
+
+
+int table_writer_close(struct table_writer *writer)
+{
+    if(!writer)
+        return -1;
+
+    bool ok = !writer->failed && fflush(writer->stream) == 0;
+    if(ok && writer->start >= 0)
+    {
+        const off_t end = ftello(writer->stream);
+        if(end >= 0 && !fseeko(writer->stream,writer->start + offsetof(struct table_header,n_rows),SEEK_SET))
+        {
+            ok = fwrite(&writer->n_rows,sizeof(writer->n_rows),1,writer->stream) == 1;
+            ok = !fseeko(writer->stream,end,SEEK_SET) && ok;
+            ok = fflush(writer->stream) == 0 && ok;
+        }
+    }
+    free(writer);
+
+    return ok ? GSL_SUCCESS : GSL_EFAILED;
+}
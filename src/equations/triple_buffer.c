@@ -0,0 +1,77 @@
+#include <equations/triple_buffer.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Index of the middle slot in the low bits, set when the writer put there
+// a value the reader has not taken yet
+#define TRIPLE_BUFFER_DIRTY 4u
+
+
+struct triple_buffer
+{
+    size_t size;
+    unsigned char *slots;
+
+    atomic_uint middle;
+    unsigned back;      // owned by the writer
+    unsigned front;     // owned by the reader
+};
+
+
+struct triple_buffer *triple_buffer_alloc(size_t size, const void *init)
+{
+    struct triple_buffer *tb = malloc(sizeof(struct triple_buffer));
+    if(!tb)
+        return NULL;
+
+    tb->size = size;
+    tb->slots = calloc(3,size ? size : 1);
+    if(!tb->slots)
+    {
+        free(tb);
+        return NULL;
+    }
+    if(init)
+        for(size_t i = 0; i < 3; ++i)
+            memcpy(tb->slots + i*size,init,size);
+
+    tb->front = 0;
+    atomic_init(&tb->middle,1);
+    tb->back = 2;
+
+    return tb;
+}
+
+
+void triple_buffer_free(struct triple_buffer *tb)
+{
+    if(!tb)
+        return;
+    free(tb->slots);
+    free(tb);
+}
+
+
+void triple_buffer_publish(struct triple_buffer *tb, const void *value)
+{
+    memcpy(tb->slots + tb->back*tb->size,value,tb->size);
+    unsigned old = atomic_exchange_explicit(&tb->middle,tb->back | TRIPLE_BUFFER_DIRTY,memory_order_acq_rel);
+    tb->back = old & ~TRIPLE_BUFFER_DIRTY;
+}
+
+
+const void *triple_buffer_acquire(struct triple_buffer *tb, bool *fresh)
+{
+    const bool dirty = atomic_load_explicit(&tb->middle,memory_order_relaxed) & TRIPLE_BUFFER_DIRTY;
+    if(dirty)
+    {
+        unsigned old = atomic_exchange_explicit(&tb->middle,tb->front,memory_order_acq_rel);
+        tb->front = old & ~TRIPLE_BUFFER_DIRTY;
+    }
+    if(fresh)
+        *fresh = dirty;
+
+    return tb->slots + tb->front*tb->size;
+}
@@ -4,40 +4,39 @@
 #include <gsl/gsl_sf.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 
-inline gsl_vector *vector_centred(const gsl_vector *v, const gsl_vector *center)
+const struct field_desc *field_find(const struct field_desc *fields, size_t n_fields, const char *name)
 {
-    gsl_vector *res = gsl_vector_alloc(2);
-    gsl_vector_memcpy(res,v);
-    gsl_vector_sub(res,center);
-    return res;
+    for(size_t i = 0; i < n_fields; ++i)
+        if(!strcmp(fields[i].name,name))
+            return &fields[i];
+
+    return NULL;
+}
+
+
+void vector_centred(const gsl_vector *v, const gsl_vector *center, gsl_vector *res)
+{
+    gsl_vector_set(res,0,gsl_vector_get(v,0) - gsl_vector_get(center,0));
+    gsl_vector_set(res,1,gsl_vector_get(v,1) - gsl_vector_get(center,1));
 }
 
 
 int center_from_points_and_radius(const gsl_vector *p1, const gsl_vector *p2, double r, gsl_vector *center)
 {
-    gsl_vector *v12 = vector_centred(p1,p2);
-    gsl_vector_scale(v12,0.5);
-    double x = gsl_vector_get(v12,0);
-    double y = gsl_vector_get(v12,1);
-    if(x > 0)
-    {
-        gsl_vector_set(center,0,y);
-        gsl_vector_set(center,1,-x);
-    }
-    else
-    {
-        gsl_vector_set(center,0,-y);
-        gsl_vector_set(center,1,x);
-    }
-    double rv_norm = gsl_blas_dnrm2(center);
-    double target_norm = sqrt(gsl_pow_2(r) - gsl_pow_2(rv_norm));
-    gsl_vector_scale(center,target_norm/rv_norm);
-    gsl_vector_add(center,p2);
-    gsl_vector_add(center,v12);
+    // Half of the chord p2 -> p1, the centre lies on its perpendicular
+    const double x = 0.5*(gsl_vector_get(p1,0) - gsl_vector_get(p2,0));
+    const double y = 0.5*(gsl_vector_get(p1,1) - gsl_vector_get(p2,1));
+    double cx = x > 0 ? y : -y;
+    double cy = x > 0 ? -x : x;
 
-    gsl_vector_free(v12);
+    const double rv_norm = hypot(cx,cy);
+    const double scale = sqrt(gsl_pow_2(r) - gsl_pow_2(rv_norm))/rv_norm;
+    gsl_vector_set(center,0,cx*scale + gsl_vector_get(p2,0) + x);
+    gsl_vector_set(center,1,cy*scale + gsl_vector_get(p2,1) + y);
 
     return GSL_SUCCESS;
 }
@@ -81,6 +80,115 @@ inline double area_segment(double ang, double r)
 }
 
 
+// Green's theorem over the boundary: an arc contributes the triangle
+// spanned by its chord with the origin plus its circular segment, which
+// adds up to r*(cx*dsin + cy*dcos)/2 minus the sector area. Chords joining
+// consecutive arcs close the polygon through the endpoints
+double chamber_area(const struct chamber_arc *arcs, size_t n_arcs, struct chamber_arc_grad *grad)
+{
+    double sin_0[n_arcs], cos_0[n_arcs], sin_1[n_arcs], cos_1[n_arcs];
+    double S = 0.0;
+    for(size_t i = 0; i < n_arcs; ++i)
+    {
+        const struct chamber_arc *arc = &arcs[i];
+        const double ang_0 = arc->a + arc->alpha*arc->phi;
+        const double ang_1 = ang_0 + arc->beta*arc->phi;
+        sin_0[i] = gsl_sf_sin(ang_0);
+        cos_0[i] = gsl_sf_cos(ang_0);
+        sin_1[i] = gsl_sf_sin(ang_1);
+        cos_1[i] = gsl_sf_cos(ang_1);
+
+        S += arc->r*(arc->cx*(sin_1[i]-sin_0[i]) + arc->cy*(cos_1[i]-cos_0[i]))/2;
+        S -= area_segment(arc->beta*arc->phi,arc->r);
+    }
+    for(size_t i = 0; i < n_arcs; ++i)
+    {
+        const size_t j = (i+1) % n_arcs;
+        const double x_end = arcs[i].cx - arcs[i].r*cos_1[i];
+        const double y_end = arcs[i].cy + arcs[i].r*sin_1[i];
+        const double x_start = arcs[j].cx - arcs[j].r*cos_0[j];
+        const double y_start = arcs[j].cy + arcs[j].r*sin_0[j];
+        S += (x_end*y_start - y_end*x_start)/2;
+    }
+
+    if(grad)
+    {
+        // Partials by the arc parameters and by its start and end angles
+        double d_cx[n_arcs], d_cy[n_arcs], d_r[n_arcs], d_ang_0[n_arcs], d_ang_1[n_arcs];
+        for(size_t i = 0; i < n_arcs; ++i)
+        {
+            const struct chamber_arc *arc = &arcs[i];
+            d_cx[i] = arc->r*(sin_1[i]-sin_0[i])/2;
+            d_cy[i] = arc->r*(cos_1[i]-cos_0[i])/2;
+            d_r[i] = (arc->cx*(sin_1[i]-sin_0[i]) + arc->cy*(cos_1[i]-cos_0[i]))/2 - arc->r*arc->beta*arc->phi;
+            d_ang_0[i] = (gsl_pow_2(arc->r) - arc->r*(arc->cx*cos_0[i] - arc->cy*sin_0[i]))/2;
+            d_ang_1[i] = (arc->r*(arc->cx*cos_1[i] - arc->cy*sin_1[i]) - gsl_pow_2(arc->r))/2;
+        }
+        for(size_t i = 0; i < n_arcs; ++i)
+        {
+            const size_t j = (i+1) % n_arcs;
+            const double x_end = arcs[i].cx - arcs[i].r*cos_1[i];
+            const double y_end = arcs[i].cy + arcs[i].r*sin_1[i];
+            const double x_start = arcs[j].cx - arcs[j].r*cos_0[j];
+            const double y_start = arcs[j].cy + arcs[j].r*sin_0[j];
+
+            const double dx_end = y_start/2, dy_end = -x_start/2;
+            d_cx[i] += dx_end;
+            d_cy[i] += dy_end;
+            d_r[i] += -dx_end*cos_1[i] + dy_end*sin_1[i];
+            d_ang_1[i] += arcs[i].r*(dx_end*sin_1[i] + dy_end*cos_1[i]);
+
+            const double dx_start = -y_end/2, dy_start = x_end/2;
+            d_cx[j] += dx_start;
+            d_cy[j] += dy_start;
+            d_r[j] += -dx_start*cos_0[j] + dy_start*sin_0[j];
+            d_ang_0[j] += arcs[j].r*(dx_start*sin_0[j] + dy_start*cos_0[j]);
+        }
+
+        const double sign = S >= 0 ? 1 : -1;
+        for(size_t i = 0; i < n_arcs; ++i)
+        {
+            const struct chamber_arc *arc = &arcs[i];
+            grad[i].d_cx = sign*d_cx[i];
+            grad[i].d_cy = sign*d_cy[i];
+            grad[i].d_r = sign*d_r[i];
+            grad[i].d_a = sign*(d_ang_0[i] + d_ang_1[i]);
+            grad[i].d_phi = sign*(arc->alpha*d_ang_0[i] + (arc->alpha + arc->beta)*d_ang_1[i]);
+        }
+    }
+
+    return fabs(S);
+}
+
+
+void chamber_area_grad_scatter(const struct chamber_arc *arcs, size_t n_arcs, const struct chamber_arc_grad *grad, double scale, struct jacobian *J, size_t row)
+{
+    for(size_t i = 0; i < n_arcs; ++i)
+    {
+        const struct chamber_arc *arc = &arcs[i];
+        if(arc->i_cx >= 0)
+            *jacobian_entry(J,row,arc->i_cx) += scale*grad[i].d_cx;
+        if(arc->i_cy >= 0)
+            *jacobian_entry(J,row,arc->i_cy) += scale*grad[i].d_cy;
+        if(arc->i_r >= 0)
+            *jacobian_entry(J,row,arc->i_r) += scale*grad[i].d_r;
+        if(arc->i_a >= 0)
+            *jacobian_entry(J,row,arc->i_a) += scale*grad[i].d_a;
+        if(arc->i_phi >= 0)
+            *jacobian_entry(J,row,arc->i_phi) += scale*grad[i].d_phi;
+    }
+}
+
+
+void jacobian_zero(struct jacobian *J)
+{
+    if(J->dense)
+        gsl_matrix_set_zero(J->dense);
+    else if(J->values)
+        memset(J->values,0,J->row_ptr[J->n]*sizeof(double));
+}
+
+
 inline int point_from_alpha(double alpha, double norm, gsl_vector *center, gsl_vector *v)
 {
     gsl_vector_set(v,0,-gsl_sf_cos(alpha));
@@ -140,14 +248,10 @@ inline double add_angs(double ang1, double ang2)
 
 
 
-void print_J_diff(FILE *stream, const gsl_vector *x, void *params, gsl_solver_f_t f, gsl_solver_df_t df)
+void __print_J_diff(FILE *stream, const gsl_matrix *J, const gsl_matrix *J_est, double tol)
 {
-    size_t dim = x->size;
-    gsl_matrix *J_est = gsl_matrix_alloc(dim,dim);
+    size_t dim = J->size1;
     gsl_matrix *J_diff = gsl_matrix_alloc(dim,dim);
-    gsl_matrix *J = gsl_matrix_alloc(dim,dim);
-    df(x,params,J);
-    J_estimate(x,params,J_est,f);
     gsl_matrix_memcpy(J_diff,J);
     gsl_matrix_sub(J_diff,J_est);
     fprintf(stream,"Jacobian true:\n");
@@ -166,12 +270,123 @@ void print_J_diff(FILE *stream, const gsl_vector *x, void *params, gsl_solver_f_
             double df_est = gsl_matrix_get(J_est,row_i,col_i);
             double diff = gsl_matrix_get(J_diff,row_i,col_i);
             double err = fabs(diff/(MIN(df_real,df_est)+1e-9));
-            if(err > 0.05)
+            if(err > tol)
                 fprintf(stream,"J(%zd, %zd): real df: %f; estimated df: %f\n",row_i,col_i,df_real,df_est);
         }
     }
 
-    gsl_matrix_free(J_est);
     gsl_matrix_free(J_diff);
+}
+
+
+void print_J_diff(FILE *stream, const gsl_vector *x, void *params, gsl_solver_f_t f, gsl_solver_df_t df)
+{
+    size_t dim = x->size;
+    gsl_matrix *J_est = gsl_matrix_alloc(dim,dim);
+    gsl_matrix *J = gsl_matrix_alloc(dim,dim);
+    df(x,params,J);
+    J_estimate(x,params,J_est,f);
+    __print_J_diff(stream,J,J_est,0.05);
+
+    gsl_matrix_free(J_est);
+    gsl_matrix_free(J);
+}
+
+
+void print_J_diff_ref(FILE *stream, const gsl_vector *x, void *params, gsl_solver_df_t df, gsl_solver_df_t df_ref)
+{
+    size_t dim = x->size;
+    gsl_matrix *J_ref = gsl_matrix_alloc(dim,dim);
+    gsl_matrix *J = gsl_matrix_alloc(dim,dim);
+    df(x,params,J);
+    df_ref(x,params,J_ref);
+    __print_J_diff(stream,J,J_ref,1e-9);
+
+    gsl_matrix_free(J_ref);
     gsl_matrix_free(J);
-}
\ No newline at end of file
+}
+
+
+double solver_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+
+int solver_probe_f(const gsl_vector *x, void *p, gsl_vector *f)
+{
+    struct solver_probe *probe = (struct solver_probe*)p;
+    const double t = solver_clock();
+    int status = probe->f(x,probe->params,f);
+    probe->stats->t_f += solver_clock() - t;
+    ++probe->stats->f_calls;
+
+    return status;
+}
+
+
+int solver_probe_df(const gsl_vector *x, void *p, gsl_matrix *J)
+{
+    struct solver_probe *probe = (struct solver_probe*)p;
+    const double t = solver_clock();
+    int status = probe->df(x,probe->params,J);
+    probe->stats->t_df += solver_clock() - t;
+    ++probe->stats->df_calls;
+
+    return status;
+}
+
+
+// Fused call is booked as a Jacobian one, it is dominated by df
+int solver_probe_fdf(const gsl_vector *x, void *p, gsl_vector *f, gsl_matrix *J)
+{
+    struct solver_probe *probe = (struct solver_probe*)p;
+    const double t = solver_clock();
+    int status = probe->fdf(x,probe->params,f,J);
+    probe->stats->t_df += solver_clock() - t;
+    ++probe->stats->f_calls;
+    ++probe->stats->df_calls;
+
+    return status;
+}
+
+
+int solver_probe_jac(const gsl_vector *x, void *p, struct jacobian *J)
+{
+    struct solver_probe *probe = (struct solver_probe*)p;
+    const double t = solver_clock();
+    int status = probe->jac(x,probe->params,J);
+    probe->stats->t_df += solver_clock() - t;
+    ++probe->stats->df_calls;
+
+    return status;
+}
+
+
+void solver_stats_reset(struct solver_stats *stats)
+{
+    memset(stats,0,sizeof(struct solver_stats));
+}
+
+
+bool solver_cancelled(const struct solver_cancel *cancel)
+{
+    return cancel && cancel->cancelled && cancel->cancelled(cancel->data);
+}
+
+
+void solver_stats_finish(struct solver_stats *stats, int status, size_t iterations, double t_start, gsl_solver_f_t f, void *params, const gsl_vector *x, gsl_vector *f_x)
+{
+    stats->t_total = solver_clock() - t_start;
+    stats->t_linear = stats->t_total - stats->t_init - stats->t_f - stats->t_df;
+    stats->status = status;
+    stats->iterations = iterations;
+
+    f(x,params,f_x);
+    stats->residual = 0;
+    for(size_t i = 0; i < f_x->size; ++i)
+        stats->residual += fabs(gsl_vector_get(f_x,i));
+}
@@ -1,10 +1,33 @@
 #include <equations/2_levels.h>
 #include <equations/3_levels.h>
+#include <equations/atlas.h>
+#include <equations/cache.h>
+#include <equations/pool.h>
+#include <equations/triple_buffer.h>
+#include <gsl/gsl_errno.h>
 #include <gsl/gsl_multiroots.h>
 #include <gtk-3.0/gtk/gtk.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+
+// Solutions of recently visited configurations, spin buttons are scrubbed
+// back and forth over the same values
+#define RESULT_CACHE_CAPACITY 512
+#define RESULT_CACHE_QUANTUM 1e-9
+
+// Optional precomputed atlases built by cw_atlas, paths in these variables
+#define ATLAS_ENV_L2 "CW_ATLAS_L2"
+#define ATLAS_ENV_L3 "CW_ATLAS_L3"
+
+// Both tabs share the workers, the idle ones solve the configurations one
+// spin button step away from the shown one so the next click is a cache hit
+#define SOLVER_POOL_CAPACITY 256
+
+#define N_PARAMS_L2 (sizeof(struct system_2_levels_user_params)/sizeof(double))
+#define N_PARAMS_L3 (sizeof(struct system_3_levels_user_params)/sizeof(double))
 
 
 struct adiabatic_mode_widgets
@@ -16,78 +39,86 @@ struct adiabatic_mode_widgets
 struct app_level_context_l2
 {
     pthread_mutex_t params_lock;
-    pthread_cond_t params_cond;
     struct system_2_levels_user_params user_params;
+    double steps[N_PARAMS_L2];        // spin button increments, 0 without one
     bool params_dirty;
     bool adiabatic;
-    pthread_t drawing_thread;
-    pthread_mutex_t result_lock;
-    struct system_2_levels_result result;
+    bool solving;                       // solve job of the tab queued or running
+    GtkDrawingArea *area;
+    struct triple_buffer *result;     // struct system_2_levels_result
+    struct system_2_levels_ctx *solver;
+    struct result_cache *cache;
+    struct atlas *atlas;
     struct adiabatic_mode_widgets adia_widgets;
 };
 
 struct app_level_context_l3
 {
     pthread_mutex_t params_lock;
-    pthread_cond_t params_cond;
     struct system_3_levels_user_params user_params;
+    double steps[N_PARAMS_L3];        // spin button increments, 0 without one
     bool params_dirty;
     bool adiabatic;
-    pthread_t drawing_thread;
-    pthread_mutex_t result_lock;
-    struct system_3_levels_result result;
+    bool solving;                       // solve job of the tab queued or running
+    GtkDrawingArea *area;
+    struct triple_buffer *result;     // struct system_3_levels_result
+    struct system_3_levels_ctx *solver;
+    struct result_cache *cache;
+    struct atlas *atlas;
     struct adiabatic_mode_widgets adia_widgets;
 };
 
 struct app_level_context_l2 l2_context;
 struct app_level_context_l3 l3_context;
+struct pool *solver_pool;
 
 
 static void draw_function_l2(GtkDrawingArea *area, cairo_t *cr, gpointer data)
 {
-    pthread_mutex_lock(&l2_context.result_lock);
-    
+    // Snapshot is ours until the next draw, the solver keeps publishing meanwhile
+    const struct system_2_levels_result *result = triple_buffer_acquire(l2_context.result,NULL);
+
     const int width = gtk_widget_get_allocated_width(GTK_WIDGET(area));
     const int height = gtk_widget_get_allocated_height(GTK_WIDGET(area));
 
     const int pixels_per_meter = MIN(width,height)/2;
 
-    double r_ad = l2_context.result.r_ad*pixels_per_meter;
-    double r_cb = l2_context.result.r_cb*pixels_per_meter;
-    double r_dc = l2_context.result.r_dc*pixels_per_meter;
-    double r_ec = l2_context.result.r_ec*pixels_per_meter;
-    double r_ed = l2_context.result.r_ed*pixels_per_meter;
-    double x_ad = l2_context.result.x_ad*pixels_per_meter;
-    double y_ad = l2_context.result.y_ad*pixels_per_meter;
-    double x_cb = l2_context.result.x_cb*pixels_per_meter;
-    double y_cb = l2_context.result.y_cb*pixels_per_meter;
-    double x_dc = l2_context.result.x_dc*pixels_per_meter;
-    double y_dc = l2_context.result.y_dc*pixels_per_meter;
-    double y_ec = l2_context.result.y_ec*pixels_per_meter;
-    double y_ed = l2_context.result.y_ed*pixels_per_meter;
-    double x_bot = l2_context.result.x_bot*pixels_per_meter;
+    double r_ad = result->r_ad*pixels_per_meter;
+    double r_cb = result->r_cb*pixels_per_meter;
+    double r_dc = result->r_dc*pixels_per_meter;
+    double r_ec = result->r_ec*pixels_per_meter;
+    double r_ed = result->r_ed*pixels_per_meter;
+    double x_ad = result->x_ad*pixels_per_meter;
+    double y_ad = result->y_ad*pixels_per_meter;
+    double x_cb = result->x_cb*pixels_per_meter;
+    double y_cb = result->y_cb*pixels_per_meter;
+    double x_dc = result->x_dc*pixels_per_meter;
+    double y_dc = result->y_dc*pixels_per_meter;
+    double y_ec = result->y_ec*pixels_per_meter;
+    double y_ed = result->y_ed*pixels_per_meter;
+    double x_bot = result->x_bot*pixels_per_meter;
 
     cairo_translate(cr,0,height);
     cairo_scale(cr,1,-1);
 
-    double a_ad = G_PI-l2_context.result.a_ad;
-    cairo_arc(cr,x_ad,y_ad,r_ad,a_ad-l2_context.result.phi_ad,a_ad);
+    double a_ad = G_PI-result->a_ad;
+    cairo_arc(cr,x_ad,y_ad,r_ad,a_ad-result->phi_ad,a_ad);
     cairo_stroke(cr);
 
-    double a_dc = G_PI-l2_context.result.a_dc;
-    cairo_arc(cr,x_dc,y_dc,r_dc,a_dc-l2_context.result.phi_dc,a_dc);
+    double a_dc = G_PI-result->a_dc;
+    cairo_arc(cr,x_dc,y_dc,r_dc,a_dc-result->phi_dc,a_dc);
     cairo_stroke(cr);
     
-    double a_cb = G_PI-l2_context.result.a_cb;
-    cairo_arc(cr,x_cb,y_cb,r_cb,a_cb-l2_context.result.phi_cb,a_cb);
+    double a_cb = G_PI-result->a_cb;
+    cairo_arc(cr,x_cb,y_cb,r_cb,a_cb-result->phi_cb,a_cb);
     cairo_stroke(cr);
     
     double a_ec = -G_PI_2;
-    cairo_arc(cr,x_bot,y_ec,r_ec,a_ec-l2_context.result.phi_ec,a_ec);
+    cairo_arc(cr,x_bot,y_ec,r_ec,a_ec-result->phi_ec,a_ec);
     cairo_stroke(cr);
 
     double a_ed = -G_PI_2;
-    cairo_arc(cr,x_bot,y_ed,r_ed,a_ed,a_ed+l2_context.result.phi_ed);
+    cairo_arc(cr,x_bot,y_ed,r_ed,a_ed,a_ed+result->phi_ed);
     cairo_stroke(cr);
     
     
@@ -102,8 +133,8 @@ static void draw_function_l2(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     cairo_move_to(cr,x_a,y_a);
     cairo_show_text(cr,"A");
 
-    double x_b = x_cb + r_cb*cos(a_cb-l2_context.result.phi_cb) - letter_offset;
-    double y_b = -y_cb - r_cb*sin(a_cb-l2_context.result.phi_cb);
+    double x_b = x_cb + r_cb*cos(a_cb-result->phi_cb) - letter_offset;
+    double y_b = -y_cb - r_cb*sin(a_cb-result->phi_cb);
     cairo_move_to(cr,x_b,y_b);
     cairo_show_text(cr,"B");
 
@@ -112,8 +143,8 @@ static void draw_function_l2(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     cairo_move_to(cr,x_c,y_c);
     cairo_show_text(cr,"C");
 
-    double x_d = x_ad + r_ad*cos(a_ad+l2_context.result.phi_ad) + letter_offset/4;
-    double y_d = -y_ad - r_ad*sin(a_ad+l2_context.result.phi_ad) + letter_offset;
+    double x_d = x_ad + r_ad*cos(a_ad+result->phi_ad) + letter_offset/4;
+    double y_d = -y_ad - r_ad*sin(a_ad+result->phi_ad) + letter_offset;
     cairo_move_to(cr,x_d,y_d);
     cairo_show_text(cr,"D");
 
@@ -121,77 +152,75 @@ static void draw_function_l2(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     double y_e = -y_ec - r_ec*sin(a_ec) + letter_offset;
     cairo_move_to(cr,x_e,y_e);
     cairo_show_text(cr,"E");
-
-    pthread_mutex_unlock(&l2_context.result_lock);
 }
 
 
 static void draw_function_l3(GtkDrawingArea *area, cairo_t *cr, gpointer data)
 {
-    pthread_mutex_lock(&l3_context.result_lock);
-    
+    const struct system_3_levels_result *result = triple_buffer_acquire(l3_context.result,NULL);
+
     const int width = gtk_widget_get_allocated_width(GTK_WIDGET(area));
     const int height = gtk_widget_get_allocated_height(GTK_WIDGET(area));
 
     const int pixels_per_meter = MIN(width,height)/3;
 
-    double r_ad = l3_context.result.r_ad*pixels_per_meter;
-    double r_cb = l3_context.result.r_cb*pixels_per_meter;
-    double r_dc = l3_context.result.r_dc*pixels_per_meter;
-    double r_df = l3_context.result.r_df*pixels_per_meter;
-    double r_ec = l3_context.result.r_ec*pixels_per_meter;
-    double r_fe = l3_context.result.r_fe*pixels_per_meter;
-    double r_ge = l3_context.result.r_ge*pixels_per_meter;
-    double r_gf = l3_context.result.r_gf*pixels_per_meter;
-    double x_ad = l3_context.result.x_ad*pixels_per_meter;
-    double y_ad = l3_context.result.y_ad*pixels_per_meter;
-    double x_cb = l3_context.result.x_cb*pixels_per_meter;
-    double y_cb = l3_context.result.y_cb*pixels_per_meter;
-    double x_dc = l3_context.result.x_dc*pixels_per_meter;
-    double y_dc = l3_context.result.y_dc*pixels_per_meter;
-    double x_df = l3_context.result.x_df*pixels_per_meter;
-    double y_df = l3_context.result.y_df*pixels_per_meter;
-    double x_ec = l3_context.result.x_ec*pixels_per_meter;
-    double y_ec = l3_context.result.y_ec*pixels_per_meter;
-    double x_fe = l3_context.result.x_fe*pixels_per_meter;
-    double y_fe = l3_context.result.y_fe*pixels_per_meter;
-    double y_ge = l3_context.result.y_ge*pixels_per_meter;
-    double y_gf = l3_context.result.y_gf*pixels_per_meter;
-    double x_bot = l3_context.result.x_bot*pixels_per_meter;
+    double r_ad = result->r_ad*pixels_per_meter;
+    double r_cb = result->r_cb*pixels_per_meter;
+    double r_dc = result->r_dc*pixels_per_meter;
+    double r_df = result->r_df*pixels_per_meter;
+    double r_ec = result->r_ec*pixels_per_meter;
+    double r_fe = result->r_fe*pixels_per_meter;
+    double r_ge = result->r_ge*pixels_per_meter;
+    double r_gf = result->r_gf*pixels_per_meter;
+    double x_ad = result->x_ad*pixels_per_meter;
+    double y_ad = result->y_ad*pixels_per_meter;
+    double x_cb = result->x_cb*pixels_per_meter;
+    double y_cb = result->y_cb*pixels_per_meter;
+    double x_dc = result->x_dc*pixels_per_meter;
+    double y_dc = result->y_dc*pixels_per_meter;
+    double x_df = result->x_df*pixels_per_meter;
+    double y_df = result->y_df*pixels_per_meter;
+    double x_ec = result->x_ec*pixels_per_meter;
+    double y_ec = result->y_ec*pixels_per_meter;
+    double x_fe = result->x_fe*pixels_per_meter;
+    double y_fe = result->y_fe*pixels_per_meter;
+    double y_ge = result->y_ge*pixels_per_meter;
+    double y_gf = result->y_gf*pixels_per_meter;
+    double x_bot = result->x_bot*pixels_per_meter;
 
     cairo_translate(cr,0,height);
     cairo_scale(cr,1,-1);
 
-    double a_ad = G_PI-l3_context.result.a_ad;
-    cairo_arc(cr,x_ad,y_ad,r_ad,a_ad-l3_context.result.phi_ad,a_ad);
+    double a_ad = G_PI-result->a_ad;
+    cairo_arc(cr,x_ad,y_ad,r_ad,a_ad-result->phi_ad,a_ad);
     cairo_stroke(cr);
 
-    double a_dc = G_PI-l3_context.result.a_dc;
-    cairo_arc(cr,x_dc,y_dc,r_dc,a_dc-l3_context.result.phi_dc,a_dc);
+    double a_dc = G_PI-result->a_dc;
+    cairo_arc(cr,x_dc,y_dc,r_dc,a_dc-result->phi_dc,a_dc);
     cairo_stroke(cr);
     
-    double a_cb = G_PI-l3_context.result.a_cb;
-    cairo_arc(cr,x_cb,y_cb,r_cb,a_cb-l3_context.result.phi_cb,a_cb);
+    double a_cb = G_PI-result->a_cb;
+    cairo_arc(cr,x_cb,y_cb,r_cb,a_cb-result->phi_cb,a_cb);
     cairo_stroke(cr);
 
-    double a_df = G_PI-l3_context.result.a_df;
-    cairo_arc(cr,x_df,y_df,r_df,a_df-l3_context.result.phi_df,a_df);
+    double a_df = G_PI-result->a_df;
+    cairo_arc(cr,x_df,y_df,r_df,a_df-result->phi_df,a_df);
     cairo_stroke(cr);
 
-    double a_ec = G_PI-l3_context.result.a_ec;
-    cairo_arc(cr,x_ec,y_ec,r_ec,a_ec-l3_context.result.phi_ec,a_ec);
+    double a_ec = G_PI-result->a_ec;
+    cairo_arc(cr,x_ec,y_ec,r_ec,a_ec-result->phi_ec,a_ec);
     cairo_stroke(cr);
 
-    double a_fe = G_PI-l3_context.result.a_fe;
-    cairo_arc(cr,x_fe,y_fe,r_fe,a_fe-l3_context.result.phi_fe,a_fe);
+    double a_fe = G_PI-result->a_fe;
+    cairo_arc(cr,x_fe,y_fe,r_fe,a_fe-result->phi_fe,a_fe);
     cairo_stroke(cr);
     
     double a_ge = -G_PI_2;
-    cairo_arc(cr,x_bot,y_ge,r_ge,a_ge-l3_context.result.phi_ge,a_ge);
+    cairo_arc(cr,x_bot,y_ge,r_ge,a_ge-result->phi_ge,a_ge);
     cairo_stroke(cr);
 
     double a_gf = -G_PI_2;
-    cairo_arc(cr,x_bot,y_gf,r_gf,a_gf,a_gf+l3_context.result.phi_gf);
+    cairo_arc(cr,x_bot,y_gf,r_gf,a_gf,a_gf+result->phi_gf);
     cairo_stroke(cr);
     
     
@@ -206,8 +235,8 @@ static void draw_function_l3(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     cairo_move_to(cr,x_a,y_a);
     cairo_show_text(cr,"A");
 
-    double x_b = x_cb + r_cb*cos(a_cb-l2_context.result.phi_cb) - letter_offset;
-    double y_b = -y_cb - r_cb*sin(a_cb-l2_context.result.phi_cb);
+    double x_b = x_cb + r_cb*cos(a_cb-result->phi_cb) - letter_offset;
+    double y_b = -y_cb - r_cb*sin(a_cb-result->phi_cb);
     cairo_move_to(cr,x_b,y_b);
     cairo_show_text(cr,"B");
 
@@ -216,8 +245,8 @@ static void draw_function_l3(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     cairo_move_to(cr,x_c,y_c);
     cairo_show_text(cr,"C");
 
-    double x_d = x_ad + r_ad*cos(a_ad+l3_context.result.phi_ad) + letter_offset/4;
-    double y_d = -y_ad - r_ad*sin(a_ad+l3_context.result.phi_ad) + letter_offset;
+    double x_d = x_ad + r_ad*cos(a_ad+result->phi_ad) + letter_offset/4;
+    double y_d = -y_ad - r_ad*sin(a_ad+result->phi_ad) + letter_offset;
     cairo_move_to(cr,x_d,y_d);
     cairo_show_text(cr,"D");
 
@@ -226,8 +255,8 @@ static void draw_function_l3(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     cairo_move_to(cr,x_e,y_e);
     cairo_show_text(cr,"E");
 
-    double x_f = x_bot + r_gf*cos(a_gf+l3_context.result.phi_gf) + letter_offset;
-    double y_f = -y_gf - r_gf*sin(a_gf+l3_context.result.phi_gf) - letter_offset/4;
+    double x_f = x_bot + r_gf*cos(a_gf+result->phi_gf) + letter_offset;
+    double y_f = -y_gf - r_gf*sin(a_gf+result->phi_gf) - letter_offset/4;
     cairo_move_to(cr,x_f,y_f);
     cairo_show_text(cr,"F");
 
@@ -235,79 +264,321 @@ static void draw_function_l3(GtkDrawingArea *area, cairo_t *cr, gpointer data)
     double y_g = -y_gf - r_gf*sin(a_gf) + letter_offset;
     cairo_move_to(cr,x_g,y_g);
     cairo_show_text(cr,"G");
+}
+
 
+// Newer params make the running solve stale
+static bool params_changed_l2(void *data)
+{
+    pthread_mutex_lock(&l2_context.params_lock);
+    bool dirty = l2_context.params_dirty;
+    pthread_mutex_unlock(&l2_context.params_lock);
 
-    pthread_mutex_unlock(&l3_context.result_lock);
+    return dirty || pool_stopping(solver_pool);
 }
 
+// Speculative solves also give way to any solve the user is waiting for
+static bool speculation_cancelled_l2(void *data)
+{
+    return params_changed_l2(data) || pool_should_yield(solver_pool);
+}
+
+static void publish_result_l2(GtkDrawingArea *area, const struct system_2_levels_result *result)
+{
+    triple_buffer_publish(l2_context.result,result);
+    gtk_widget_queue_draw(GTK_WIDGET(area));
+}
 
-static void queue_update_picture_l2(GtkDrawingArea *area, const struct system_2_levels_user_params *params_extracted, bool adiabatic_extracted)
+// Status of the solve, result_local is what ends up on screen
+static int queue_update_picture_l2(GtkDrawingArea *area, const struct system_2_levels_user_params *params_extracted, bool adiabatic_extracted,
+                                    struct system_2_levels_result *result_out)
 {
     struct system_2_levels_result result_local;
+    int status = GSL_SUCCESS;
+    const double *key = (const double*)params_extracted;
 
-    if(adiabatic_extracted)
-        system_2_levels_adiabatic_eval(params_extracted,&result_local);
+    if(result_cache_lookup(l2_context.cache,key,adiabatic_extracted,&result_local))
+        // Next solve starts from the configuration on screen
+        system_2_levels_ctx_set_warm(l2_context.solver,&result_local);
     else
-        system_2_levels_eval(params_extracted,&result_local);
+    {
+        // Interpolated picture right away, exact one once solved from it
+        if(system_2_levels_atlas_lookup(l2_context.atlas,params_extracted,adiabatic_extracted,&result_local) == GSL_SUCCESS)
+        {
+            publish_result_l2(area,&result_local);
+            system_2_levels_ctx_set_warm(l2_context.solver,&result_local);
+        }
+
+        if(adiabatic_extracted)
+            status = system_2_levels_ctx_adiabatic_eval(l2_context.solver,params_extracted,&result_local);
+        else
+            status = system_2_levels_ctx_eval(l2_context.solver,params_extracted,&result_local);
+        if(status == SOLVER_ECANCELLED)
+            return status;
+        if(status == GSL_SUCCESS)
+            result_cache_insert(l2_context.cache,key,adiabatic_extracted,&result_local);
+    }
+
+    publish_result_l2(area,&result_local);
+    memcpy(result_out,&result_local,sizeof(struct system_2_levels_result));
+
+    return status;
+}
+
+// Newer params make the running solve stale
+static bool params_changed_l3(void *data)
+{
+    pthread_mutex_lock(&l3_context.params_lock);
+    bool dirty = l3_context.params_dirty;
+    pthread_mutex_unlock(&l3_context.params_lock);
+
+    return dirty || pool_stopping(solver_pool);
+}
 
-    pthread_mutex_lock(&l2_context.result_lock);
-    memcpy(&l2_context.result,&result_local,sizeof(struct system_2_levels_result));
+// Speculative solves also give way to any solve the user is waiting for
+static bool speculation_cancelled_l3(void *data)
+{
+    return params_changed_l3(data) || pool_should_yield(solver_pool);
+}
+
+static void publish_result_l3(GtkDrawingArea *area, const struct system_3_levels_result *result)
+{
+    triple_buffer_publish(l3_context.result,result);
     gtk_widget_queue_draw(GTK_WIDGET(area));
-    pthread_mutex_unlock(&l2_context.result_lock);
 }
 
-static void queue_update_picture_l3(GtkDrawingArea *area, const struct system_3_levels_user_params *params_extracted)
+// Status of the solve, result_local is what ends up on screen
+static int queue_update_picture_l3(GtkDrawingArea *area, const struct system_3_levels_user_params *params_extracted, bool adiabatic_extracted,
+                                    struct system_3_levels_result *result_out)
 {
     struct system_3_levels_result result_local;
-    system_3_levels_eval(params_extracted,&result_local);
+    int status = GSL_SUCCESS;
+    const double *key = (const double*)params_extracted;
 
-    pthread_mutex_lock(&l3_context.result_lock);
-    memcpy(&l3_context.result,&result_local,sizeof(struct system_3_levels_result));
-    gtk_widget_queue_draw(GTK_WIDGET(area));
-    pthread_mutex_unlock(&l3_context.result_lock);
+    if(result_cache_lookup(l3_context.cache,key,adiabatic_extracted,&result_local))
+        // Next solve starts from the configuration on screen
+        system_3_levels_ctx_set_warm(l3_context.solver,&result_local);
+    else
+    {
+        // Interpolated picture right away, exact one once solved from it
+        if(system_3_levels_atlas_lookup(l3_context.atlas,params_extracted,adiabatic_extracted,&result_local) == GSL_SUCCESS)
+        {
+            publish_result_l3(area,&result_local);
+            system_3_levels_ctx_set_warm(l3_context.solver,&result_local);
+        }
+
+        if(adiabatic_extracted)
+            status = system_3_levels_ctx_adiabatic_eval(l3_context.solver,params_extracted,&result_local);
+        else
+            status = system_3_levels_ctx_eval(l3_context.solver,params_extracted,&result_local);
+        if(status == SOLVER_ECANCELLED)
+            return status;
+        if(status == GSL_SUCCESS)
+            result_cache_insert(l3_context.cache,key,adiabatic_extracted,&result_local);
+    }
+
+    publish_result_l3(area,&result_local);
+    memcpy(result_out,&result_local,sizeof(struct system_3_levels_result));
+
+    return status;
+}
+
+
+struct speculation_l2
+{
+    struct system_2_levels_user_params user_params;
+    struct system_2_levels_result warm;
+    bool adiabatic;
+};
+
+// Solves a neighbour of the shown configuration into the cache, never shown
+static void speculate_job_l2(void *data)
+{
+    struct speculation_l2 *spec = (struct speculation_l2*)data;
+    const double *key = (const double*)&spec->user_params;
+    if(speculation_cancelled_l2(NULL) || result_cache_contains(l2_context.cache,key,spec->adiabatic))
+        return;
+
+    struct system_2_levels_ctx *ctx = system_2_levels_ctx_alloc(SOLVER_BACKEND_DENSE);
+    if(!ctx)
+        return;
+    system_2_levels_ctx_set_warm(ctx,&spec->warm);
+    system_2_levels_ctx_set_cancel(ctx,speculation_cancelled_l2,NULL);
+
+    struct system_2_levels_result result;
+    int status;
+    if(spec->adiabatic)
+        status = system_2_levels_ctx_adiabatic_eval(ctx,&spec->user_params,&result);
+    else
+        status = system_2_levels_ctx_eval(ctx,&spec->user_params,&result);
+    if(status == GSL_SUCCESS)
+        result_cache_insert(l2_context.cache,key,spec->adiabatic,&result);
+
+    system_2_levels_ctx_free(ctx);
 }
 
+static void speculate_l2(const struct system_2_levels_user_params *params, const double *steps, bool adiabatic, const struct system_2_levels_result *result)
+{
+    for(size_t i = 0; i < N_PARAMS_L2; ++i)
+    {
+        for(int sign = -1; sign <= 1 && steps[i] > 0; sign += 2)
+        {
+            struct speculation_l2 *spec = malloc(sizeof(struct speculation_l2));
+            if(!spec)
+                return;
+            memcpy(&spec->user_params,params,sizeof(struct system_2_levels_user_params));
+            ((double*)&spec->user_params)[i] += sign*steps[i];
+            memcpy(&spec->warm,result,sizeof(struct system_2_levels_result));
+            spec->adiabatic = adiabatic;
+
+            if(pool_submit(solver_pool,POOL_PRIORITY_IDLE,speculate_job_l2,free,spec) != GSL_SUCCESS)
+            {
+                free(spec);
+                return;
+            }
+        }
+    }
+}
 
-static void *update_picture_l2(GtkDrawingArea *area)
+// At most one of these per tab is queued or running, so the solver context
+// of the tab needs no lock. Keeps solving until the params stop changing
+static void solve_job_l2(void *data)
 {
+    struct system_2_levels_user_params params_extracted;
+    double steps_extracted[N_PARAMS_L2];
+    bool adiabatic_extracted;
+    struct system_2_levels_result result_local;
+    int status = GSL_EFAILED;
+
     while(true)
     {
         pthread_mutex_lock(&l2_context.params_lock);
-        if(!l2_context.params_dirty)
-            pthread_cond_wait(&l2_context.params_cond,&l2_context.params_lock);
-        
-        struct system_2_levels_user_params params_extracted;
+        if(!l2_context.params_dirty || pool_stopping(solver_pool))
+        {
+            l2_context.solving = false;
+            pthread_mutex_unlock(&l2_context.params_lock);
+            break;
+        }
+
         memcpy(&params_extracted,&l2_context.user_params,sizeof(struct system_2_levels_user_params));
-        bool adiabatic_extracted = l2_context.adiabatic;
+        memcpy(steps_extracted,l2_context.steps,sizeof(steps_extracted));
+        adiabatic_extracted = l2_context.adiabatic;
         l2_context.params_dirty = false;
 
         pthread_mutex_unlock(&l2_context.params_lock);
 
-        queue_update_picture_l2(area,&params_extracted,adiabatic_extracted);
+        status = queue_update_picture_l2(l2_context.area,&params_extracted,adiabatic_extracted,&result_local);
     }
 
-    return NULL;
+    if(status == GSL_SUCCESS)
+        speculate_l2(&params_extracted,steps_extracted,adiabatic_extracted,&result_local);
+}
+
+// Called with params_lock held
+static void schedule_solve_l2()
+{
+    if(l2_context.area && !l2_context.solving &&
+       pool_submit(solver_pool,POOL_PRIORITY_NORMAL,solve_job_l2,NULL,NULL) == GSL_SUCCESS)
+        l2_context.solving = true;
+}
+
+
+struct speculation_l3
+{
+    struct system_3_levels_user_params user_params;
+    struct system_3_levels_result warm;
+    bool adiabatic;
+};
+
+// Solves a neighbour of the shown configuration into the cache, never shown
+static void speculate_job_l3(void *data)
+{
+    struct speculation_l3 *spec = (struct speculation_l3*)data;
+    const double *key = (const double*)&spec->user_params;
+    if(speculation_cancelled_l3(NULL) || result_cache_contains(l3_context.cache,key,spec->adiabatic))
+        return;
+
+    struct system_3_levels_ctx *ctx = system_3_levels_ctx_alloc(SOLVER_BACKEND_FIXED_NEWTON);
+    if(!ctx)
+        return;
+    system_3_levels_ctx_set_warm(ctx,&spec->warm);
+    system_3_levels_ctx_set_cancel(ctx,speculation_cancelled_l3,NULL);
+
+    struct system_3_levels_result result;
+    int status;
+    if(spec->adiabatic)
+        status = system_3_levels_ctx_adiabatic_eval(ctx,&spec->user_params,&result);
+    else
+        status = system_3_levels_ctx_eval(ctx,&spec->user_params,&result);
+    if(status == GSL_SUCCESS)
+        result_cache_insert(l3_context.cache,key,spec->adiabatic,&result);
+
+    system_3_levels_ctx_free(ctx);
 }
 
+static void speculate_l3(const struct system_3_levels_user_params *params, const double *steps, bool adiabatic, const struct system_3_levels_result *result)
+{
+    for(size_t i = 0; i < N_PARAMS_L3; ++i)
+    {
+        for(int sign = -1; sign <= 1 && steps[i] > 0; sign += 2)
+        {
+            struct speculation_l3 *spec = malloc(sizeof(struct speculation_l3));
+            if(!spec)
+                return;
+            memcpy(&spec->user_params,params,sizeof(struct system_3_levels_user_params));
+            ((double*)&spec->user_params)[i] += sign*steps[i];
+            memcpy(&spec->warm,result,sizeof(struct system_3_levels_result));
+            spec->adiabatic = adiabatic;
+
+            if(pool_submit(solver_pool,POOL_PRIORITY_IDLE,speculate_job_l3,free,spec) != GSL_SUCCESS)
+            {
+                free(spec);
+                return;
+            }
+        }
+    }
+}
 
-static void *update_picture_l3(GtkDrawingArea *area)
+// At most one of these per tab is queued or running, so the solver context
+// of the tab needs no lock. Keeps solving until the params stop changing
+static void solve_job_l3(void *data)
 {
+    struct system_3_levels_user_params params_extracted;
+    double steps_extracted[N_PARAMS_L3];
+    bool adiabatic_extracted;
+    struct system_3_levels_result result_local;
+    int status = GSL_EFAILED;
+
     while(true)
     {
         pthread_mutex_lock(&l3_context.params_lock);
-        if(!l3_context.params_dirty)
-            pthread_cond_wait(&l3_context.params_cond,&l3_context.params_lock);
-        
-        struct system_3_levels_user_params params_extracted;
+        if(!l3_context.params_dirty || pool_stopping(solver_pool))
+        {
+            l3_context.solving = false;
+            pthread_mutex_unlock(&l3_context.params_lock);
+            break;
+        }
+
         memcpy(&params_extracted,&l3_context.user_params,sizeof(struct system_3_levels_user_params));
+        memcpy(steps_extracted,l3_context.steps,sizeof(steps_extracted));
+        adiabatic_extracted = l3_context.adiabatic;
         l3_context.params_dirty = false;
 
         pthread_mutex_unlock(&l3_context.params_lock);
 
-        queue_update_picture_l3(area,&params_extracted);
+        status = queue_update_picture_l3(l3_context.area,&params_extracted,adiabatic_extracted,&result_local);
     }
 
-    return NULL;
+    if(status == GSL_SUCCESS)
+        speculate_l3(&params_extracted,steps_extracted,adiabatic_extracted,&result_local);
+}
+
+// Called with params_lock held
+static void schedule_solve_l3()
+{
+    if(l3_context.area && !l3_context.solving &&
+       pool_submit(solver_pool,POOL_PRIORITY_NORMAL,solve_job_l3,NULL,NULL) == GSL_SUCCESS)
+        l3_context.solving = true;
 }
 
 
@@ -316,8 +587,11 @@ static void spin_button_value_changed_cb_l2(GtkSpinButton *spin_button, double *
     pthread_mutex_lock(&l2_context.params_lock);
     double value = (double)gtk_spin_button_get_value(spin_button);
     *param = value;
+    double step;
+    gtk_spin_button_get_increments(spin_button,&step,NULL);
+    l2_context.steps[param - (double*)&l2_context.user_params] = step;
     l2_context.params_dirty = true;
-    pthread_cond_signal(&l2_context.params_cond);
+    schedule_solve_l2();
     pthread_mutex_unlock(&l2_context.params_lock);
 }
 
@@ -326,8 +600,11 @@ static void spin_button_value_changed_cb_l3(GtkSpinButton *spin_button, double *
     pthread_mutex_lock(&l3_context.params_lock);
     double value = (double)gtk_spin_button_get_value(spin_button);
     *param = value;
+    double step;
+    gtk_spin_button_get_increments(spin_button,&step,NULL);
+    l3_context.steps[param - (double*)&l3_context.user_params] = step;
     l3_context.params_dirty = true;
-    pthread_cond_signal(&l3_context.params_cond);
+    schedule_solve_l3();
     pthread_mutex_unlock(&l3_context.params_lock);
 }
 
@@ -339,10 +616,22 @@ static void adiabatic_mode_changed_cb_l2(GtkSwitch *adiabatic_sw, gpointer *data
     gtk_widget_set_sensitive(GTK_WIDGET(l2_context.adia_widgets.adiabatic_constant_spin),l2_context.adiabatic);
 
     l2_context.params_dirty = true;
-    pthread_cond_signal(&l2_context.params_cond);
+    schedule_solve_l2();
     pthread_mutex_unlock(&l2_context.params_lock);
 }
 
+static void adiabatic_mode_changed_cb_l3(GtkSwitch *adiabatic_sw, gpointer *data)
+{
+    pthread_mutex_lock(&l3_context.params_lock);
+    l3_context.adiabatic = (bool)gtk_switch_get_active(adiabatic_sw);
+    gtk_widget_set_sensitive(GTK_WIDGET(l3_context.adia_widgets.adiabatic_constant_label),l3_context.adiabatic);
+    gtk_widget_set_sensitive(GTK_WIDGET(l3_context.adia_widgets.adiabatic_constant_spin),l3_context.adiabatic);
+
+    l3_context.params_dirty = true;
+    schedule_solve_l3();
+    pthread_mutex_unlock(&l3_context.params_lock);
+}
+
 
 static void init_widgets_l2(GtkBuilder *builder)
 {
@@ -407,9 +696,11 @@ static void init_widgets_l2(GtkBuilder *builder)
     GtkDrawingArea *area = GTK_DRAWING_AREA(gtk_builder_get_object(builder,"drawing_area_l2"));
     g_signal_connect(G_OBJECT(area),"draw",G_CALLBACK(draw_function_l2),NULL);
 
+    pthread_mutex_lock(&l2_context.params_lock);
+    l2_context.area = area;
     l2_context.params_dirty = true;
-
-    pthread_create(&l2_context.drawing_thread,NULL,(void *(*)(void*))update_picture_l2,area);
+    schedule_solve_l2();
+    pthread_mutex_unlock(&l2_context.params_lock);
 }
 
 
@@ -479,12 +770,24 @@ static void init_widgets_l3(GtkBuilder *builder)
     g_signal_connect(p_atm_spin,"value-changed",G_CALLBACK(spin_button_value_changed_cb_l3),&l3_context.user_params.p_atm);
     spin_button_value_changed_cb_l3(GTK_SPIN_BUTTON(p_atm_spin),&l3_context.user_params.p_atm);
 
+
+    l3_context.adia_widgets.adiabatic_constant_label = GTK_LABEL(gtk_builder_get_object(builder,"adiabatic_constant_label_l3"));
+    l3_context.adia_widgets.adiabatic_constant_spin = GTK_SPIN_BUTTON(gtk_builder_get_object(builder,"adiabatic_constant_spin_l3"));
+    g_signal_connect(l3_context.adia_widgets.adiabatic_constant_spin,"value-changed",G_CALLBACK(spin_button_value_changed_cb_l3),&l3_context.user_params.k);
+    spin_button_value_changed_cb_l3(GTK_SPIN_BUTTON(l3_context.adia_widgets.adiabatic_constant_spin),&l3_context.user_params.k);
+
+    GObject *adiabatic_sw = gtk_builder_get_object(builder,"adiabatic_l3");
+    g_signal_connect(adiabatic_sw,"state-set",G_CALLBACK(adiabatic_mode_changed_cb_l3),NULL);
+    adiabatic_mode_changed_cb_l3(GTK_SWITCH(adiabatic_sw),NULL);
+
     GtkDrawingArea *area = GTK_DRAWING_AREA(gtk_builder_get_object(builder,"drawing_area_l3"));
     g_signal_connect(G_OBJECT(area),"draw",G_CALLBACK(draw_function_l3),NULL);
 
+    pthread_mutex_lock(&l3_context.params_lock);
+    l3_context.area = area;
     l3_context.params_dirty = true;
-
-    pthread_create(&l3_context.drawing_thread,NULL,(void *(*)(void*))update_picture_l3,area);
+    schedule_solve_l3();
+    pthread_mutex_unlock(&l3_context.params_lock);
 }
 
 
@@ -505,33 +808,53 @@ static void activate(GtkApplication *app, gpointer data)
 
 int main(int argc, char *argv[])
 {
+    solver_pool = pool_alloc(0,SOLVER_POOL_CAPACITY);
+    if (!solver_pool) {
+        fprintf(stderr,"Failed to start the solver pool\n");
+        return 1;
+    }
+
     pthread_mutex_init(&l2_context.params_lock,0);
-    pthread_cond_init(&l2_context.params_cond,NULL);
-    pthread_mutex_init(&l2_context.result_lock,0);
+    l2_context.result = triple_buffer_alloc(sizeof(struct system_2_levels_result),NULL);
     l2_context.adiabatic = false;
     l2_context.params_dirty = false;
+    l2_context.solver = system_2_levels_ctx_alloc(SOLVER_BACKEND_DENSE);
+    system_2_levels_ctx_set_cancel(l2_context.solver,params_changed_l2,NULL);
+    // User params are a plain array of doubles, used as is for the key
+    l2_context.cache = result_cache_alloc(RESULT_CACHE_CAPACITY,N_PARAMS_L2,sizeof(struct system_2_levels_result),RESULT_CACHE_QUANTUM);
+    l2_context.atlas = getenv(ATLAS_ENV_L2) ? atlas_open(getenv(ATLAS_ENV_L2)) : NULL;
 
     pthread_mutex_init(&l3_context.params_lock,0);
-    pthread_cond_init(&l3_context.params_cond,NULL);
-    pthread_mutex_init(&l3_context.result_lock,0);
+    l3_context.result = triple_buffer_alloc(sizeof(struct system_3_levels_result),NULL);
     l3_context.adiabatic = false;
     l3_context.params_dirty = false;
+    // Plain Newton often diverges on the adiabatic 3-level system, damped one does not
+    l3_context.solver = system_3_levels_ctx_alloc(SOLVER_BACKEND_FIXED_NEWTON);
+    system_3_levels_ctx_set_cancel(l3_context.solver,params_changed_l3,NULL);
+    l3_context.cache = result_cache_alloc(RESULT_CACHE_CAPACITY,N_PARAMS_L3,sizeof(struct system_3_levels_result),RESULT_CACHE_QUANTUM);
+    l3_context.atlas = getenv(ATLAS_ENV_L3) ? atlas_open(getenv(ATLAS_ENV_L3)) : NULL;
 
     GtkApplication *app = gtk_application_new("org.cw.ui",G_APPLICATION_DEFAULT_FLAGS);
 
     g_signal_connect(app,"activate",G_CALLBACK(activate),NULL);
     int status = g_application_run(G_APPLICATION(app),argc,argv);
 
+    // Running solves see pool_stopping and return early
+    pool_free(solver_pool);
 
-    pthread_cancel(l2_context.drawing_thread);
-    pthread_cond_destroy(&l2_context.params_cond);
+    system_2_levels_ctx_free(l2_context.solver);
+    g_debug("2-level cache hit rate %.3f",result_cache_hit_rate(l2_context.cache));
+    result_cache_free(l2_context.cache);
+    atlas_close(l2_context.atlas);
     pthread_mutex_destroy(&l2_context.params_lock);
-    pthread_mutex_destroy(&l2_context.result_lock);
+    triple_buffer_free(l2_context.result);
 
-    pthread_cancel(l3_context.drawing_thread);
-    pthread_cond_destroy(&l3_context.params_cond);
+    system_3_levels_ctx_free(l3_context.solver);
+    g_debug("3-level cache hit rate %.3f",result_cache_hit_rate(l3_context.cache));
+    result_cache_free(l3_context.cache);
+    atlas_close(l3_context.atlas);
     pthread_mutex_destroy(&l3_context.params_lock);
-    pthread_mutex_destroy(&l3_context.result_lock);
+    triple_buffer_free(l3_context.result);
 
     g_object_unref(app);
 
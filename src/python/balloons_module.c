@@ -0,0 +1,402 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <equations/2_levels.h>
+#include <equations/3_levels.h>
+#include <equations/batch.h>
+#include <equations/utils.h>
+#include <gsl/gsl_errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// Model glue as in cw_sweep, the records are the C structs themselves so
+// that NumPy arrays of the matching structured dtype are used in place
+struct module_model
+{
+    size_t user_params_size;
+    size_t result_size;
+    const struct field_desc *params;
+    const size_t *n_params;
+    const struct field_desc *results;
+    const size_t *n_results;
+
+    void (*default_user_params)(void *user_params);
+    enum solver_backend (*default_backend)(bool adiabatic);
+    void *(*ctx_alloc)(enum solver_backend backend);
+    void (*ctx_free)(void *ctx);
+    int (*eval)(void *ctx, const void *user_params, void *result, bool adiabatic);
+};
+
+
+static void __module_2_levels_default(void *user_params)
+{
+    system_2_levels_default_user_params(user_params);
+}
+
+static void *__module_2_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_2_levels_ctx_alloc(backend);
+}
+
+static void __module_2_levels_ctx_free(void *ctx)
+{
+    system_2_levels_ctx_free(ctx);
+}
+
+static int __module_2_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_2_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_2_levels_ctx_eval(ctx,user_params,result);
+}
+
+
+static void __module_3_levels_default(void *user_params)
+{
+    system_3_levels_default_user_params(user_params);
+}
+
+static void *__module_3_levels_ctx_alloc(enum solver_backend backend)
+{
+    return system_3_levels_ctx_alloc(backend);
+}
+
+static void __module_3_levels_ctx_free(void *ctx)
+{
+    system_3_levels_ctx_free(ctx);
+}
+
+static int __module_3_levels_eval(void *ctx, const void *user_params, void *result, bool adiabatic)
+{
+    if(adiabatic)
+        return system_3_levels_ctx_adiabatic_eval(ctx,user_params,result);
+    return system_3_levels_ctx_eval(ctx,user_params,result);
+}
+
+
+static const struct module_model __module_models[] = {
+    {
+        sizeof(struct system_2_levels_user_params), sizeof(struct system_2_levels_result),
+        system_2_levels_user_params_fields, &system_2_levels_user_params_n_fields,
+        system_2_levels_result_fields, &system_2_levels_result_n_fields,
+        __module_2_levels_default, system_2_levels_default_backend,
+        __module_2_levels_ctx_alloc, __module_2_levels_ctx_free, __module_2_levels_eval
+    },
+    {
+        sizeof(struct system_3_levels_user_params), sizeof(struct system_3_levels_result),
+        system_3_levels_user_params_fields, &system_3_levels_user_params_n_fields,
+        system_3_levels_result_fields, &system_3_levels_result_n_fields,
+        __module_3_levels_default, system_3_levels_default_backend,
+        __module_3_levels_ctx_alloc, __module_3_levels_ctx_free, __module_3_levels_eval
+    }
+};
+
+
+struct module_run
+{
+    const struct module_model *model;
+    enum solver_backend backend;
+    bool adiabatic;
+
+    const unsigned char *in;
+    unsigned char *out;
+    int *status;
+};
+
+
+static const struct module_model *__module_model(int n_levels)
+{
+    if(n_levels != 2 && n_levels != 3)
+    {
+        PyErr_Format(PyExc_ValueError,"unknown model %d, expected 2 or 3",n_levels);
+        return NULL;
+    }
+
+    return &__module_models[n_levels - 2];
+}
+
+
+static int __module_backend(const char *name, enum solver_backend *backend)
+{
+    if(!strcmp(name,"dense"))
+        *backend = SOLVER_BACKEND_DENSE;
+    else if(!strcmp(name,"sparse"))
+        *backend = SOLVER_BACKEND_SPARSE_NEWTON;
+    else if(!strcmp(name,"fixed"))
+        *backend = SOLVER_BACKEND_FIXED_NEWTON;
+    else
+    {
+        PyErr_Format(PyExc_ValueError,"unknown backend '%s'",name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static PyObject *__module_names(const struct field_desc *fields, size_t n_fields)
+{
+    PyObject *names = PyTuple_New(n_fields);
+    if(!names)
+        return NULL;
+
+    for(size_t i = 0; i < n_fields; ++i)
+    {
+        PyObject *name = PyUnicode_FromString(fields[i].name);
+        if(!name)
+        {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(names,i,name);
+    }
+
+    return names;
+}
+
+
+// Accepts plain doubles or a struct format whose members are doubles named
+// after the fields in order, e.g. "T{d:Ax:d:Ay:...}" of a NumPy structured array
+static bool __module_format_matches(const char *format, const struct field_desc *fields, size_t n_fields)
+{
+    if(!format)
+        return true;
+    if(*format == '<' || *format == '=' || *format == '@')
+        ++format;
+    if(!strcmp(format,"d"))
+        return true;
+    if(strncmp(format,"T{",2))
+        return false;
+
+    const char *c = format + 2;
+    for(size_t i = 0; i < n_fields; ++i)
+    {
+        if(*c == '<' || *c == '=' || *c == '@')
+            ++c;
+        if(c[0] != 'd' || c[1] != ':')
+            return false;
+        c += 2;
+
+        const size_t len = strlen(fields[i].name);
+        if(strncmp(c,fields[i].name,len) || c[len] != ':')
+            return false;
+        c += len + 1;
+    }
+
+    return !strcmp(c,"}");
+}
+
+
+static int __module_get_buffer(PyObject *obj, Py_buffer *view, bool writable, size_t record_size,
+                               const struct field_desc *fields, size_t n_fields, const char *what)
+{
+    int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if(writable)
+        flags |= PyBUF_WRITABLE;
+    if(PyObject_GetBuffer(obj,view,flags))
+        return -1;
+
+    if(view->len % record_size || !__module_format_matches(view->format,fields,n_fields))
+    {
+        PyErr_Format(PyExc_TypeError,"%s must be float64 records of %zu fields",what,n_fields);
+        PyBuffer_Release(view);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void *__module_worker_alloc(void *data)
+{
+    struct module_run *run = (struct module_run*)data;
+    return run->model->ctx_alloc(run->backend);
+}
+
+
+static void __module_worker_free(void *worker, void *data)
+{
+    struct module_run *run = (struct module_run*)data;
+    run->model->ctx_free(worker);
+}
+
+
+static void __module_item(size_t i, void *worker, void *data)
+{
+    struct module_run *run = (struct module_run*)data;
+    const struct module_model *model = run->model;
+    const unsigned char *user_params = run->in + i*model->user_params_size;
+    unsigned char *result = run->out + i*model->result_size;
+
+    run->status[i] = model->eval(worker,user_params,result,run->adiabatic);
+}
+
+
+static PyObject *__module_solve(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"model","params","results","adiabatic","backend","threads","status",NULL};
+    int n_levels;
+    PyObject *params_obj, *results_obj, *status_obj = Py_None;
+    int adiabatic = 0;
+    const char *backend_name = NULL;
+    int nthreads = 0;
+    if(!PyArg_ParseTupleAndKeywords(args,kwargs,"iOO|pziO:solve",keywords,&n_levels,&params_obj,&results_obj,
+                                    &adiabatic,&backend_name,&nthreads,&status_obj))
+        return NULL;
+
+    struct module_run run;
+    run.model = __module_model(n_levels);
+    if(!run.model)
+        return NULL;
+    run.adiabatic = adiabatic;
+    run.backend = run.model->default_backend(adiabatic);
+    if(backend_name && __module_backend(backend_name,&run.backend))
+        return NULL;
+    const struct module_model *model = run.model;
+
+    Py_buffer params, results, status;
+    if(__module_get_buffer(params_obj,&params,false,model->user_params_size,model->params,*model->n_params,"params"))
+        return NULL;
+    if(__module_get_buffer(results_obj,&results,true,model->result_size,model->results,*model->n_results,"results"))
+    {
+        PyBuffer_Release(&params);
+        return NULL;
+    }
+
+    const size_t n = params.len/model->user_params_size;
+    bool own_status = status_obj == Py_None;
+    if(results.len/model->result_size != n)
+        PyErr_SetString(PyExc_ValueError,"params and results differ in length");
+    else if(!own_status && !PyObject_GetBuffer(status_obj,&status,PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE))
+    {
+        if(status.itemsize != sizeof(int) || (status.format && strcmp(status.format,"i") && strcmp(status.format,"=i")) ||
+           (size_t)status.len != n*sizeof(int))
+        {
+            PyErr_SetString(PyExc_TypeError,"status must be int32 of the same length as params");
+            PyBuffer_Release(&status);
+        }
+    }
+    if(PyErr_Occurred())
+    {
+        PyBuffer_Release(&results);
+        PyBuffer_Release(&params);
+        return NULL;
+    }
+
+    run.in = params.buf;
+    run.out = results.buf;
+    run.status = own_status ? malloc((n ? n : 1)*sizeof(int)) : status.buf;
+    if(!run.status)
+    {
+        PyBuffer_Release(&results);
+        PyBuffer_Release(&params);
+        return PyErr_NoMemory();
+    }
+
+    // Items a worker never got to, e.g. when its context failed to allocate
+    for(size_t i = 0; i < n; ++i)
+        run.status[i] = GSL_EFAILED;
+
+    Py_BEGIN_ALLOW_THREADS
+    batch_run(n,nthreads,__module_worker_alloc,__module_item,__module_worker_free,&run);
+    Py_END_ALLOW_THREADS
+
+    size_t failed = 0;
+    for(size_t i = 0; i < n; ++i)
+        if(run.status[i] != GSL_SUCCESS)
+            ++failed;
+
+    if(own_status)
+        free(run.status);
+    else
+        PyBuffer_Release(&status);
+    PyBuffer_Release(&results);
+    PyBuffer_Release(&params);
+
+    return PyLong_FromSize_t(failed);
+}
+
+
+static PyObject *__module_fields(PyObject *self, PyObject *args)
+{
+    int n_levels;
+    if(!PyArg_ParseTuple(args,"i:fields",&n_levels))
+        return NULL;
+
+    const struct module_model *model = __module_model(n_levels);
+    if(!model)
+        return NULL;
+
+    PyObject *params = __module_names(model->params,*model->n_params);
+    PyObject *results = __module_names(model->results,*model->n_results);
+    if(!params || !results)
+    {
+        Py_XDECREF(params);
+        Py_XDECREF(results);
+        return NULL;
+    }
+
+    return Py_BuildValue("(NN)",params,results);
+}
+
+
+static PyObject *__module_default_params(PyObject *self, PyObject *args)
+{
+    int n_levels;
+    if(!PyArg_ParseTuple(args,"i:default_params",&n_levels))
+        return NULL;
+
+    const struct module_model *model = __module_model(n_levels);
+    if(!model)
+        return NULL;
+
+    unsigned char user_params[model->user_params_size];
+    model->default_user_params(user_params);
+
+    PyObject *values = PyTuple_New(*model->n_params);
+    if(!values)
+        return NULL;
+    for(size_t i = 0; i < *model->n_params; ++i)
+    {
+        PyObject *value = PyFloat_FromDouble(*(const double*)(user_params + model->params[i].offset));
+        if(!value)
+        {
+            Py_DECREF(values);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(values,i,value);
+    }
+
+    return values;
+}
+
+
+static PyMethodDef __module_methods[] = {
+    {"solve",(PyCFunction)(void(*)(void))__module_solve,METH_VARARGS | METH_KEYWORDS,
+     "solve(model, params, results, adiabatic=False, backend=None, threads=0, status=None)\n"
+     "Solves every record of params into results in place, in parallel and without the GIL.\n"
+     "backend is 'dense', 'sparse' or 'fixed', None picks the default of the model.\n"
+     "status, when given, receives the GSL status of each record. Returns the number of failed ones."},
+    {"fields",__module_fields,METH_VARARGS,
+     "fields(model) -> (param names, result names) in record order"},
+    {"default_params",__module_default_params,METH_VARARGS,
+     "default_params(model) -> values of the default configuration in record order"},
+    {NULL,NULL,0,NULL}
+};
+
+
+static struct PyModuleDef __module_def = {
+    PyModuleDef_HEAD_INIT,
+    "_balloons",
+    "Batch evaluation over libballoons, see scripts/cw_balloons.py",
+    -1,
+    __module_methods
+};
+
+
+PyMODINIT_FUNC PyInit__balloons()
+{
+    gsl_set_error_handler_off();
+    return PyModule_Create(&__module_def);
+}